@@ -0,0 +1,397 @@
+#ifndef ASSET_PACK_H
+#define ASSET_PACK_H
+
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// single file asset pack, written by the AssetPacker tool and memory mapped at runtime so looking up an
+// asset never opens a file.
+//
+//   AssetPackHeader
+//   AssetPackEntry     per asset, sorted by hash
+//   path strings       not terminated, for checking hash collisions
+//   blobs              each aligned to ASSET_PACK_ALIGNMENT, stored raw or zstd compressed
+//
+// paths are stored normalized (see normalizeAssetPath), relative to the working directory of the app,
+// e.g. "assets/skybox/px.png".
+
+#define ASSET_PACK_MAGIC     0x4B415041u // "APAK"
+#define ASSET_PACK_VERSION   1u
+#define ASSET_PACK_ALIGNMENT 64u
+
+enum AssetCompression : uint32_t {
+    ASSET_RAW  = 0,
+    ASSET_ZSTD = 1
+};
+
+struct AssetPackHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t entryCount;
+    uint32_t alignment;
+};
+
+struct AssetPackEntry {
+    uint64_t hash;
+    uint64_t offset;     // of the blob from the start of the file
+    uint64_t size;       // uncompressed
+    uint64_t storedSize; // in the pack
+    uint32_t pathOffset; // into the string table
+    uint32_t pathLength;
+    uint32_t compression;
+    uint32_t reserved;
+};
+
+// forward slashes, no empty, "." or ".." segments
+inline std::string normalizeAssetPath(const std::string &path)
+{
+    std::vector<std::string> parts;
+    std::string part;
+    for(size_t i = 0; i <= path.size(); i++)
+    {
+        char c = i < path.size() ? path[i] : '/';
+        if(c != '/' && c != '\\')
+        {
+            part += c;
+            continue;
+        }
+        if(part == "..")
+        {
+            if(!parts.empty() && parts.back() != "..")
+                parts.pop_back();
+            else
+                parts.push_back(part);
+        }
+        else if(!part.empty() && part != ".")
+            parts.push_back(part);
+        part.clear();
+    }
+    std::string result;
+    for(size_t i = 0; i < parts.size(); i++)
+    {
+        if(i > 0)
+            result += '/';
+        result += parts[i];
+    }
+    return result;
+}
+
+// 64 bit FNV-1a
+inline uint64_t hashAssetPath(const std::string &normalizedPath)
+{
+    uint64_t hash = 14695981039346656037ull;
+    for(unsigned char c : normalizedPath)
+    {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+// an asset's bytes: points into the mapping for raw entries, into storage for decompressed ones
+struct AssetView {
+    const unsigned char *data = nullptr;
+    size_t size = 0;
+    std::vector<unsigned char> storage;
+};
+
+class AssetPack {
+public:
+    AssetPack() {}
+    ~AssetPack() { close(); }
+    AssetPack(const AssetPack&) = delete;
+    AssetPack &operator=(const AssetPack&) = delete;
+
+    // the pack the loaders read from, if any. main mounts one at startup when assets.pack exists.
+    static AssetPack *mounted() { return mountedPack(); }
+    static void mount(AssetPack *pack) { mountedPack() = pack; }
+
+    bool open(const std::string &path)
+    {
+        close();
+#ifndef _WIN32
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if(fd < 0)
+            return false;
+        struct stat info;
+        if(fstat(fd, &info) != 0 || info.st_size < off_t(sizeof(AssetPackHeader)))
+        {
+            ::close(fd);
+            return false;
+        }
+        void *mapping = mmap(nullptr, size_t(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd); // the mapping keeps the file alive
+        if(mapping == MAP_FAILED)
+            return false;
+        base = static_cast<const unsigned char*>(mapping);
+        size = size_t(info.st_size);
+        mapped = true;
+#else
+        std::ifstream file(path.c_str(), std::ios::binary | std::ios::ate);
+        if(!file.good())
+            return false;
+        contents.resize(size_t(file.tellg()));
+        file.seekg(0);
+        file.read(reinterpret_cast<char*>(contents.data()), std::streamsize(contents.size()));
+        base = contents.data();
+        size = contents.size();
+#endif
+        const AssetPackHeader *header = reinterpret_cast<const AssetPackHeader*>(base);
+        size_t tableEnd = sizeof(AssetPackHeader) + size_t(header->entryCount) * sizeof(AssetPackEntry);
+        if(header->magic != ASSET_PACK_MAGIC || header->version != ASSET_PACK_VERSION || tableEnd > size)
+        {
+            std::cout << "ERROR::ASSET_PACK::BAD_FILE: " << path << std::endl;
+            close();
+            return false;
+        }
+        entries = reinterpret_cast<const AssetPackEntry*>(base + sizeof(AssetPackHeader));
+        entryCount = header->entryCount;
+        strings = reinterpret_cast<const char*>(base + tableEnd);
+        std::cout << "AssetPack: mounted '" << path << "' (" << entryCount << " assets, " << size / (1024 * 1024) << " MB)" << std::endl;
+        return true;
+    }
+
+    void close()
+    {
+#ifndef _WIN32
+        if(mapped)
+            munmap(const_cast<unsigned char*>(base), size);
+        mapped = false;
+#else
+        contents.clear();
+#endif
+        base = nullptr;
+        size = 0;
+        entries = nullptr;
+        entryCount = 0;
+    }
+
+    bool isOpen() const { return base != nullptr; }
+
+    // binary search of the sorted index, nullptr if the pack doesn't have the path
+    const AssetPackEntry *find(const std::string &path) const
+    {
+        if(!entries)
+            return nullptr;
+        std::string normalized = normalizeAssetPath(path);
+        uint64_t hash = hashAssetPath(normalized);
+        const AssetPackEntry *end = entries + entryCount;
+        const AssetPackEntry *it = std::lower_bound(entries, end, hash,
+            [](const AssetPackEntry &entry, uint64_t value) { return entry.hash < value; });
+        for(; it != end && it->hash == hash; ++it)
+            if(it->pathLength == normalized.size() && std::memcmp(strings + it->pathOffset, normalized.data(), normalized.size()) == 0)
+                return it;
+        return nullptr;
+    }
+
+    bool contains(const std::string &path) const { return find(path) != nullptr; }
+
+    bool read(const std::string &path, AssetView &view) const
+    {
+        const AssetPackEntry *entry = find(path);
+        if(!entry || entry->offset + entry->storedSize > size)
+            return false;
+        const unsigned char *blob = base + entry->offset;
+        if(entry->compression == ASSET_RAW)
+        {
+            view.data = blob;
+            view.size = size_t(entry->size);
+            return true;
+        }
+#ifdef HAVE_ZSTD
+        if(entry->compression == ASSET_ZSTD)
+        {
+            view.storage.resize(size_t(entry->size));
+            size_t result = ZSTD_decompress(view.storage.data(), view.storage.size(), blob, size_t(entry->storedSize));
+            if(ZSTD_isError(result) || result != view.storage.size())
+            {
+                std::cout << "ERROR::ASSET_PACK::DECOMPRESSION_FAILED: " << path << std::endl;
+                return false;
+            }
+            view.data = view.storage.data();
+            view.size = view.storage.size();
+            return true;
+        }
+#endif
+        std::cout << "ERROR::ASSET_PACK::UNSUPPORTED_COMPRESSION: " << path << " (built without zstd?)" << std::endl;
+        return false;
+    }
+
+private:
+    const unsigned char *base = nullptr;
+    size_t size = 0;
+    bool mapped = false;
+    std::vector<unsigned char> contents; // non-mmap fallback
+    const AssetPackEntry *entries = nullptr;
+    uint32_t entryCount = 0;
+    const char *strings = nullptr;
+
+    static AssetPack *&mountedPack()
+    {
+        static AssetPack *pack = nullptr;
+        return pack;
+    }
+};
+
+// reads an asset from the mounted pack. false if there's no pack or it doesn't have the path, callers then
+// fall back to the loose file.
+inline bool readPackedAsset(const std::string &path, AssetView &view)
+{
+    AssetPack *pack = AssetPack::mounted();
+    return pack && pack->read(path, view);
+}
+
+// same, but reads the loose file into view.storage when the pack doesn't have it
+inline bool readAssetFile(const std::string &path, AssetView &view)
+{
+    if(readPackedAsset(path, view))
+        return true;
+    std::ifstream file(path.c_str(), std::ios::binary | std::ios::ate);
+    if(!file.good())
+        return false;
+    view.storage.resize(size_t(file.tellg()));
+    file.seekg(0);
+    file.read(reinterpret_cast<char*>(view.storage.data()), std::streamsize(view.storage.size()));
+    view.data = view.storage.data();
+    view.size = view.storage.size();
+    return file.good();
+}
+
+// offline side, used by the AssetPacker tool. raw files are copied over in chunks, only the ones
+// being compressed are read whole.
+struct AssetPackSource {
+    std::string path; // as it will be looked up
+    std::string file; // on disk
+    bool compress = false;
+};
+
+inline bool writeAssetPack(const std::string &path, const std::vector<AssetPackSource> &sources, int zstdLevel = 19)
+{
+    struct Item {
+        AssetPackEntry entry;
+        std::string path;
+        std::vector<unsigned char> stored; // compressed blob, empty for raw entries
+        const AssetPackSource *source;
+    };
+    std::vector<Item> items(sources.size());
+    for(size_t i = 0; i < sources.size(); i++)
+    {
+        Item &item = items[i];
+        item.path = normalizeAssetPath(sources[i].path);
+        item.source = &sources[i];
+        std::memset(&item.entry, 0, sizeof(item.entry));
+        item.entry.hash = hashAssetPath(item.path);
+        item.entry.compression = ASSET_RAW;
+        std::ifstream file(sources[i].file.c_str(), std::ios::binary | std::ios::ate);
+        if(!file.good())
+        {
+            std::cout << "ERROR::ASSET_PACK::CANNOT_READ: " << sources[i].file << std::endl;
+            return false;
+        }
+        item.entry.size = uint64_t(file.tellg());
+#ifdef HAVE_ZSTD
+        if(sources[i].compress && item.entry.size > 0)
+        {
+            std::vector<unsigned char> data(size_t(item.entry.size));
+            file.seekg(0);
+            file.read(reinterpret_cast<char*>(data.data()), std::streamsize(data.size()));
+            // keep the compressed blob only if it is worth the decompression at load time
+            item.stored.resize(ZSTD_compressBound(data.size()));
+            size_t bytes = ZSTD_compress(item.stored.data(), item.stored.size(), data.data(), data.size(), zstdLevel);
+            if(!ZSTD_isError(bytes) && bytes < data.size() * 9 / 10)
+            {
+                item.stored.resize(bytes);
+                item.entry.compression = ASSET_ZSTD;
+            }
+            else
+                item.stored.clear();
+        }
+#else
+        (void)zstdLevel;
+#endif
+        item.stored.shrink_to_fit();
+    }
+    std::sort(items.begin(), items.end(), [](const Item &a, const Item &b) {
+        return a.entry.hash != b.entry.hash ? a.entry.hash < b.entry.hash : a.path < b.path;
+    });
+    for(size_t i = 1; i < items.size(); i++)
+        if(items[i].path == items[i - 1].path)
+        {
+            std::cout << "ERROR::ASSET_PACK::DUPLICATE_PATH: " << items[i].path << std::endl;
+            return false;
+        }
+
+    // layout: header, index, strings, then the aligned blobs
+    std::string strings;
+    for(Item &item : items)
+    {
+        item.entry.pathOffset = static_cast<uint32_t>(strings.size());
+        item.entry.pathLength = static_cast<uint32_t>(item.path.size());
+        strings += item.path;
+    }
+    auto align = [](uint64_t offset) { return (offset + ASSET_PACK_ALIGNMENT - 1) / ASSET_PACK_ALIGNMENT * ASSET_PACK_ALIGNMENT; };
+    uint64_t offset = align(sizeof(AssetPackHeader) + items.size() * sizeof(AssetPackEntry) + strings.size());
+    for(Item &item : items)
+    {
+        item.entry.offset = offset;
+        item.entry.storedSize = item.entry.compression == ASSET_RAW ? item.entry.size : item.stored.size();
+        offset = align(offset + item.entry.storedSize);
+    }
+
+    std::ofstream out(path.c_str(), std::ios::binary);
+    if(!out.good())
+    {
+        std::cout << "ERROR::ASSET_PACK::CANNOT_WRITE: " << path << std::endl;
+        return false;
+    }
+    AssetPackHeader header = { ASSET_PACK_MAGIC, ASSET_PACK_VERSION, static_cast<uint32_t>(items.size()), ASSET_PACK_ALIGNMENT };
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    for(const Item &item : items)
+        out.write(reinterpret_cast<const char*>(&item.entry), sizeof(item.entry));
+    out.write(strings.data(), std::streamsize(strings.size()));
+    static const char padding[ASSET_PACK_ALIGNMENT] = {};
+    std::vector<char> chunk(1 << 20);
+    uint64_t written = sizeof(header) + items.size() * sizeof(AssetPackEntry) + strings.size();
+    for(const Item &item : items)
+    {
+        out.write(padding, std::streamsize(item.entry.offset - written));
+        if(item.entry.compression == ASSET_RAW)
+        {
+            std::ifstream file(item.source->file.c_str(), std::ios::binary);
+            uint64_t left = item.entry.size;
+            while(left > 0 && file.good())
+            {
+                size_t bytes = size_t(std::min<uint64_t>(left, chunk.size()));
+                file.read(chunk.data(), std::streamsize(bytes));
+                out.write(chunk.data(), std::streamsize(bytes));
+                left -= bytes;
+            }
+            if(left > 0)
+            {
+                std::cout << "ERROR::ASSET_PACK::CANNOT_READ: " << item.source->file << std::endl;
+                return false;
+            }
+        }
+        else
+            out.write(reinterpret_cast<const char*>(item.stored.data()), std::streamsize(item.stored.size()));
+        written = item.entry.offset + item.entry.storedSize;
+    }
+    return out.good();
+}
+#endif
@@ -0,0 +1,55 @@
+#ifndef ASSET_PACK_IO_H
+#define ASSET_PACK_IO_H
+
+#include <assimp/DefaultIOSystem.h>
+#include <assimp/IOSystem.hpp>
+#include <assimp/MemoryIOWrapper.h>
+
+#include <asset_pack.h>
+
+#include <cstring>
+#include <string>
+
+// lets Assimp read a model and everything it references (.mtl files, ...) out of an AssetPack.
+// paths the pack doesn't have go to the regular file system.
+class AssetPackIOSystem : public Assimp::IOSystem {
+public:
+    explicit AssetPackIOSystem(const AssetPack &pack) : pack(pack) {}
+
+    bool Exists(const char *pFile) const override
+    {
+        return pack.contains(pFile) || disk.Exists(pFile);
+    }
+
+    char getOsSeparator() const override
+    {
+        return '/';
+    }
+
+    Assimp::IOStream *Open(const char *pFile, const char *pMode = "rb") override
+    {
+        if(std::strchr(pMode, 'w') == nullptr && std::strchr(pMode, 'a') == nullptr)
+        {
+            AssetView view;
+            if(pack.read(pFile, view))
+            {
+                if(view.storage.empty())
+                    return new Assimp::MemoryIOStream(view.data, view.size); // straight from the mapping
+                uint8_t *copy = new uint8_t[view.size];
+                std::memcpy(copy, view.data, view.size);
+                return new Assimp::MemoryIOStream(copy, view.size, true);
+            }
+        }
+        return disk.Open(pFile, pMode);
+    }
+
+    void Close(Assimp::IOStream *pFile) override
+    {
+        delete pFile;
+    }
+
+private:
+    const AssetPack &pack;
+    Assimp::DefaultIOSystem disk;
+};
+#endif
@@ -0,0 +1,330 @@
+#ifndef BATCH_READER_H
+#define BATCH_READER_H
+
+#include <asset_pack.h>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+#define BATCH_READER_IO_URING
+#endif
+#endif
+#endif
+
+#ifdef BATCH_READER_IO_URING
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// reads many files at once into one buffer. on linux the reads go through an io_uring, so a batch of
+// files costs a handful of syscalls instead of an open/read/close round trip each; elsewhere (or when the
+// kernel refuses io_uring) a few threads read the files in parallel. files in the mounted asset pack
+// are handed out straight from the mapping without any I/O.
+struct BatchRead {
+    std::string path;
+    AssetView view; // the contents, valid until the reader's next batch
+    bool ok = false;
+
+    BatchRead() {}
+    BatchRead(const std::string &path) : path(path) {}
+};
+
+class BatchReader {
+public:
+    explicit BatchReader(unsigned int queueDepth = 64)
+    {
+#ifdef BATCH_READER_IO_URING
+        ring.setup(queueDepth);
+#else
+        (void)queueDepth;
+#endif
+    }
+    ~BatchReader()
+    {
+#ifdef BATCH_READER_IO_URING
+        ring.close();
+#endif
+    }
+    BatchReader(const BatchReader&) = delete;
+    BatchReader &operator=(const BatchReader&) = delete;
+
+    bool usesIoUring() const
+    {
+#ifdef BATCH_READER_IO_URING
+        return ring.fd >= 0;
+#else
+        return false;
+#endif
+    }
+
+    // reads every file of the batch, returns how many were read. files bigger than maxFileSize are
+    // left unread, so callers can stream those instead.
+    size_t read(std::vector<BatchRead> &files, size_t maxFileSize = SIZE_MAX)
+    {
+        // sizes first, so the whole batch gets a single allocation
+        std::vector<size_t> todo;
+        std::vector<size_t> offsets(files.size(), 0), sizes(files.size(), 0);
+        size_t total = 0;
+        for(size_t i = 0; i < files.size(); i++)
+        {
+            BatchRead &file = files[i];
+            file.view = AssetView();
+            file.ok = readPackedAsset(file.path, file.view);
+            if(file.ok)
+                continue;
+            struct stat info;
+            if(stat(file.path.c_str(), &info) != 0 || !S_ISREG(info.st_mode) || size_t(info.st_size) > maxFileSize)
+                continue;
+            offsets[i] = total;
+            sizes[i] = size_t(info.st_size);
+            total += (sizes[i] + 63) & ~size_t(63);
+            todo.push_back(i);
+        }
+        buffer.resize(total);
+        for(size_t i : todo)
+        {
+            files[i].view.data = buffer.data() + offsets[i];
+            files[i].view.size = sizes[i];
+        }
+
+        std::vector<size_t> rest;
+#ifdef BATCH_READER_IO_URING
+        if(ring.fd >= 0)
+            readRing(files, todo, rest);
+        else
+#endif
+            rest = todo;
+        readThreaded(files, rest);
+
+        size_t count = 0;
+        for(const BatchRead &file : files)
+            count += file.ok ? 1 : 0;
+        return count;
+    }
+
+private:
+    std::vector<unsigned char> buffer;
+
+    // blocking reads spread over a few threads, for platforms without io_uring
+    static void readThreaded(std::vector<BatchRead> &files, const std::vector<size_t> &todo)
+    {
+        if(todo.empty())
+            return;
+        std::atomic<size_t> next(0);
+        auto work = [&]() {
+            for(size_t t = next++; t < todo.size(); t = next++)
+            {
+                BatchRead &file = files[todo[t]];
+                std::ifstream in(file.path.c_str(), std::ios::binary);
+                in.read(reinterpret_cast<char*>(const_cast<unsigned char*>(file.view.data)), std::streamsize(file.view.size));
+                file.ok = in.gcount() == std::streamsize(file.view.size);
+            }
+        };
+        unsigned int threadCount = std::min<unsigned int>(std::max(1u, std::thread::hardware_concurrency()), 8u);
+        threadCount = std::min<unsigned int>(threadCount, static_cast<unsigned int>(todo.size()));
+        std::vector<std::thread> threads;
+        for(unsigned int i = 1; i < threadCount; i++)
+            threads.emplace_back(work);
+        work();
+        for(std::thread &thread : threads)
+            thread.join();
+    }
+
+#ifdef BATCH_READER_IO_URING
+    // the bare minimum of io_uring through its syscalls: one submission queue, one completion queue
+    struct Ring {
+        int fd = -1;
+        unsigned int entries = 0;
+        unsigned int *sqHead = nullptr, *sqTail = nullptr, *sqMask = nullptr, *sqArray = nullptr;
+        unsigned int *cqHead = nullptr, *cqTail = nullptr, *cqMask = nullptr;
+        io_uring_sqe *sqes = nullptr;
+        io_uring_cqe *cqes = nullptr;
+        void *sqRing = MAP_FAILED, *cqRing = MAP_FAILED;
+        size_t sqRingSize = 0, cqRingSize = 0, sqesSize = 0;
+
+        bool setup(unsigned int queueDepth)
+        {
+            io_uring_params params = {};
+            fd = int(syscall(__NR_io_uring_setup, queueDepth, &params));
+            if(fd < 0)
+                return false; // no kernel support or blocked by a sandbox, the thread path takes over
+            entries = params.sq_entries;
+            sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+            cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+            bool single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+            if(single)
+                sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+            sqRing = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+            cqRing = single ? sqRing : mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+            sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+            void *sqeMap = mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+            if(sqRing == MAP_FAILED || cqRing == MAP_FAILED || sqeMap == MAP_FAILED)
+            {
+                if(sqeMap != MAP_FAILED)
+                    munmap(sqeMap, sqesSize);
+                close();
+                return false;
+            }
+            char *sq = static_cast<char*>(sqRing), *cq = static_cast<char*>(cqRing);
+            sqHead = reinterpret_cast<unsigned int*>(sq + params.sq_off.head);
+            sqTail = reinterpret_cast<unsigned int*>(sq + params.sq_off.tail);
+            sqMask = reinterpret_cast<unsigned int*>(sq + params.sq_off.ring_mask);
+            sqArray = reinterpret_cast<unsigned int*>(sq + params.sq_off.array);
+            cqHead = reinterpret_cast<unsigned int*>(cq + params.cq_off.head);
+            cqTail = reinterpret_cast<unsigned int*>(cq + params.cq_off.tail);
+            cqMask = reinterpret_cast<unsigned int*>(cq + params.cq_off.ring_mask);
+            cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+            sqes = static_cast<io_uring_sqe*>(sqeMap);
+            return true;
+        }
+
+        void close()
+        {
+            if(sqes)
+                munmap(sqes, sqesSize);
+            if(cqRing != MAP_FAILED && cqRing != sqRing)
+                munmap(cqRing, cqRingSize);
+            if(sqRing != MAP_FAILED)
+                munmap(sqRing, sqRingSize);
+            if(fd >= 0)
+                ::close(fd);
+            fd = -1;
+            sqes = nullptr;
+            sqRing = cqRing = MAP_FAILED;
+        }
+
+        // queues a read, the caller keeps at most `entries` of them in flight
+        void queueRead(int file, void *dst, unsigned int bytes, uint64_t offset, uint64_t userData)
+        {
+            unsigned int tail = *sqTail;
+            unsigned int index = tail & *sqMask;
+            io_uring_sqe &sqe = sqes[index];
+            std::memset(&sqe, 0, sizeof(sqe));
+            sqe.opcode = IORING_OP_READ;
+            sqe.fd = file;
+            sqe.addr = reinterpret_cast<uint64_t>(dst);
+            sqe.len = bytes;
+            sqe.off = offset;
+            sqe.user_data = userData;
+            sqArray[index] = index;
+            __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+        }
+
+        // submits the queued reads and waits for at least one completion
+        bool submitAndWait(unsigned int submit)
+        {
+            for(;;)
+            {
+                long result = syscall(__NR_io_uring_enter, fd, submit, 1u, IORING_ENTER_GETEVENTS, nullptr, 0);
+                if(result >= 0)
+                    return true;
+                if(errno != EINTR)
+                    return false;
+            }
+        }
+    };
+    Ring ring;
+
+    // reads the files through the ring. anything the ring can't do ends up in rest for the thread path
+    void readRing(std::vector<BatchRead> &files, const std::vector<size_t> &todo, std::vector<size_t> &rest)
+    {
+        struct Pending {
+            size_t file;
+            int fd = -1;
+            size_t done = 0;
+        };
+        std::vector<Pending> pending;
+        pending.reserve(todo.size());
+        std::deque<size_t> queue; // indices into pending that need (another) read
+        for(size_t i : todo)
+        {
+            if(files[i].view.size == 0)
+            {
+                files[i].ok = true;
+                continue;
+            }
+            Pending p;
+            p.file = i;
+            pending.push_back(p);
+            queue.push_back(pending.size() - 1);
+        }
+
+        unsigned int inFlight = 0;
+        while(!queue.empty() || inFlight > 0)
+        {
+            unsigned int submit = 0;
+            while(!queue.empty() && inFlight < ring.entries)
+            {
+                Pending &p = pending[queue.front()];
+                queue.pop_front();
+                BatchRead &file = files[p.file];
+                if(p.fd < 0)
+                    p.fd = open(file.path.c_str(), O_RDONLY | O_CLOEXEC);
+                if(p.fd < 0)
+                    continue;
+                unsigned char *dst = const_cast<unsigned char*>(file.view.data) + p.done;
+                unsigned int bytes = static_cast<unsigned int>(std::min<size_t>(file.view.size - p.done, size_t(1) << 30));
+                ring.queueRead(p.fd, dst, bytes, p.done, &p - pending.data());
+                inFlight++;
+                submit++;
+            }
+            if(inFlight == 0)
+                break;
+            if(!ring.submitAndWait(submit))
+            {
+                // the ring is unusable, drain nothing more through it and let the threads read everything left
+                for(Pending &p : pending)
+                {
+                    if(!files[p.file].ok)
+                        rest.push_back(p.file);
+                    if(p.fd >= 0)
+                        ::close(p.fd);
+                }
+                ring.close();
+                return;
+            }
+
+            unsigned int head = *ring.cqHead;
+            unsigned int tail = __atomic_load_n(ring.cqTail, __ATOMIC_ACQUIRE);
+            for(; head != tail; head++)
+            {
+                const io_uring_cqe &cqe = ring.cqes[head & *ring.cqMask];
+                Pending &p = pending[cqe.user_data];
+                BatchRead &file = files[p.file];
+                inFlight--;
+                if(cqe.res > 0)
+                {
+                    p.done += size_t(cqe.res);
+                    if(p.done < file.view.size)
+                    {
+                        queue.push_back(size_t(cqe.user_data)); // short read, ask for the rest
+                        continue;
+                    }
+                    file.ok = true;
+                }
+                else if(cqe.res == -EINVAL || cqe.res == -EOPNOTSUPP)
+                    rest.push_back(p.file); // kernel older than IORING_OP_READ
+                ::close(p.fd);
+                p.fd = -1;
+            }
+            __atomic_store_n(ring.cqHead, head, __ATOMIC_RELEASE);
+        }
+    }
+#endif
+};
+#endif
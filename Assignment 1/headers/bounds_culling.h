@@ -0,0 +1,119 @@
+#ifndef BOUNDS_CULLING_H
+#define BOUNDS_CULLING_H
+
+#include <glm/glm.hpp>
+
+#include <frustum.h>
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#if defined(BOUNDS_CULLING_AVX) && defined(_MSC_VER)
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
+// axis aligned boxes as center and half extent, one array per component, so eight boxes load with one
+// instruction per component
+struct BoundsSoA {
+    std::vector<float> centerX, centerY, centerZ;
+    std::vector<float> extentX, extentY, extentZ;
+
+    size_t size() const { return centerX.size(); }
+
+    void resize(size_t count)
+    {
+        for(std::vector<float> *component : { &centerX, &centerY, &centerZ, &extentX, &extentY, &extentZ })
+            component->resize(count);
+    }
+
+    void set(size_t i, const glm::vec3 &min, const glm::vec3 &max)
+    {
+        glm::vec3 center = (min + max) * 0.5f, extent = (max - min) * 0.5f;
+        centerX[i] = center.x;
+        centerY[i] = center.y;
+        centerZ[i] = center.z;
+        extentX[i] = extent.x;
+        extentY[i] = extent.y;
+        extentZ[i] = extent.z;
+    }
+
+    // the box around box i of local after transforming it by linear (rotation and scale) and adding translation
+    void setTransformed(size_t i, const BoundsSoA &local, size_t j, const glm::mat3 &linear, const glm::vec3 &translation)
+    {
+        glm::vec3 center = linear * glm::vec3(local.centerX[j], local.centerY[j], local.centerZ[j]) + translation;
+        glm::vec3 extent(local.extentX[j], local.extentY[j], local.extentZ[j]);
+        // each world axis gets the extent projected onto it from every local axis
+        glm::mat3 absolute(glm::abs(linear[0]), glm::abs(linear[1]), glm::abs(linear[2]));
+        extent = absolute * extent;
+        centerX[i] = center.x;
+        centerY[i] = center.y;
+        centerZ[i] = center.z;
+        extentX[i] = extent.x;
+        extentY[i] = extent.y;
+        extentZ[i] = extent.z;
+    }
+};
+
+#ifdef BOUNDS_CULLING_AVX
+// tests the first count rounded down to a multiple of eight boxes, eight at a time, writes the indices of
+// the visible ones to visible and returns how many. planes are the frustum's 24 floats. defined in
+// bounds_culling_avx.cpp, the only file built with AVX enabled, and only called when the CPU has AVX. it
+// takes plain arrays so that file includes no header whose inline functions it could compile with AVX.
+size_t cullBoundsAVX(const float *planes, const float *centerX, const float *centerY, const float *centerZ,
+                     const float *extentX, const float *extentY, const float *extentZ, size_t count, uint32_t *visible);
+
+// whether the CPU and the OS support AVX, asked once
+inline bool cpuSupportsAVX()
+{
+    static const bool supported = []() {
+#ifdef _MSC_VER
+        int info[4];
+        __cpuid(info, 1);
+        // AVX itself, and OSXSAVE so the OS saves the ymm registers, which xgetbv then confirms
+        bool avx = (info[2] & (1 << 28)) != 0 && (info[2] & (1 << 27)) != 0;
+        return avx && (_xgetbv(0) & 6) == 6;
+#else
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx") != 0;
+#endif
+    }();
+    return supported;
+}
+#endif
+
+// appends the indices of the boxes that intersect the frustum to visible, in increasing order. a box is
+// outside when it is entirely behind one of the planes, i.e. when dot(n, center) + d + dot(|n|, extent) < 0.
+// on CPUs with AVX (and builds with BOUNDS_CULLING_AVX) eight boxes are tested against all six planes at
+// once, the rest one at a time.
+inline void cullBounds(const Frustum &frustum, const BoundsSoA &bounds, std::vector<uint32_t> &visible)
+{
+    const size_t count = bounds.size();
+    size_t i = 0;
+#ifdef BOUNDS_CULLING_AVX
+    if(cpuSupportsAVX())
+    {
+        size_t first = visible.size();
+        visible.resize(first + count);
+        size_t written = cullBoundsAVX(&frustum.planes[0].x, bounds.centerX.data(), bounds.centerY.data(), bounds.centerZ.data(),
+                                       bounds.extentX.data(), bounds.extentY.data(), bounds.extentZ.data(), count, visible.data() + first);
+        visible.resize(first + written);
+        i = count - count % 8;
+    }
+#endif
+    for(; i < count; i++)
+    {
+        bool inside = true;
+        for(int p = 0; p < 6 && inside; p++)
+        {
+            const glm::vec4 &plane = frustum.planes[p];
+            float distance = plane.x * bounds.centerX[i] + plane.y * bounds.centerY[i] + plane.z * bounds.centerZ[i] + plane.w;
+            float reach = std::fabs(plane.x) * bounds.extentX[i] + std::fabs(plane.y) * bounds.extentY[i] + std::fabs(plane.z) * bounds.extentZ[i];
+            inside = distance + reach >= 0.0f;
+        }
+        if(inside)
+            visible.push_back(static_cast<uint32_t>(i));
+    }
+}
+#endif
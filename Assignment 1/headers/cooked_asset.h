@@ -0,0 +1,295 @@
+#ifndef COOKED_ASSET_H
+#define COOKED_ASSET_H
+
+#include <mesh_optimizer.h>
+#include <mesh_simplifier.h>
+#include <meshlet.h>
+#include <texture_compress.h>
+#include <vertex_format.h>
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// formats written by the AssetCooker and read back by Model, so imports, mesh optimization, level of
+// detail generation and texture compression happen once offline instead of on every start.
+//
+// cooked model (<model>.cooked):
+//   CookedModelHeader
+//   per material: uint32 texture count, then per texture uint32 length + type name, uint32 length + path
+//   per mesh: uint32 material, vertex, index, meshlet and lod count, the Vertex array, the indices,
+//             the meshlets, then per lod a float error, uint32 index count and the indices
+//
+// cooked texture (<image>.ctex):
+//   CookedTextureHeader, then per mip level a uint32 byte size and the BC1 or BC3 blocks
+//
+// cooked cubemap (<faces directory>/cubemap.ccube):
+//   CookedCubemapHeader, then per mip level and per face (+X, -X, +Y, -Y, +Z, -Z) a uint32 byte size and
+//   the BC1 or BC3 blocks. the mips are filtered across the cube edges (see cubemap.h).
+
+#define COOKED_MODEL_MAGIC     0x4C444D43u // "CMDL"
+#define COOKED_MODEL_VERSION   2u // 2: meshlets carry their uv bounds
+#define COOKED_TEXTURE_MAGIC   0x58455443u // "CTEX"
+#define COOKED_TEXTURE_VERSION 1u
+#define COOKED_CUBEMAP_MAGIC   0x42554343u // "CCUB"
+#define COOKED_CUBEMAP_VERSION 1u
+
+struct CookedModelHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t vertexSize; // sizeof(Vertex) of the cooker, the array is copied as is
+    uint32_t meshCount;
+    uint32_t materialCount;
+    uint32_t reserved;
+    uint64_t settingsHash;
+};
+
+struct CookedMaterial {
+    std::vector<std::string> types; // sampler names, e.g. texture_diffuse
+    std::vector<std::string> paths; // relative to the model's directory
+};
+
+struct CookedMesh {
+    uint32_t materialIndex = 0;
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices;
+    std::vector<Meshlet> meshlets;
+    std::vector<SimplifyResult> lods;
+};
+
+struct CookedModel {
+    uint64_t settingsHash = 0;
+    std::vector<CookedMaterial> materials;
+    std::vector<CookedMesh> meshes;
+};
+
+enum CookedTextureFormat : uint32_t {
+    COOKED_BC1 = 1,
+    COOKED_BC3 = 3
+};
+
+struct CookedTextureHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t width, height;
+    uint32_t levels;
+    uint32_t format;
+};
+
+struct CookedCubemapHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t size; // of a face at level 0
+    uint32_t levels;
+    uint32_t format;
+};
+
+inline uint64_t hashBytes(const void *data, size_t size, uint64_t hash = 14695981039346656037ull)
+{
+    const unsigned char *bytes = static_cast<const unsigned char*>(data);
+    for(size_t i = 0; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+// everything a cooked mesh depends on besides its inputs. Model rejects cooked files made with other settings.
+inline uint64_t cookSettingsHash(const MeshOptimizeSettings &optimize, const LodSettings &lod)
+{
+    const uint32_t version = COOKED_MODEL_VERSION;
+    uint64_t hash = hashBytes(&version, sizeof(version));
+    const uint32_t flags = (optimize.weld ? 1u : 0u) | (optimize.cache ? 2u : 0u) | (optimize.overdraw ? 4u : 0u) | (optimize.fetch ? 8u : 0u);
+    hash = hashBytes(&flags, sizeof(flags), hash);
+    hash = hashBytes(&optimize.cacheSize, sizeof(optimize.cacheSize), hash);
+    hash = hashBytes(&optimize.overdrawThreshold, sizeof(optimize.overdrawThreshold), hash);
+    hash = hashBytes(&lod.maxLevels, sizeof(lod.maxLevels), hash);
+    hash = hashBytes(&lod.reduction, sizeof(lod.reduction), hash);
+    hash = hashBytes(&lod.minReduction, sizeof(lod.minReduction), hash);
+    hash = hashBytes(&lod.minTriangles, sizeof(lod.minTriangles), hash);
+    return hash;
+}
+
+inline bool writeCookedModel(const std::string &path, const CookedModel &model)
+{
+    std::ofstream out(path.c_str(), std::ios::binary);
+    if(!out.good())
+        return false;
+    auto write = [&out](const void *data, size_t size) { out.write(static_cast<const char*>(data), std::streamsize(size)); };
+    auto writeU32 = [&write](uint32_t value) { write(&value, sizeof(value)); };
+    auto writeString = [&](const std::string &s) { writeU32(static_cast<uint32_t>(s.size())); write(s.data(), s.size()); };
+
+    CookedModelHeader header = { COOKED_MODEL_MAGIC, COOKED_MODEL_VERSION, static_cast<uint32_t>(sizeof(Vertex)),
+                                 static_cast<uint32_t>(model.meshes.size()), static_cast<uint32_t>(model.materials.size()), 0, model.settingsHash };
+    write(&header, sizeof(header));
+    for(const CookedMaterial &material : model.materials)
+    {
+        writeU32(static_cast<uint32_t>(material.types.size()));
+        for(size_t t = 0; t < material.types.size(); t++)
+        {
+            writeString(material.types[t]);
+            writeString(material.paths[t]);
+        }
+    }
+    for(const CookedMesh &mesh : model.meshes)
+    {
+        writeU32(mesh.materialIndex);
+        writeU32(static_cast<uint32_t>(mesh.vertices.size()));
+        writeU32(static_cast<uint32_t>(mesh.indices.size()));
+        writeU32(static_cast<uint32_t>(mesh.meshlets.size()));
+        writeU32(static_cast<uint32_t>(mesh.lods.size()));
+        write(mesh.vertices.data(), mesh.vertices.size() * sizeof(Vertex));
+        write(mesh.indices.data(), mesh.indices.size() * sizeof(unsigned int));
+        write(mesh.meshlets.data(), mesh.meshlets.size() * sizeof(Meshlet));
+        for(const SimplifyResult &lod : mesh.lods)
+        {
+            write(&lod.error, sizeof(lod.error));
+            writeU32(static_cast<uint32_t>(lod.indices.size()));
+            write(lod.indices.data(), lod.indices.size() * sizeof(unsigned int));
+        }
+    }
+    return out.good();
+}
+
+// bounds checked reads from a cooked file in memory
+class CookedReader {
+public:
+    CookedReader(const unsigned char *data, size_t size) : data(data), size(size) {}
+
+    bool read(void *dst, size_t bytes)
+    {
+        if(bytes > size - position)
+            return false;
+        std::memcpy(dst, data + position, bytes);
+        position += bytes;
+        return true;
+    }
+
+    bool readU32(uint32_t &value) { return read(&value, sizeof(value)); }
+
+    bool readString(std::string &s)
+    {
+        uint32_t length;
+        if(!readU32(length) || length > size - position)
+            return false;
+        s.assign(reinterpret_cast<const char*>(data + position), length);
+        position += length;
+        return true;
+    }
+
+    template <typename T>
+    bool readArray(std::vector<T> &values, uint32_t count)
+    {
+        if(size_t(count) * sizeof(T) > size - position)
+            return false;
+        values.resize(count);
+        return read(values.data(), size_t(count) * sizeof(T));
+    }
+
+    const unsigned char *current() const { return data + position; }
+    bool skip(size_t bytes)
+    {
+        if(bytes > size - position)
+            return false;
+        position += bytes;
+        return true;
+    }
+
+private:
+    const unsigned char *data;
+    size_t size;
+    size_t position = 0;
+};
+
+inline bool readCookedModel(const unsigned char *data, size_t size, CookedModel &model)
+{
+    CookedReader reader(data, size);
+    CookedModelHeader header;
+    if(!reader.read(&header, sizeof(header)) || header.magic != COOKED_MODEL_MAGIC || header.version != COOKED_MODEL_VERSION ||
+       header.vertexSize != sizeof(Vertex))
+        return false;
+    model.settingsHash = header.settingsHash;
+    model.materials.resize(header.materialCount);
+    for(CookedMaterial &material : model.materials)
+    {
+        uint32_t count;
+        if(!reader.readU32(count))
+            return false;
+        material.types.resize(count);
+        material.paths.resize(count);
+        for(uint32_t t = 0; t < count; t++)
+            if(!reader.readString(material.types[t]) || !reader.readString(material.paths[t]))
+                return false;
+    }
+    model.meshes.resize(header.meshCount);
+    for(CookedMesh &mesh : model.meshes)
+    {
+        uint32_t vertexCount, indexCount, meshletCount, lodCount;
+        if(!reader.readU32(mesh.materialIndex) || !reader.readU32(vertexCount) || !reader.readU32(indexCount) ||
+           !reader.readU32(meshletCount) || !reader.readU32(lodCount))
+            return false;
+        if(!reader.readArray(mesh.vertices, vertexCount) || !reader.readArray(mesh.indices, indexCount) || !reader.readArray(mesh.meshlets, meshletCount))
+            return false;
+        mesh.lods.resize(lodCount);
+        for(SimplifyResult &lod : mesh.lods)
+        {
+            uint32_t count;
+            if(!reader.read(&lod.error, sizeof(lod.error)) || !reader.readU32(count) || !reader.readArray(lod.indices, count))
+                return false;
+        }
+    }
+    return true;
+}
+
+// compresses an RGBA8 image and its mip chain. BC3 if any texel isn't opaque, BC1 otherwise.
+inline bool writeCookedTexture(const std::string &path, std::vector<unsigned char> rgba, uint32_t width, uint32_t height)
+{
+    bool withAlpha = false;
+    for(size_t i = 3; i < rgba.size() && !withAlpha; i += 4)
+        withAlpha = rgba[i] != 255;
+
+    std::ofstream out(path.c_str(), std::ios::binary);
+    if(!out.good())
+        return false;
+    uint32_t levels = 1;
+    while((width >> levels) > 0 || (height >> levels) > 0)
+        levels++;
+    CookedTextureHeader header = { COOKED_TEXTURE_MAGIC, COOKED_TEXTURE_VERSION, width, height, levels, withAlpha ? COOKED_BC3 : COOKED_BC1 };
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    std::vector<unsigned char> next;
+    uint32_t w = width, h = height;
+    for(uint32_t level = 0; level < levels; level++)
+    {
+        std::vector<unsigned char> blocks = compressImageBC(rgba.data(), w, h, withAlpha);
+        uint32_t bytes = static_cast<uint32_t>(blocks.size());
+        out.write(reinterpret_cast<const char*>(&bytes), sizeof(bytes));
+        out.write(reinterpret_cast<const char*>(blocks.data()), std::streamsize(blocks.size()));
+        if(level + 1 == levels)
+            break;
+        // 2x2 box filter down to the next level
+        uint32_t nw = std::max(1u, w / 2), nh = std::max(1u, h / 2);
+        next.assign(size_t(nw) * nh * 4, 0);
+        for(uint32_t y = 0; y < nh; y++)
+            for(uint32_t x = 0; x < nw; x++)
+            {
+                uint32_t x0 = std::min(x * 2, w - 1), x1 = std::min(x * 2 + 1, w - 1);
+                uint32_t y0 = std::min(y * 2, h - 1), y1 = std::min(y * 2 + 1, h - 1);
+                for(int c = 0; c < 4; c++)
+                {
+                    unsigned int sum = rgba[(size_t(y0) * w + x0) * 4 + c] + rgba[(size_t(y0) * w + x1) * 4 + c] +
+                                       rgba[(size_t(y1) * w + x0) * 4 + c] + rgba[(size_t(y1) * w + x1) * 4 + c];
+                    next[(size_t(y) * nw + x) * 4 + c] = static_cast<unsigned char>((sum + 2) / 4);
+                }
+            }
+        rgba.swap(next);
+        w = nw;
+        h = nh;
+    }
+    return out.good();
+}
+#endif
@@ -0,0 +1,311 @@
+#ifndef CUBEMAP_H
+#define CUBEMAP_H
+
+#include <glm/glm.hpp>
+#include <stb_image.h>
+
+#include <batch_reader.h>
+#include <cooked_asset.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// CPU side of cubemaps: decoding the six faces in parallel, converting an equirectangular panorama into
+// faces, and building the mip chain. faces are in GL order (+X, -X, +Y, -Y, +Z, -Z), RGBA8, rows top to
+// bottom as they are uploaded.
+
+#define CUBE_FACES 6
+static const char *const CUBE_FACE_NAMES[CUBE_FACES] = { "px", "nx", "py", "ny", "pz", "nz" };
+
+struct CubeLevel {
+    uint32_t size = 0;
+    std::vector<unsigned char> faces[CUBE_FACES];
+};
+
+// direction through face coordinates s, t (0..1 across the face, may lie outside), see the cube map
+// face selection table of the GL spec
+inline glm::vec3 cubeFaceDirection(int face, float s, float t)
+{
+    float sc = 2.0f * s - 1.0f, tc = 2.0f * t - 1.0f;
+    switch(face)
+    {
+        case 0:  return glm::vec3( 1.0f, -tc, -sc);
+        case 1:  return glm::vec3(-1.0f, -tc,  sc);
+        case 2:  return glm::vec3(  sc, 1.0f,  tc);
+        case 3:  return glm::vec3(  sc, -1.0f, -tc);
+        case 4:  return glm::vec3(  sc, -tc, 1.0f);
+        default: return glm::vec3( -sc, -tc, -1.0f);
+    }
+}
+
+// the face a direction hits and where
+inline int cubeDirectionToFace(const glm::vec3 &d, float &s, float &t)
+{
+    glm::vec3 a = glm::abs(d);
+    int face;
+    float sc, tc, ma;
+    if(a.x >= a.y && a.x >= a.z)
+    {
+        face = d.x > 0.0f ? 0 : 1;
+        sc = d.x > 0.0f ? -d.z : d.z;
+        tc = -d.y;
+        ma = a.x;
+    }
+    else if(a.y >= a.z)
+    {
+        face = d.y > 0.0f ? 2 : 3;
+        sc = d.x;
+        tc = d.y > 0.0f ? d.z : -d.z;
+        ma = a.y;
+    }
+    else
+    {
+        face = d.z > 0.0f ? 4 : 5;
+        sc = d.z > 0.0f ? d.x : -d.x;
+        tc = -d.y;
+        ma = a.z;
+    }
+    s = (sc / ma + 1.0f) * 0.5f;
+    t = (tc / ma + 1.0f) * 0.5f;
+    return face;
+}
+
+// runs fn(face) for the six faces on their own threads
+template <typename Function>
+inline void forEachCubeFace(Function fn)
+{
+    std::vector<std::thread> threads;
+    for(int face = 1; face < CUBE_FACES; face++)
+        threads.emplace_back(fn, face);
+    fn(0);
+    for(std::thread &thread : threads)
+        thread.join();
+}
+
+// reads the face images in one batch and decodes them in parallel. faces that are missing or don't match
+// the size of the others are filled with the average color of the rest, so a partial set still gives
+// a complete cubemap. false if no face could be decoded, then nothing is reported.
+inline bool decodeCubeFaces(const std::vector<std::string> &paths, CubeLevel &base)
+{
+    std::vector<BatchRead> files(paths.begin(), paths.end());
+    files.resize(CUBE_FACES);
+    BatchReader reader;
+    reader.read(files);
+
+    int width[CUBE_FACES] = {}, height[CUBE_FACES] = {};
+    unsigned char *pixels[CUBE_FACES] = {};
+    forEachCubeFace([&](int face) {
+        int channels;
+        if(files[face].ok)
+            pixels[face] = stbi_load_from_memory(files[face].view.data, int(files[face].view.size), &width[face], &height[face], &channels, 4);
+    });
+
+    // the first square face sets the size
+    base.size = 0;
+    for(int face = 0; face < CUBE_FACES && base.size == 0; face++)
+        if(pixels[face] && width[face] == height[face])
+            base.size = uint32_t(width[face]);
+    uint64_t sum[4] = { 0, 0, 0, 0 }, count = 0;
+    std::vector<std::string> failed;
+    for(int face = 0; face < CUBE_FACES; face++)
+    {
+        if(!pixels[face] || uint32_t(width[face]) != base.size || uint32_t(height[face]) != base.size)
+        {
+            failed.push_back((face < int(paths.size()) ? paths[face] : std::string(CUBE_FACE_NAMES[face])) + (pixels[face] ? " (not the size of the other faces)" : ""));
+            continue;
+        }
+        base.faces[face].assign(pixels[face], pixels[face] + size_t(base.size) * base.size * 4);
+        for(size_t i = 0; i < base.faces[face].size(); i += 4)
+            for(int c = 0; c < 4; c++)
+                sum[c] += base.faces[face][i + c];
+        count += size_t(base.size) * base.size;
+    }
+    for(int face = 0; face < CUBE_FACES; face++)
+        if(pixels[face])
+            stbi_image_free(pixels[face]);
+    if(count == 0)
+        return false;
+    for(const std::string &path : failed)
+        std::cout << "Cubemap texture failed to load at path: " << path << std::endl;
+    for(int face = 0; face < CUBE_FACES; face++)
+        if(base.faces[face].empty())
+        {
+            base.faces[face].resize(size_t(base.size) * base.size * 4);
+            for(size_t i = 0; i < base.faces[face].size(); i += 4)
+                for(int c = 0; c < 4; c++)
+                    base.faces[face][i + c] = static_cast<unsigned char>(sum[c] / count);
+        }
+    return true;
+}
+
+// resamples an equirectangular (longitude/latitude) RGBA8 panorama into faces of width / 4 texels.
+// +Y is up and the middle of the panorama looks down -Z.
+inline void equirectToCube(const unsigned char *rgba, int width, int height, CubeLevel &base)
+{
+    base.size = std::max(1, width / 4);
+    forEachCubeFace([&](int face) {
+        std::vector<unsigned char> &dst = base.faces[face];
+        dst.resize(size_t(base.size) * base.size * 4);
+        for(uint32_t y = 0; y < base.size; y++)
+            for(uint32_t x = 0; x < base.size; x++)
+            {
+                glm::vec3 d = glm::normalize(cubeFaceDirection(face, (x + 0.5f) / base.size, (y + 0.5f) / base.size));
+                float u = 0.5f + std::atan2(d.x, -d.z) / (2.0f * float(M_PI));
+                float v = std::acos(glm::clamp(d.y, -1.0f, 1.0f)) / float(M_PI);
+                // bilinear, wrapping around horizontally
+                float fx = u * width - 0.5f, fy = glm::clamp(v * height - 0.5f, 0.0f, float(height - 1));
+                int x0 = int(std::floor(fx)), y0 = int(fy);
+                float ax = fx - x0, ay = fy - y0;
+                int x1 = x0 + 1, y1 = std::min(y0 + 1, height - 1);
+                x0 = ((x0 % width) + width) % width;
+                x1 = ((x1 % width) + width) % width;
+                for(int c = 0; c < 4; c++)
+                {
+                    float top = rgba[(size_t(y0) * width + x0) * 4 + c] * (1.0f - ax) + rgba[(size_t(y0) * width + x1) * 4 + c] * ax;
+                    float bottom = rgba[(size_t(y1) * width + x0) * 4 + c] * (1.0f - ax) + rgba[(size_t(y1) * width + x1) * 4 + c] * ax;
+                    dst[(size_t(y) * base.size + x) * 4 + c] = static_cast<unsigned char>(top * (1.0f - ay) + bottom * ay + 0.5f);
+                }
+            }
+    });
+}
+
+// six face paths or a single equirectangular panorama. if none of the faces exists the
+// equirect.(png|jpg|jpeg|hdr) next to them is used instead.
+inline bool loadCubeSource(const std::vector<std::string> &paths, CubeLevel &base)
+{
+    if(paths.empty())
+        return false;
+    std::vector<std::string> panoramas;
+    if(paths.size() == 1)
+        panoramas = paths;
+    else if(decodeCubeFaces(paths, base))
+        return true;
+    else
+    {
+        std::string directory = paths[0].substr(0, paths[0].find_last_of('/'));
+        for(const char *extension : { ".png", ".jpg", ".jpeg", ".hdr" })
+            panoramas.push_back(directory + "/equirect" + extension);
+    }
+    for(const std::string &panorama : panoramas)
+    {
+        AssetView view;
+        if(!readAssetFile(panorama, view))
+            continue;
+        int width, height, channels;
+        unsigned char *pixels = stbi_load_from_memory(view.data, int(view.size), &width, &height, &channels, 4);
+        if(!pixels)
+            continue;
+        equirectToCube(pixels, width, height, base);
+        stbi_image_free(pixels);
+        return true;
+    }
+    std::cout << "ERROR::CUBEMAP::NO_SOURCE: neither faces nor a panorama at " << paths[0] << std::endl;
+    return false;
+}
+
+// averages the texels along the twelve cube edges with their neighbors on the adjacent face, so both
+// sides of an edge end up with the same color and minified levels have no visible seams
+inline void fixupCubeEdges(CubeLevel &level)
+{
+    const uint32_t n = level.size;
+    CubeLevel source = level;
+    auto texel = [&](int face, uint32_t x, uint32_t y) { return &source.faces[face][(size_t(y) * n + x) * 4]; };
+    for(int face = 0; face < CUBE_FACES; face++)
+        for(uint32_t y = 0; y < n; y++)
+            for(uint32_t x = 0; x < n; x++)
+            {
+                if(x != 0 && y != 0 && x != n - 1 && y != n - 1)
+                {
+                    x = n - 2; // jump to the right border
+                    continue;
+                }
+                unsigned int sum[4], count = 1;
+                for(int c = 0; c < 4; c++)
+                    sum[c] = texel(face, x, y)[c];
+                // one texel outwards, across each edge this texel lies on
+                const int steps[4][2] = { { -1, 0 }, { 1, 0 }, { 0, -1 }, { 0, 1 } };
+                const bool onEdge[4] = { x == 0, x == n - 1, y == 0, y == n - 1 };
+                for(int e = 0; e < 4; e++)
+                {
+                    if(!onEdge[e])
+                        continue;
+                    float s, t;
+                    int other = cubeDirectionToFace(cubeFaceDirection(face, (x + 0.5f + steps[e][0]) / n, (y + 0.5f + steps[e][1]) / n), s, t);
+                    uint32_t ox = std::min(uint32_t(std::max(s, 0.0f) * n), n - 1), oy = std::min(uint32_t(std::max(t, 0.0f) * n), n - 1);
+                    for(int c = 0; c < 4; c++)
+                        sum[c] += texel(other, ox, oy)[c];
+                    count++;
+                }
+                unsigned char *dst = &level.faces[face][(size_t(y) * n + x) * 4];
+                for(int c = 0; c < 4; c++)
+                    dst[c] = static_cast<unsigned char>((sum[c] + count / 2) / count);
+            }
+}
+
+// appends the mip chain below levels[0]: a 2x2 box filter per face, then the edge fixup
+inline void buildCubeMips(std::vector<CubeLevel> &levels)
+{
+    while(levels.back().size > 1)
+    {
+        const CubeLevel &src = levels.back();
+        CubeLevel next;
+        next.size = std::max(1u, src.size / 2);
+        const uint32_t n = src.size;
+        forEachCubeFace([&](int face) {
+            next.faces[face].resize(size_t(next.size) * next.size * 4);
+            for(uint32_t y = 0; y < next.size; y++)
+                for(uint32_t x = 0; x < next.size; x++)
+                {
+                    uint32_t x0 = std::min(x * 2, n - 1), x1 = std::min(x * 2 + 1, n - 1);
+                    uint32_t y0 = std::min(y * 2, n - 1), y1 = std::min(y * 2 + 1, n - 1);
+                    const std::vector<unsigned char> &f = src.faces[face];
+                    for(int c = 0; c < 4; c++)
+                    {
+                        unsigned int sum = f[(size_t(y0) * n + x0) * 4 + c] + f[(size_t(y0) * n + x1) * 4 + c] +
+                                           f[(size_t(y1) * n + x0) * 4 + c] + f[(size_t(y1) * n + x1) * 4 + c];
+                        next.faces[face][(size_t(y) * next.size + x) * 4 + c] = static_cast<unsigned char>((sum + 2) / 4);
+                    }
+                }
+        });
+        fixupCubeEdges(next);
+        levels.push_back(std::move(next));
+    }
+}
+
+// compresses a cubemap and its mip chain (see cooked_asset.h), the faces in parallel. BC3 if any texel
+// isn't opaque, BC1 otherwise.
+inline bool writeCookedCubemap(const std::string &path, const std::vector<CubeLevel> &levels)
+{
+    bool withAlpha = false;
+    for(int face = 0; face < CUBE_FACES && !withAlpha; face++)
+        for(size_t i = 3; i < levels[0].faces[face].size() && !withAlpha; i += 4)
+            withAlpha = levels[0].faces[face][i] != 255;
+
+    std::ofstream out(path.c_str(), std::ios::binary);
+    if(!out.good())
+        return false;
+    CookedCubemapHeader header = { COOKED_CUBEMAP_MAGIC, COOKED_CUBEMAP_VERSION, levels[0].size, static_cast<uint32_t>(levels.size()),
+                                   withAlpha ? COOKED_BC3 : COOKED_BC1 };
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    for(const CubeLevel &level : levels)
+    {
+        std::vector<unsigned char> blocks[CUBE_FACES];
+        forEachCubeFace([&](int face) {
+            blocks[face] = compressImageBC(level.faces[face].data(), level.size, level.size, withAlpha);
+        });
+        for(int face = 0; face < CUBE_FACES; face++)
+        {
+            uint32_t bytes = static_cast<uint32_t>(blocks[face].size());
+            out.write(reinterpret_cast<const char*>(&bytes), sizeof(bytes));
+            out.write(reinterpret_cast<const char*>(blocks[face].data()), std::streamsize(blocks[face].size()));
+        }
+    }
+    return out.good();
+}
+#endif
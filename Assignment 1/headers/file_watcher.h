@@ -0,0 +1,169 @@
+#ifndef FILE_WATCHER_H
+#define FILE_WATCHER_H
+
+#include <sys/stat.h>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// watches files for changes on a background thread. on linux the parent directories are watched with
+// inotify, elsewhere the modification times are polled. editors tend to save in several steps (truncate,
+// write, rename), so a change is only reported by poll() once the file has been quiet for the debounce time.
+class FileWatcher {
+public:
+    explicit FileWatcher(int debounceMilliseconds = 100)
+        : debounce(debounceMilliseconds)
+    {
+#ifdef __linux__
+        fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if(fd < 0)
+            std::cout << "ERROR::FILE_WATCHER::INOTIFY_INIT_FAILED, falling back to polling" << std::endl;
+#endif
+        worker = std::thread(&FileWatcher::run, this);
+    }
+
+    ~FileWatcher()
+    {
+        quit = true;
+        worker.join();
+#ifdef __linux__
+        if(fd >= 0)
+            close(fd);
+#endif
+    }
+
+    FileWatcher(const FileWatcher&) = delete;
+    FileWatcher &operator=(const FileWatcher&) = delete;
+
+    // starts watching a file, returns the path poll() will report it as
+    std::string watch(const std::string &path)
+    {
+        size_t slash = path.find_last_of('/');
+        std::string directory = slash == std::string::npos ? "." : path.substr(0, slash);
+        std::string file = directory + '/' + (slash == std::string::npos ? path : path.substr(slash + 1));
+
+        std::lock_guard<std::mutex> lock(mutex);
+        files[file] = modificationTime(file);
+#ifdef __linux__
+        if(fd >= 0)
+        {
+            bool watched = false;
+            for(const auto &entry : directories)
+                watched |= entry.second == directory;
+            if(!watched)
+            {
+                int wd = inotify_add_watch(fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+                if(wd >= 0)
+                    directories[wd] = directory;
+                else
+                    std::cout << "ERROR::FILE_WATCHER::WATCH_FAILED: " << directory << std::endl;
+            }
+        }
+#endif
+        return file;
+    }
+
+    // the watched files that changed and have settled since the last call. call from the render thread.
+    std::vector<std::string> poll()
+    {
+        std::vector<std::string> changed;
+        auto now = std::chrono::steady_clock::now();
+        std::lock_guard<std::mutex> lock(mutex);
+        for(auto it = pending.begin(); it != pending.end();)
+        {
+            if(now - it->second >= debounce)
+            {
+                changed.push_back(it->first);
+                it = pending.erase(it);
+            }
+            else
+                ++it;
+        }
+        return changed;
+    }
+
+private:
+    std::chrono::milliseconds debounce;
+    std::thread worker;
+    std::atomic<bool> quit{false};
+    std::mutex mutex;
+    std::map<std::string, long long> files;   // watched file -> last seen modification time
+    std::map<std::string, std::chrono::steady_clock::time_point> pending; // changed file -> time of its last event
+#ifdef __linux__
+    int fd = -1;
+    std::map<int, std::string> directories;   // inotify watch descriptor -> directory
+#endif
+
+    static long long modificationTime(const std::string &path)
+    {
+        struct stat info;
+        if(stat(path.c_str(), &info) != 0)
+            return -1;
+        return static_cast<long long>(info.st_mtime);
+    }
+
+    void run()
+    {
+        while(!quit)
+        {
+#ifdef __linux__
+            if(fd >= 0)
+            {
+                readEvents();
+                continue;
+            }
+#endif
+            std::this_thread::sleep_for(std::chrono::milliseconds(250));
+            std::lock_guard<std::mutex> lock(mutex);
+            for(auto &file : files)
+            {
+                long long time = modificationTime(file.first);
+                if(time != file.second)
+                {
+                    file.second = time;
+                    pending[file.first] = std::chrono::steady_clock::now();
+                }
+            }
+        }
+    }
+
+#ifdef __linux__
+    void readEvents()
+    {
+        // wake up regularly to notice quit
+        pollfd request = { fd, POLLIN, 0 };
+        if(::poll(&request, 1, 100) <= 0)
+            return;
+        alignas(inotify_event) char buffer[4096];
+        ssize_t length;
+        while((length = read(fd, buffer, sizeof(buffer))) > 0)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for(char *p = buffer; p < buffer + length;)
+            {
+                const inotify_event *event = reinterpret_cast<const inotify_event*>(p);
+                p += sizeof(inotify_event) + event->len;
+                auto directory = directories.find(event->wd);
+                if(event->len == 0 || directory == directories.end())
+                    continue;
+                std::string file = directory->second + '/' + event->name;
+                if(files.count(file))
+                    pending[file] = std::chrono::steady_clock::now();
+            }
+        }
+    }
+#endif
+};
+#endif
@@ -0,0 +1,172 @@
+#ifndef FLEET_H
+#define FLEET_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <bounds_culling.h>
+#include <frustum.h>
+#include <gl43.h>
+#include <gpu_culling.h>
+#include <lod.h>
+#include <model.h>
+#include <occlusion_culler.h>
+#include <render_queue.h>
+#include <shader.h>
+#include <vertex_format.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// one copy of the fleet's model
+struct FleetInstance {
+    glm::vec3 position = glm::vec3(0.0f);
+    glm::quat rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+    float scale = 1.0f;
+    glm::vec4 tint = glm::vec4(1.0f);
+    uint32_t livery = 0; // picks a colour from the palette in fleet.vert
+};
+
+// draws many copies of one model with hardware instancing instead of a Draw and a "model" upload each.
+// every frame the world space boxes of the instances are culled against the view frustum (see
+// bounds_culling.h), the visible ones get a level of detail and are written, grouped by level, to one
+// streamed buffer of InstanceTransforms. with occlusion set the boxes that survive the frustum are also
+// tested against its depth pyramid. each level is then one instanced draw per mesh, so the number
+// of draws doesn't grow with the fleet. draw with a shader that reads the instance attributes (fleet.vert).
+//
+// with a 4.3 context and cullShader set (fleet_cull.comp) the culling, level selection and draw
+// generation run on the GPU instead (see gpu_culling.h) and the per frame CPU cost no longer depends
+// on the number of instances, but without occlusion culling. older contexts keep using the CPU path.
+class Fleet {
+public:
+    std::vector<FleetInstance> instances; // call InstancesChanged after changing them
+    unsigned int visible = 0;             // instances drawn by the last Submit, not known when culledOnGpu
+    bool culledOnGpu = false;             // whether the last Submit took the GPU path
+    Shader *cullShader = nullptr;
+    const OcclusionCuller *occlusion = nullptr; // rasterized for this frame's view, CPU path only
+
+    explicit Fleet(Model &model) : model(&model) {}
+    ~Fleet()
+    {
+        if(VBO != 0)
+            glDeleteBuffers(1, &VBO);
+    }
+    Fleet(const Fleet&) = delete;
+    Fleet &operator=(const Fleet&) = delete;
+
+    // the GPU path keeps the instances on the GPU and uploads them again only after this
+    void InstancesChanged() { uploaded = false; }
+
+    void Submit(RenderQueue &queue, Shader &shader, const glm::mat4 &projection, const glm::mat4 &view, const glm::vec3 &cameraPosition,
+                float fovY, float viewportHeight)
+    {
+        visible = 0;
+        // the CPU path fills in while the compute program is still being built
+        culledOnGpu = cullShader != nullptr && GL43::get().supported && cullShader->ready();
+        if(instances.empty() || model->lodErrors.empty())
+            return;
+        if(culledOnGpu)
+        {
+            if(!gpu)
+                gpu.reset(new GpuFleetCulling());
+            if(!uploaded || uploadedCount != instances.size())
+            {
+                packed.resize(instances.size());
+                for(size_t i = 0; i < instances.size(); i++)
+                    packed[i] = packInstanceTransform(instances[i].position, instances[i].rotation, instances[i].scale, instances[i].tint, instances[i].livery);
+                gpu->setInstances(packed);
+                uploaded = true;
+                uploadedCount = instances.size();
+            }
+            gpu->submit(queue, *cullShader, shader, *model, projection, view, cameraPosition, fovY, viewportHeight);
+            return;
+        }
+        Frustum frustum = Frustum::fromMatrix(projection * view);
+        lods.resize(instances.size());
+        levels.assign(instances.size(), -1);
+        const size_t levelCount = model->lodErrors.size();
+        std::vector<unsigned int> counts(levelCount, 0);
+        std::vector<float> nearest(levelCount, 1e30f); // depth of the closest instance of each level
+
+        // world space box of every instance, culled eight at a time
+        BoundsSoA modelBounds;
+        modelBounds.resize(1);
+        modelBounds.set(0, model->boundsMin, model->boundsMax);
+        worldBounds.resize(instances.size());
+        for(size_t i = 0; i < instances.size(); i++)
+        {
+            const FleetInstance &instance = instances[i];
+            worldBounds.setTransformed(i, modelBounds, 0, glm::mat3_cast(instance.rotation) * instance.scale, instance.position);
+        }
+        visibleInstances.clear();
+        cullBounds(frustum, worldBounds, visibleInstances);
+        if(occlusion)
+        {
+            size_t kept = 0;
+            for(uint32_t i : visibleInstances)
+            {
+                glm::vec3 center(worldBounds.centerX[i], worldBounds.centerY[i], worldBounds.centerZ[i]);
+                glm::vec3 extent(worldBounds.extentX[i], worldBounds.extentY[i], worldBounds.extentZ[i]);
+                if(occlusion->visible(center - extent, center + extent))
+                    visibleInstances[kept++] = i;
+            }
+            visibleInstances.resize(kept);
+        }
+        if(visibleInstances.empty())
+            return;
+
+        // the box center is where the bounding sphere's center ended up
+        for(uint32_t i : visibleInstances)
+        {
+            glm::vec3 center(worldBounds.centerX[i], worldBounds.centerY[i], worldBounds.centerZ[i]);
+            int level = model->SelectLod(lods[i], center, instances[i].scale, cameraPosition, fovY, viewportHeight);
+            levels[i] = static_cast<int8_t>(level);
+            counts[level]++;
+            nearest[level] = std::min(nearest[level], -(view * glm::vec4(center, 1.0f)).z);
+        }
+        visible = static_cast<unsigned int>(visibleInstances.size());
+
+        // write them grouped by level, each level reads its own range
+        std::vector<unsigned int> first(levelCount, 0);
+        for(size_t l = 1; l < levelCount; l++)
+            first[l] = first[l - 1] + counts[l - 1];
+        std::vector<unsigned int> cursor = first;
+        packed.resize(visible);
+        for(uint32_t i : visibleInstances)
+        {
+            const FleetInstance &instance = instances[i];
+            packed[cursor[levels[i]]++] = packInstanceTransform(instance.position, instance.rotation, instance.scale, instance.tint, instance.livery);
+        }
+
+        // orphan the buffer, the driver hands out fresh memory instead of waiting for last frame's draws
+        if(VBO == 0)
+            glGenBuffers(1, &VBO);
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        capacity = std::max(capacity, packed.size());
+        glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(InstanceTransform), NULL, GL_STREAM_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, packed.size() * sizeof(InstanceTransform), packed.data());
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        for(size_t l = 0; l < levelCount; l++)
+            if(counts[l] > 0)
+                model->SubmitInstances(queue, shader, VBO, first[l] * sizeof(InstanceTransform), static_cast<GLsizei>(counts[l]),
+                                       static_cast<int>(l), nearest[l]);
+    }
+
+private:
+    Model *model;
+    unsigned int VBO = 0;
+    size_t capacity = 0; // in instances
+    std::vector<LodState> lods;       // per instance, for the selector's hysteresis
+    std::vector<int8_t> levels;       // of the last Submit, -1 for culled instances
+    BoundsSoA worldBounds;            // per instance
+    std::vector<uint32_t> visibleInstances;
+    std::vector<InstanceTransform> packed;
+    std::unique_ptr<GpuFleetCulling> gpu;
+    bool uploaded = false;    // whether gpu has the current instances
+    size_t uploadedCount = 0;
+};
+#endif
@@ -0,0 +1,51 @@
+#ifndef FRAME_UNIFORMS_H
+#define FRAME_UNIFORMS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <shader.h>
+
+// camera and light data every shader reads, kept in one uniform buffer that is written once per frame
+// and stays bound to FRAME_BLOCK_BINDING, instead of being set on each program by name.
+//
+// std140 layout of the Frame block in the shaders:
+//   layout (std140) uniform Frame { mat4 projection; mat4 view; vec3 viewPos; vec3 lightPos; vec3 lightColor; };
+// a vec3 takes 16 bytes there, hence the vec4s.
+struct FrameUniforms {
+    glm::mat4 projection;
+    glm::mat4 view;
+    glm::vec4 viewPos;
+    glm::vec4 lightPos;
+    glm::vec4 lightColor;
+};
+static_assert(sizeof(FrameUniforms) == 176, "FrameUniforms has to match the std140 Frame block");
+
+class FrameUniformBuffer {
+public:
+    FrameUniformBuffer()
+    {
+        glGenBuffers(1, &UBO);
+        glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameUniforms), nullptr, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        glBindBufferBase(GL_UNIFORM_BUFFER, FRAME_BLOCK_BINDING, UBO);
+    }
+    ~FrameUniformBuffer()
+    {
+        glDeleteBuffers(1, &UBO);
+    }
+    FrameUniformBuffer(const FrameUniformBuffer&) = delete;
+    FrameUniformBuffer &operator=(const FrameUniformBuffer&) = delete;
+
+    void update(const FrameUniforms &frame)
+    {
+        glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameUniforms), &frame);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+
+private:
+    unsigned int UBO = 0;
+};
+#endif
@@ -0,0 +1,57 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <glm/glm.hpp>
+
+// view frustum as 6 planes (left, right, bottom, top, near, far), normals pointing inwards.
+// a point p is inside when dot(plane.xyz, p) + plane.w >= 0 for every plane.
+struct Frustum {
+    glm::vec4 planes[6];
+
+    // extracts the planes from a clip matrix (Gribb/Hartmann). pass projection * view for world space planes,
+    // or projection * view * model to get them in that model's object space.
+    static Frustum fromMatrix(const glm::mat4 &m)
+    {
+        Frustum f;
+        glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+        glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+        glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+        glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+        f.planes[0] = row3 + row0;
+        f.planes[1] = row3 - row0;
+        f.planes[2] = row3 + row1;
+        f.planes[3] = row3 - row1;
+        f.planes[4] = row3 + row2;
+        f.planes[5] = row3 - row2;
+        for(int i = 0; i < 6; i++)
+        {
+            float len = glm::length(glm::vec3(f.planes[i]));
+            if(len > 0.0f)
+                f.planes[i] /= len;
+        }
+        return f;
+    }
+
+    bool intersectsSphere(const glm::vec3 &center, float radius) const
+    {
+        for(int i = 0; i < 6; i++)
+            if(glm::dot(glm::vec3(planes[i]), center) + planes[i].w < -radius)
+                return false;
+        return true;
+    }
+
+    bool intersectsAABB(const glm::vec3 &min, const glm::vec3 &max) const
+    {
+        for(int i = 0; i < 6; i++)
+        {
+            // test the corner furthest along the plane normal
+            glm::vec3 p(planes[i].x >= 0.0f ? max.x : min.x,
+                        planes[i].y >= 0.0f ? max.y : min.y,
+                        planes[i].z >= 0.0f ? max.z : min.z);
+            if(glm::dot(glm::vec3(planes[i]), p) + planes[i].w < 0.0f)
+                return false;
+        }
+        return true;
+    }
+};
+#endif
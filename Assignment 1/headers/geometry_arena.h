@@ -0,0 +1,145 @@
+#ifndef GEOMETRY_ARENA_H
+#define GEOMETRY_ARENA_H
+
+#include <glad/glad.h> // holds all OpenGL type declarations
+
+#include <gl_state.h>
+#include <mesh.h>
+#include <vertex_format.h>
+
+#include <map>
+#include <vector>
+using namespace std;
+
+// one multi draw call: every mesh in the arena that shares a material
+struct DrawBatch {
+    unsigned int materialIndex;
+    unsigned int firstMesh;          // any mesh of the batch, used to bind the material's textures
+    vector<unsigned int> meshIndices;
+    vector<GLsizei> counts;
+    vector<void*>   offsets;         // byte offsets into the shared index buffer
+    vector<GLint>   baseVertices;
+};
+
+// packs all meshes of a model into one vertex buffer and one index buffer behind a single VAO.
+// each mesh keeps its own 0-based indices and is addressed through a base vertex, so 16 bit indices
+// still work as long as every individual mesh has <= 65536 vertices.
+class GeometryArena {
+public:
+    unsigned int VAO = 0;
+    unsigned int VBO = 0, EBO = 0;
+    VertexLayout layout;
+    GLenum indexType = GL_UNSIGNED_INT;
+    size_t vertexBytes = 0, indexBytes = 0;
+
+    // uploads the meshes and points each of them at its range inside the shared buffers
+    void build(vector<Mesh> &meshes, const VertexLayout &vertexLayout)
+    {
+        layout = vertexLayout;
+
+        size_t maxVertices = 0, vertexCount = 0, indexCount = 0;
+        for(unsigned int i = 0; i < meshes.size(); i++)
+        {
+            if(meshes[i].sharesGeometry)
+                continue;
+            maxVertices = std::max(maxVertices, meshes[i].vertices.size());
+            vertexCount += meshes[i].vertices.size();
+            indexCount += meshes[i].indices.size();
+            for(const MeshLod &lod : meshes[i].lods)
+                indexCount += lod.indices.size();
+        }
+        indexType = chooseIndexType(layout, maxVertices);
+
+        // concatenate everything on the CPU first so each buffer is a single upload
+        const size_t stride = layout.stride();
+        vector<unsigned char> vertexData;
+        vector<unsigned char> indexData;
+        vertexData.reserve(vertexCount * stride);
+        indexData.reserve(indexCount * indexSize(indexType));
+        for(unsigned int i = 0; i < meshes.size(); i++)
+        {
+            Mesh &mesh = meshes[i];
+            if(mesh.sharesGeometry)
+                continue; // drawn from the copy that is uploaded already
+            mesh.VAO = 0; // set below once the VAO exists
+            mesh.indexType = indexType;
+            mesh.layout = layout;
+            mesh.baseVertex = static_cast<GLint>(vertexData.size() / stride);
+            mesh.indexOffset = indexData.size();
+            mesh.indexCount = static_cast<GLsizei>(mesh.indices.size());
+
+            vector<unsigned char> packedVertices = packVertices(mesh.vertices, layout);
+            vector<unsigned char> packedIndices = packIndices(mesh.indices, indexType);
+            vertexData.insert(vertexData.end(), packedVertices.begin(), packedVertices.end());
+            indexData.insert(indexData.end(), packedIndices.begin(), packedIndices.end());
+
+            // the levels of detail index the same vertices, so they just follow the full detail indices
+            for(MeshLod &lod : mesh.lods)
+            {
+                lod.indexOffset = indexData.size();
+                lod.indexCount = static_cast<GLsizei>(lod.indices.size());
+                vector<unsigned char> packedLod = packIndices(lod.indices, indexType);
+                indexData.insert(indexData.end(), packedLod.begin(), packedLod.end());
+            }
+        }
+        vertexBytes = vertexData.size();
+        indexBytes = indexData.size();
+
+        glGenVertexArrays(1, &VAO);
+        glGenBuffers(1, &VBO);
+        glGenBuffers(1, &EBO);
+
+        GLState::current().bindVertexArray(VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        glBufferData(GL_ARRAY_BUFFER, vertexData.size(), vertexData.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexData.size(), indexData.data(), GL_STATIC_DRAW);
+        setupVertexAttributes(layout);
+
+        for(unsigned int i = 0; i < meshes.size(); i++)
+            if(!meshes[i].sharesGeometry)
+                meshes[i].VAO = VAO;
+    }
+
+    // deletes the buffers, e.g. before the model is replaced by a reloaded one
+    void release()
+    {
+        if(VAO == 0)
+            return;
+        GLState::current().forgetVertexArray(VAO);
+        glDeleteVertexArrays(1, &VAO);
+        glDeleteBuffers(1, &VBO);
+        glDeleteBuffers(1, &EBO);
+        VAO = VBO = EBO = 0;
+        vertexBytes = indexBytes = 0;
+    }
+
+    // groups the meshes by material, one DrawBatch per material
+    static vector<DrawBatch> buildBatches(const vector<Mesh> &meshes)
+    {
+        map<unsigned int, DrawBatch> byMaterial;
+        for(unsigned int i = 0; i < meshes.size(); i++)
+        {
+            const Mesh &mesh = meshes[i];
+            if(mesh.indexCount == 0 || mesh.sharesGeometry)
+                continue;
+            auto it = byMaterial.find(mesh.materialIndex);
+            if(it == byMaterial.end())
+            {
+                DrawBatch batch;
+                batch.materialIndex = mesh.materialIndex;
+                batch.firstMesh = i;
+                it = byMaterial.emplace(mesh.materialIndex, batch).first;
+            }
+            it->second.meshIndices.push_back(i);
+            it->second.counts.push_back(mesh.indexCount);
+            it->second.offsets.push_back(reinterpret_cast<void*>(mesh.indexOffset));
+            it->second.baseVertices.push_back(mesh.baseVertex);
+        }
+        vector<DrawBatch> batches;
+        for(auto &entry : byMaterial)
+            batches.push_back(entry.second);
+        return batches;
+    }
+};
+#endif
@@ -0,0 +1,175 @@
+#ifndef GEOMETRY_REGISTRY_H
+#define GEOMETRY_REGISTRY_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cooked_asset.h>
+#include <geometry_arena.h>
+#include <mesh.h>
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+// content hashed registry of the geometry on the GPU. exporters like OBJ bake every copy of a wheel or a
+// propeller into its own mesh at its own position, so meshes are compared with their positions relative to
+// their bounds minimum: copies that only differ by a translation share one GPU allocation and are drawn
+// as instances of it with a per instance offset. the hash only narrows the search: while loading, the registry
+// keeps what was hashed for every registered geometry and a match has to compare equal in full. seal() drops
+// those copies once loading is done, sealed geometry is no longer shared with later uploads.
+
+// identifies a mesh's geometry regardless of where it sits
+struct GeometryKey {
+    uint64_t hash = 0;
+    uint32_t vertexCount = 0, indexCount = 0;
+
+    bool operator<(const GeometryKey &other) const
+    {
+        return std::tie(hash, vertexCount, indexCount) < std::tie(other.hash, other.vertexCount, other.indexCount);
+    }
+};
+
+// where the registered copy of some geometry lives
+struct SharedGeometry {
+    unsigned int VAO = 0;
+    GLenum indexType = GL_UNSIGNED_INT;
+    GLint baseVertex = 0;
+    size_t indexOffset = 0;
+    GLsizei indexCount = 0;
+    vector<std::pair<size_t, GLsizei>> lods; // index offset and count of each level of detail
+    glm::vec3 origin = glm::vec3(0.0f);      // bounds minimum of the registered copy
+    shared_ptr<GeometryArena> arena;         // holds the buffers while any model draws this geometry
+};
+
+// what a GeometryKey is hashed from, a CPU copy of the geometry as it is compared
+struct GeometryData {
+    vector<int32_t> positions;        // quantized, three per vertex
+    vector<unsigned char> attributes; // the rest of every vertex
+    vector<unsigned int> indices;     // the layout, the mesh's indices, then every level of detail's count and indices
+
+    bool operator==(const GeometryData &other) const
+    {
+        return positions == other.positions && indices == other.indices && attributes == other.attributes;
+    }
+};
+
+// positions are compared relative to the bounds minimum, quantized to 1/2^20 of the mesh's size so the float
+// rounding of the translation doesn't matter. everything else has to match bit for bit. data receives
+// what was hashed, for telling apart geometry whose keys collide.
+inline GeometryKey geometryKey(const Mesh &mesh, const VertexLayout &layout, GeometryData &data)
+{
+    GeometryKey key;
+    key.vertexCount = static_cast<uint32_t>(mesh.vertices.size());
+    key.indexCount = static_cast<uint32_t>(mesh.indices.size());
+
+    glm::vec3 extent = mesh.boundsMax - mesh.boundsMin;
+    float step = glm::max(glm::max(extent.x, extent.y), glm::max(extent.z, 1e-6f)) / float(1 << 20);
+    const size_t attributes = offsetof(Vertex, Normal);
+    data.positions.clear();
+    data.positions.reserve(mesh.vertices.size() * 3);
+    data.attributes.clear();
+    data.attributes.reserve(mesh.vertices.size() * (sizeof(Vertex) - attributes));
+    for(const Vertex &v : mesh.vertices)
+    {
+        glm::vec3 relative = (v.Position - mesh.boundsMin) / step;
+        data.positions.push_back(int32_t(std::lround(relative.x)));
+        data.positions.push_back(int32_t(std::lround(relative.y)));
+        data.positions.push_back(int32_t(std::lround(relative.z)));
+        const unsigned char *rest = reinterpret_cast<const unsigned char*>(&v) + attributes;
+        data.attributes.insert(data.attributes.end(), rest, rest + (sizeof(Vertex) - attributes));
+    }
+    data.indices = { unsigned(layout.normals), unsigned(layout.tangents), unsigned(layout.texCoords), unsigned(layout.bones), layout.allow16BitIndices ? 1u : 0u };
+    data.indices.insert(data.indices.end(), mesh.indices.begin(), mesh.indices.end());
+    for(const MeshLod &lod : mesh.lods)
+    {
+        data.indices.push_back(static_cast<unsigned int>(lod.indices.size()));
+        data.indices.insert(data.indices.end(), lod.indices.begin(), lod.indices.end());
+    }
+
+    uint64_t hash = hashBytes(data.positions.data(), data.positions.size() * sizeof(int32_t));
+    hash = hashBytes(data.attributes.data(), data.attributes.size(), hash);
+    key.hash = hashBytes(data.indices.data(), data.indices.size() * sizeof(unsigned int), hash);
+    return key;
+}
+
+class GeometryRegistry {
+public:
+    // the registered geometry with this key whose contents equal data, if any
+    const SharedGeometry *find(const GeometryKey &key, const GeometryData &data) const
+    {
+        auto range = entries.equal_range(key);
+        for(auto it = range.first; it != range.second; ++it)
+            if(!it->second.sealed && it->second.data == data)
+                return &it->second.geometry;
+        return nullptr;
+    }
+
+    // registers a mesh that was uploaded into arena, the first copy of some geometry wins
+    void add(const GeometryKey &key, const GeometryData &data, const Mesh &mesh, const shared_ptr<GeometryArena> &arena)
+    {
+        if(find(key, data))
+            return;
+        Entry entry;
+        entry.data = data;
+        SharedGeometry &geometry = entry.geometry;
+        geometry.VAO = mesh.VAO;
+        geometry.indexType = mesh.indexType;
+        geometry.baseVertex = mesh.baseVertex;
+        geometry.indexOffset = mesh.indexOffset;
+        geometry.indexCount = mesh.indexCount;
+        for(const MeshLod &lod : mesh.lods)
+            geometry.lods.push_back(std::make_pair(lod.indexOffset, lod.indexCount));
+        geometry.origin = mesh.boundsMin;
+        geometry.arena = arena;
+        entries.emplace(key, std::move(entry));
+    }
+
+    // forgets the geometry of an arena whose model is released. instance groups that copied it keep their
+    // reference, the arena is deleted by whichever model releases it last
+    void remove(unsigned int VAO)
+    {
+        for(auto it = entries.begin(); it != entries.end();)
+        {
+            if(it->second.geometry.VAO == VAO)
+                it = entries.erase(it);
+            else
+                ++it;
+        }
+    }
+
+    // frees the CPU copies kept for comparing, the registered geometry stays until remove()
+    void seal()
+    {
+        for(auto &entry : entries)
+        {
+            entry.second.data = GeometryData();
+            entry.second.sealed = true;
+        }
+    }
+
+    size_t size() const { return entries.size(); }
+
+private:
+    struct Entry {
+        GeometryData data;
+        SharedGeometry geometry;
+        bool sealed = false; // data was dropped, nothing can match it anymore
+    };
+    // keys can collide, so several geometries may share one
+    multimap<GeometryKey, Entry> entries;
+};
+
+// the copies of one registered geometry in a model, drawn with one instanced call
+struct InstanceGroup {
+    SharedGeometry geometry;
+    unsigned int firstMesh;            // any mesh of the group, used to bind the material's textures
+    vector<unsigned int> meshIndices;
+    vector<glm::vec3> offsets;         // per instance translation from the registered copy
+};
+#endif
@@ -0,0 +1,71 @@
+#ifndef GL43_H
+#define GL43_H
+
+#include <glad/glad.h>
+
+#include <iostream>
+
+// the parts of GL 4.3 the GPU driven paths use (compute shaders, shader storage buffers, multi draw
+// indirect). glad is generated for 4.1, so they are loaded here, and only when the context is 4.3 or
+// newer. everything that uses them checks GL43::get().supported and falls back to the CPU path otherwise.
+#ifndef GL_SHADER_STORAGE_BUFFER
+#define GL_SHADER_STORAGE_BUFFER 0x90D2
+#endif
+#ifndef GL_COMPUTE_SHADER
+#define GL_COMPUTE_SHADER 0x91B9
+#endif
+#ifndef GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT
+#define GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT 0x00000001
+#endif
+#ifndef GL_COMMAND_BARRIER_BIT
+#define GL_COMMAND_BARRIER_BIT 0x00000040
+#endif
+#ifndef GL_SHADER_STORAGE_BARRIER_BIT
+#define GL_SHADER_STORAGE_BARRIER_BIT 0x00002000
+#endif
+
+typedef void (APIENTRYP PFNGL43DISPATCHCOMPUTEPROC)(GLuint groupsX, GLuint groupsY, GLuint groupsZ);
+typedef void (APIENTRYP PFNGL43MEMORYBARRIERPROC)(GLbitfield barriers);
+typedef void (APIENTRYP PFNGL43MULTIDRAWELEMENTSINDIRECTPROC)(GLenum mode, GLenum type, const void *indirect, GLsizei drawCount, GLsizei stride);
+typedef void (APIENTRYP PFNGL43CLEARBUFFERDATAPROC)(GLenum target, GLenum internalFormat, GLenum format, GLenum type, const void *data);
+
+// the record glMultiDrawElementsIndirect reads per draw
+struct DrawElementsIndirectCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;   // in indices, not bytes
+    GLint  baseVertex;
+    GLuint baseInstance; // offsets the instanced attributes too
+};
+static_assert(sizeof(DrawElementsIndirectCommand) == 20, "DrawElementsIndirectCommand is read by GL with this layout");
+
+struct GL43 {
+    bool supported = false;
+    PFNGL43DISPATCHCOMPUTEPROC dispatchCompute = nullptr;
+    PFNGL43MEMORYBARRIERPROC memoryBarrier = nullptr;
+    PFNGL43MULTIDRAWELEMENTSINDIRECTPROC multiDrawElementsIndirect = nullptr;
+    PFNGL43CLEARBUFFERDATAPROC clearBufferData = nullptr;
+
+    static GL43 &get()
+    {
+        static GL43 gl;
+        return gl;
+    }
+
+    // call once after gladLoadGLLoader with the same loader. false on contexts older than 4.3
+    bool load(GLADloadproc loader)
+    {
+        supported = false;
+        if(GLVersion.major < 4 || (GLVersion.major == 4 && GLVersion.minor < 3))
+            return false;
+        dispatchCompute = reinterpret_cast<PFNGL43DISPATCHCOMPUTEPROC>(loader("glDispatchCompute"));
+        memoryBarrier = reinterpret_cast<PFNGL43MEMORYBARRIERPROC>(loader("glMemoryBarrier"));
+        multiDrawElementsIndirect = reinterpret_cast<PFNGL43MULTIDRAWELEMENTSINDIRECTPROC>(loader("glMultiDrawElementsIndirect"));
+        clearBufferData = reinterpret_cast<PFNGL43CLEARBUFFERDATAPROC>(loader("glClearBufferData"));
+        supported = dispatchCompute && memoryBarrier && multiDrawElementsIndirect && clearBufferData;
+        if(!supported)
+            std::cout << "ERROR::GL43::MISSING_ENTRY_POINTS: the context reports 4.3, staying on the CPU paths" << std::endl;
+        return supported;
+    }
+};
+#endif
@@ -0,0 +1,176 @@
+#ifndef GL_STATE_H
+#define GL_STATE_H
+
+#include <glad/glad.h>
+
+// shadows the GL state the renderer changes per draw (program, VAO, texture units, depth and blend
+// state) and skips calls that wouldn't change anything. all binds of these go through here, so the
+// shadow is always right and nobody has to reset state to defaults after drawing. code that deletes
+// a program, VAO or texture tells the shadow with forget*(), since GL reuses names.
+struct GLStateStats {
+    unsigned int issued = 0; // calls that reached GL
+    unsigned int elided = 0; // calls skipped because the state was already set
+};
+
+class GLState {
+public:
+    static constexpr unsigned int MAX_TEXTURE_UNITS = 32;
+
+    // the state of the one context the application renders with
+    static GLState &current()
+    {
+        static GLState state;
+        return state;
+    }
+
+    void useProgram(GLuint program)
+    {
+        if(!changes(boundProgram, program))
+            return;
+        glUseProgram(program);
+    }
+
+    void bindVertexArray(GLuint vao)
+    {
+        if(!changes(boundVertexArray, vao))
+            return;
+        glBindVertexArray(vao);
+    }
+
+    void bindTexture(unsigned int unit, GLenum target, GLuint texture)
+    {
+        // only 2D and cube map bindings are shadowed, anything else always goes through
+        GLuint *bound = nullptr;
+        if(unit < MAX_TEXTURE_UNITS && target == GL_TEXTURE_2D)
+            bound = &units[unit].texture2D;
+        else if(unit < MAX_TEXTURE_UNITS && target == GL_TEXTURE_CUBE_MAP)
+            bound = &units[unit].cubeMap;
+        if(bound && *bound == texture)
+        {
+            stats.elided++;
+            return;
+        }
+        activeTexture(unit);
+        glBindTexture(target, texture);
+        if(bound)
+            *bound = texture;
+        stats.issued++;
+    }
+
+    // binds texture on whichever unit is active, for uploading to it
+    void bindTextureForUpload(GLenum target, GLuint texture)
+    {
+        bindTexture(activeUnit == UNKNOWN ? 0 : activeUnit, target, texture);
+    }
+
+    void depthFunc(GLenum func)
+    {
+        if(!changes(depthFunction, func))
+            return;
+        glDepthFunc(func);
+    }
+
+    void depthMask(bool write)
+    {
+        if(!changes(depthWrite, write ? 1u : 0u))
+            return;
+        glDepthMask(write ? GL_TRUE : GL_FALSE);
+    }
+
+    void blend(bool enable)
+    {
+        if(!changes(blending, enable ? 1u : 0u))
+            return;
+        if(enable)
+            glEnable(GL_BLEND);
+        else
+            glDisable(GL_BLEND);
+    }
+
+    void blendFunc(GLenum source, GLenum destination)
+    {
+        if(blendSource == source && blendDestination == destination)
+        {
+            stats.elided++;
+            return;
+        }
+        blendSource = source;
+        blendDestination = destination;
+        stats.issued++;
+        glBlendFunc(source, destination);
+    }
+
+    // the object is about to be deleted, its name may come back for something else
+    void forgetProgram(GLuint program)
+    {
+        if(boundProgram == program)
+            boundProgram = UNKNOWN;
+    }
+    void forgetVertexArray(GLuint vao)
+    {
+        if(boundVertexArray == vao)
+            boundVertexArray = UNKNOWN;
+    }
+    void forgetTexture(GLuint texture)
+    {
+        for(Unit &unit : units)
+        {
+            if(unit.texture2D == texture)
+                unit.texture2D = UNKNOWN;
+            if(unit.cubeMap == texture)
+                unit.cubeMap = UNKNOWN;
+        }
+    }
+
+    // for code that changed state behind the shadow's back
+    void invalidate()
+    {
+        GLStateStats kept = stats;
+        *this = GLState();
+        stats = kept;
+    }
+
+    // counts since the last call
+    GLStateStats takeStats()
+    {
+        GLStateStats taken = stats;
+        stats = GLStateStats();
+        return taken;
+    }
+
+private:
+    static constexpr GLuint UNKNOWN = ~0u;
+    struct Unit {
+        GLuint texture2D = UNKNOWN;
+        GLuint cubeMap = UNKNOWN;
+    };
+
+    GLuint boundProgram = UNKNOWN;
+    GLuint boundVertexArray = UNKNOWN;
+    GLuint activeUnit = UNKNOWN;
+    Unit units[MAX_TEXTURE_UNITS];
+    GLuint depthFunction = UNKNOWN, depthWrite = UNKNOWN, blending = UNKNOWN;
+    GLuint blendSource = UNKNOWN, blendDestination = UNKNOWN;
+    GLStateStats stats;
+
+    // updates the shadow, false (and counted as elided) if it already had the value
+    bool changes(GLuint &shadow, GLuint value)
+    {
+        if(shadow == value)
+        {
+            stats.elided++;
+            return false;
+        }
+        shadow = value;
+        stats.issued++;
+        return true;
+    }
+
+    void activeTexture(unsigned int unit)
+    {
+        if(!changes(activeUnit, unit))
+            return;
+        glActiveTexture(GL_TEXTURE0 + unit);
+    }
+};
+#endif
@@ -0,0 +1,208 @@
+#ifndef GPU_CULLING_H
+#define GPU_CULLING_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <frustum.h>
+#include <gl43.h>
+#include <model.h>
+#include <render_queue.h>
+#include <shader.h>
+#include <vertex_format.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// culls and draws the instances of a Fleet on the GPU (GL 4.3). the instances stay in a shader storage
+// buffer, fleet_cull.comp frustum culls them, picks their levels of detail and writes the visible ones
+// grouped by level, then fills in a DrawElementsIndirectCommand per mesh and level, which one
+// glMultiDrawElementsIndirect per material draws. per frame the CPU sets a few uniforms and issues two
+// dispatches and a handful of draws, however many instances there are.
+//
+// record r = draw * levels + level, where draw indexes the model's instancedDraws. its instances are
+// read from Visible at baseInstance = level * capacity.
+class GpuFleetCulling {
+public:
+    static const int MAX_LEVELS = 8; // as in fleet_cull.comp
+
+    GpuFleetCulling()
+    {
+        glGenBuffers(BUFFER_COUNT, buffers);
+    }
+    ~GpuFleetCulling()
+    {
+        glDeleteBuffers(BUFFER_COUNT, buffers);
+    }
+    GpuFleetCulling(const GpuFleetCulling&) = delete;
+    GpuFleetCulling &operator=(const GpuFleetCulling&) = delete;
+
+    // uploads the instances, only needed when they changed
+    void setInstances(const std::vector<InstanceTransform> &instances)
+    {
+        instanceCount = instances.size();
+        glBindBuffer(GL_ARRAY_BUFFER, buffers[INSTANCES]);
+        glBufferData(GL_ARRAY_BUFFER, std::max<size_t>(instanceCount, 1) * sizeof(InstanceTransform), instances.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        // the levels start over at 0, the output ranges are resized by the next submit
+        resize(buffers[LEVELS], std::max<size_t>(instanceCount, 1) * sizeof(GLuint));
+        clear(buffers[LEVELS]);
+        capacity = 0;
+    }
+
+    // culls the instances given to setInstances and queues the draws of model for the visible ones
+    void submit(RenderQueue &queue, Shader &cullShader, Shader &shader, Model &model, const glm::mat4 &projection, const glm::mat4 &view,
+                const glm::vec3 &cameraPosition, float fovY, float viewportHeight)
+    {
+        if(instanceCount == 0 || model.instancedDraws.empty())
+            return;
+        const GL43 &gl = GL43::get();
+        int levelCount = std::min<int>(static_cast<int>(model.lodErrors.size()), MAX_LEVELS);
+        if(&model != recordsModel || model.arena->VAO != recordsVAO || levelCount != recordLevels)
+            buildRecords(model, levelCount);
+        if(capacity != instanceCount * levelCount)
+        {
+            capacity = instanceCount * levelCount;
+            resize(buffers[VISIBLE], capacity * sizeof(InstanceTransform));
+        }
+
+        for(GLuint binding = 0; binding < BUFFER_COUNT; binding++)
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, buffers[binding]);
+        clear(buffers[COUNTS]);
+
+        Frustum frustum = Frustum::fromMatrix(projection * view);
+        cullShader.use();
+        cullShader.setInt(INSTANCE_COUNT_UNIFORM, static_cast<int>(instanceCount));
+        cullShader.setInt(CAPACITY_UNIFORM, static_cast<int>(instanceCount));
+        cullShader.setInt(RECORD_COUNT_UNIFORM, static_cast<int>(recordCount));
+        glUniform4fv(cullShader.location(FRUSTUM_PLANES_UNIFORM), 6, &frustum.planes[0][0]);
+        cullShader.setVec3(CAMERA_POSITION_UNIFORM, cameraPosition);
+        cullShader.setVec3(BOUNDS_CENTER_UNIFORM, model.boundsCenter);
+        cullShader.setFloat(BOUNDS_RADIUS_UNIFORM, model.boundsRadius);
+        cullShader.setInt(LEVEL_COUNT_UNIFORM, levelCount);
+        glUniform1fv(cullShader.location(LEVEL_ERRORS_UNIFORM), levelCount, model.lodErrors.data());
+        cullShader.setFloat(PIXELS_PER_UNIT_UNIFORM, viewportHeight / (2.0f * std::tan(fovY * 0.5f)));
+        cullShader.setFloat(PIXEL_THRESHOLD_UNIFORM, model.lodSelector.pixelThreshold);
+        cullShader.setFloat(HYSTERESIS_UNIFORM, model.lodSelector.hysteresis);
+
+        cullShader.setInt(PASS_UNIFORM, 0);
+        gl.dispatchCompute(workGroups(instanceCount), 1, 1);
+        gl.memoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+        cullShader.setInt(PASS_UNIFORM, 1);
+        gl.dispatchCompute(workGroups(recordCount), 1, 1);
+        gl.memoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+
+        DrawCommand command;
+        command.type = DrawCommand::Type::MultiElementsIndirect;
+        command.shader = &shader;
+        command.octNormals = model.arena->layout.normals == NormalEncoding::Octahedral;
+        command.instanceBuffer = buffers[VISIBLE];
+        command.instanceTransforms = true;
+        command.indirectBuffer = buffers[COMMANDS];
+        for(const Group &group : groups)
+        {
+            const InstancedDraw &draw = model.instancedDraws[group.firstDraw];
+            command.VAO = draw.VAO;
+            command.indexType = draw.indexType;
+            command.material = draw.material;
+            command.copyOffset = draw.copyOffset;
+            command.indirectOffset = group.firstDraw * levelCount * sizeof(DrawElementsIndirectCommand);
+            command.drawCount = static_cast<GLsizei>(group.draws * levelCount);
+            queue.submit(RenderBucket::Opaque, 0, 0.0f, command);
+        }
+    }
+
+private:
+    enum Buffer : GLuint { INSTANCES, VISIBLE, COUNTS, LEVELS, RANGES, COMMANDS, BUFFER_COUNT }; // also the SSBO bindings
+    // consecutive instanced draws that bind the same things, one multi draw each
+    struct Group {
+        size_t firstDraw;
+        size_t draws;
+    };
+
+    static constexpr UniformName PASS_UNIFORM = UniformName("pass");
+    static constexpr UniformName INSTANCE_COUNT_UNIFORM = UniformName("instanceCount");
+    static constexpr UniformName CAPACITY_UNIFORM = UniformName("capacity");
+    static constexpr UniformName RECORD_COUNT_UNIFORM = UniformName("recordCount");
+    static constexpr UniformName FRUSTUM_PLANES_UNIFORM = UniformName("frustumPlanes");
+    static constexpr UniformName CAMERA_POSITION_UNIFORM = UniformName("cameraPosition");
+    static constexpr UniformName BOUNDS_CENTER_UNIFORM = UniformName("boundsCenter");
+    static constexpr UniformName BOUNDS_RADIUS_UNIFORM = UniformName("boundsRadius");
+    static constexpr UniformName LEVEL_COUNT_UNIFORM = UniformName("levelCount");
+    static constexpr UniformName LEVEL_ERRORS_UNIFORM = UniformName("levelErrors");
+    static constexpr UniformName PIXELS_PER_UNIT_UNIFORM = UniformName("pixelsPerUnit");
+    static constexpr UniformName PIXEL_THRESHOLD_UNIFORM = UniformName("pixelThreshold");
+    static constexpr UniformName HYSTERESIS_UNIFORM = UniformName("hysteresis");
+
+    GLuint buffers[BUFFER_COUNT];
+    size_t instanceCount = 0;
+    size_t capacity = 0; // instances the Visible buffer holds, instanceCount per level
+    size_t recordCount = 0;
+    std::vector<Group> groups;
+    // what the records were built for. a reloaded model has a new VAO
+    const Model *recordsModel = nullptr;
+    unsigned int recordsVAO = 0;
+    int recordLevels = 0;
+
+    static GLuint workGroups(size_t invocations)
+    {
+        return static_cast<GLuint>((invocations + 63) / 64);
+    }
+
+    static void resize(GLuint buffer, size_t bytes)
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        glBufferData(GL_ARRAY_BUFFER, bytes, NULL, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    static void clear(GLuint buffer)
+    {
+        const GLuint zero = 0;
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        GL43::get().clearBufferData(GL_ARRAY_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    // the index ranges every record copies, and the groups of draws sharing a VAO, material and offset
+    void buildRecords(const Model &model, int levelCount)
+    {
+        std::vector<GLuint> ranges;
+        groups.clear();
+        for(size_t d = 0; d < model.instancedDraws.size(); d++)
+        {
+            const InstancedDraw &draw = model.instancedDraws[d];
+            for(int level = 0; level < levelCount; level++)
+            {
+                const std::pair<size_t, GLsizei> &range = draw.levels[std::min<size_t>(level, draw.levels.size() - 1)];
+                ranges.push_back(static_cast<GLuint>(range.second));
+                ranges.push_back(static_cast<GLuint>(range.first / indexSize(draw.indexType)));
+                ranges.push_back(static_cast<GLuint>(draw.baseVertex));
+                ranges.push_back(static_cast<GLuint>(level));
+            }
+            if(!groups.empty())
+            {
+                const InstancedDraw &previous = model.instancedDraws[d - 1];
+                if(previous.VAO == draw.VAO && previous.indexType == draw.indexType && previous.copyOffset == draw.copyOffset &&
+                   previous.material->sameBindings(*draw.material))
+                {
+                    groups.back().draws++;
+                    continue;
+                }
+            }
+            groups.push_back(Group{ d, 1 });
+        }
+        recordCount = model.instancedDraws.size() * levelCount;
+        glBindBuffer(GL_ARRAY_BUFFER, buffers[RANGES]);
+        glBufferData(GL_ARRAY_BUFFER, ranges.size() * sizeof(GLuint), ranges.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        resize(buffers[COMMANDS], recordCount * sizeof(DrawElementsIndirectCommand));
+        resize(buffers[COUNTS], MAX_LEVELS * sizeof(GLuint));
+        recordsModel = &model;
+        recordsVAO = model.arena->VAO;
+        recordLevels = levelCount;
+    }
+};
+#endif
@@ -0,0 +1,112 @@
+#ifndef IMAGE_RESAMPLE_H
+#define IMAGE_RESAMPLE_H
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define IMAGE_RESAMPLE_SSE2
+#endif
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// integer factor that brings the larger side of an image down to at most maxDimension (0 = no limit)
+inline uint32_t downsampleFactor(uint32_t width, uint32_t height, uint32_t maxDimension)
+{
+    uint32_t size = std::max(width, height);
+    if(maxDimension == 0 || size <= maxDimension)
+        return 1;
+    return (size + maxDimension - 1) / maxDimension;
+}
+
+// box filter that shrinks an image by an integer factor while it is fed one source row at a time.
+// only one row of column sums is kept, so memory doesn't depend on the image height. the edge pixels
+// average whatever part of the box lies inside the image.
+class BoxDownsampler {
+public:
+    uint32_t srcWidth = 0, srcHeight = 0;
+    uint32_t dstWidth = 0, dstHeight = 0;
+    uint32_t factor = 1;
+    int channels = 0;
+
+    void init(uint32_t width, uint32_t height, int channels, uint32_t factor)
+    {
+        srcWidth = width;
+        srcHeight = height;
+        this->channels = channels;
+        this->factor = std::max(1u, factor);
+        dstWidth = (width + this->factor - 1) / this->factor;
+        dstHeight = (height + this->factor - 1) / this->factor;
+        sums.assign(size_t(width) * channels, 0);
+        rows = 0;
+        srcRow = 0;
+    }
+
+    // adds a source row. returns true when an output row (dstWidth * channels bytes) was written to dst.
+    bool pushRow(const unsigned char *src, unsigned char *dst)
+    {
+        if(factor == 1)
+        {
+            std::memcpy(dst, src, size_t(srcWidth) * channels);
+            srcRow++;
+            return true;
+        }
+        accumulate(src);
+        rows++;
+        srcRow++;
+        if(rows < factor && srcRow < srcHeight)
+            return false;
+        resolve(dst);
+        std::fill(sums.begin(), sums.end(), 0u);
+        rows = 0;
+        return true;
+    }
+
+private:
+    std::vector<uint32_t> sums; // per source column and channel, over the rows of the current box
+    uint32_t rows = 0;          // rows in the current box so far
+    uint32_t srcRow = 0;
+
+    void accumulate(const unsigned char *src)
+    {
+        const size_t count = sums.size();
+        size_t i = 0;
+        uint32_t *sum = sums.data();
+#ifdef IMAGE_RESAMPLE_SSE2
+        // 16 bytes at a time, widened to 32 bit
+        const __m128i zero = _mm_setzero_si128();
+        for(; i + 16 <= count; i += 16)
+        {
+            __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+            __m128i lo = _mm_unpacklo_epi8(bytes, zero);
+            __m128i hi = _mm_unpackhi_epi8(bytes, zero);
+            __m128i *s = reinterpret_cast<__m128i*>(sum + i);
+            _mm_storeu_si128(s + 0, _mm_add_epi32(_mm_loadu_si128(s + 0), _mm_unpacklo_epi16(lo, zero)));
+            _mm_storeu_si128(s + 1, _mm_add_epi32(_mm_loadu_si128(s + 1), _mm_unpackhi_epi16(lo, zero)));
+            _mm_storeu_si128(s + 2, _mm_add_epi32(_mm_loadu_si128(s + 2), _mm_unpacklo_epi16(hi, zero)));
+            _mm_storeu_si128(s + 3, _mm_add_epi32(_mm_loadu_si128(s + 3), _mm_unpackhi_epi16(hi, zero)));
+        }
+#endif
+        for(; i < count; i++)
+            sum[i] += src[i];
+    }
+
+    // sums the columns of each box and divides by the number of texels it covered
+    void resolve(unsigned char *dst) const
+    {
+        for(uint32_t x = 0; x < dstWidth; x++)
+        {
+            uint32_t x0 = x * factor, x1 = std::min(x0 + factor, srcWidth);
+            uint32_t area = (x1 - x0) * rows;
+            for(int c = 0; c < channels; c++)
+            {
+                uint32_t total = 0;
+                for(uint32_t sx = x0; sx < x1; sx++)
+                    total += sums[size_t(sx) * channels + c];
+                dst[size_t(x) * channels + c] = static_cast<unsigned char>((total + area / 2) / area);
+            }
+        }
+    }
+};
+#endif
@@ -0,0 +1,45 @@
+#ifndef LOD_H
+#define LOD_H
+
+#include <glm/glm.hpp>
+
+#include <cmath>
+#include <vector>
+
+// per instance level of detail state, the selector needs to know what was picked last frame
+struct LodState {
+    int level = 0;
+};
+
+// picks the coarsest level whose simplification error projects to less than pixelThreshold pixels.
+// moving to a coarser level additionally requires the error to be hysteresis below the threshold, so an
+// instance sitting right at a switch distance doesn't flip between two levels every frame.
+struct LodSelector {
+    float pixelThreshold = 1.0f;
+    float hysteresis = 0.25f;
+
+    // levelErrors[i] is the object space error of level i (level 0 is the full mesh with error 0),
+    // distance is from the camera to the closest point of the instance's bounding sphere.
+    int select(const std::vector<float> &levelErrors, float distance, float fovY, float viewportHeight, int current) const
+    {
+        if(levelErrors.empty())
+            return 0;
+        // pixels per object space unit at that distance
+        float pixelsPerUnit = viewportHeight / (2.0f * std::tan(fovY * 0.5f) * glm::max(distance, 1e-4f));
+
+        int target = 0;
+        for(int level = 1; level < int(levelErrors.size()); level++)
+            if(levelErrors[level] * pixelsPerUnit <= pixelThreshold)
+                target = level;
+        while(target > current && levelErrors[target] * pixelsPerUnit > pixelThreshold * (1.0f - hysteresis))
+            target--;
+        return target;
+    }
+
+    int select(LodState &state, const std::vector<float> &levelErrors, float distance, float fovY, float viewportHeight) const
+    {
+        state.level = select(levelErrors, distance, fovY, viewportHeight, state.level);
+        return state.level;
+    }
+};
+#endif
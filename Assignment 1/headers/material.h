@@ -0,0 +1,185 @@
+#ifndef MATERIAL_H
+#define MATERIAL_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <gl_state.h>
+#include <shader.h>
+#include <virtual_texture.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct Texture {
+    unsigned int id;
+    std::string type;
+    std::string path;
+    VirtualTexture *virtualTexture = nullptr; // set instead of id for textures streamed as tiles, owned by the Model
+};
+
+// what a texture is used for, from its sampler name prefix
+enum class TextureUsage { Diffuse, Specular, Normal, Height, Other };
+
+inline TextureUsage textureUsage(const std::string &type)
+{
+    if(type == "texture_diffuse")
+        return TextureUsage::Diffuse;
+    if(type == "texture_specular")
+        return TextureUsage::Specular;
+    if(type == "texture_normal")
+        return TextureUsage::Normal;
+    if(type == "texture_height")
+        return TextureUsage::Height;
+    return TextureUsage::Other;
+}
+
+// the texture bindings and sampler uniforms of a mesh, worked out once when its textures are known.
+// sampler names (texture_diffuse1, texture_diffuse1_virtual, ...) and texture units are resolved in
+// build(); the uniform locations the first time the material is bound with a program, and again only
+// when that program is relinked. drawing just walks the lists. materials with the same bindings (meshes
+// of different models using the same textures) have the same key, so a render queue can sort them
+// together and bind them once.
+class Material {
+public:
+    // the Nth texture of a usage feeds the sampler <type>N. a virtual texture takes two units, the
+    // physical tile cache for the sampler and the page table for <type>N_pages. no GL calls.
+    void build(const std::vector<Texture> &textures)
+    {
+        clear();
+        unsigned int counts[5] = { 1, 1, 1, 1, 1 };
+        unsigned int unit = 0;
+        for(const Texture &texture : textures)
+        {
+            TextureUsage usage = textureUsage(texture.type);
+            std::string sampler = texture.type;
+            if(usage != TextureUsage::Other)
+                sampler += std::to_string(counts[int(usage)]++);
+
+            addInt(sampler, int(unit));
+            addInt(sampler + "_virtual", texture.virtualTexture != nullptr);
+            if(texture.virtualTexture)
+            {
+                const VirtualTexture *vt = texture.virtualTexture;
+                bindings.push_back({ unit++, GL_TEXTURE_2D, vt->physicalTexture });
+                bindings.push_back({ unit, GL_TEXTURE_2D, vt->pageTableTexture });
+                addInt(sampler + "_pages", int(unit));
+                UniformValue value(sampler + "_vt");
+                value.vector = true;
+                value.value = glm::vec4(float(vt->width()), float(vt->height()), float(vt->tileSize()), float(vt->border()));
+                uniforms.push_back(value);
+            }
+            else
+                bindings.push_back({ unit, GL_TEXTURE_2D, texture.id });
+            unit++;
+        }
+        updateKey();
+    }
+
+    void clear()
+    {
+        bindings.clear();
+        uniforms.clear();
+        revision = 0;
+        key = 0;
+    }
+
+    // binds texture of any target to the next free unit, for materials that aren't made from model textures
+    // (e.g. the skybox's cubemap)
+    void addTexture(GLenum target, unsigned int texture, const std::string &sampler)
+    {
+        unsigned int unit = bindings.empty() ? 0 : bindings.back().unit + 1;
+        bindings.push_back({ unit, target, texture });
+        addInt(sampler, int(unit));
+        updateKey();
+    }
+
+    // binds the textures to their units and sets the samplers on the shader, which has to be in use
+    void bind(const Shader &shader)
+    {
+        if(revision != shader.revision)
+        {
+            for(UniformValue &uniform : uniforms)
+                uniform.location = shader.location(uniform.name);
+            revision = shader.revision;
+        }
+        for(const TextureBinding &binding : bindings)
+            GLState::current().bindTexture(binding.unit, binding.target, binding.texture);
+        for(const UniformValue &uniform : uniforms)
+        {
+            if(uniform.location < 0)
+                continue;
+            if(uniform.vector)
+                glUniform4fv(uniform.location, 1, &uniform.value[0]);
+            else
+                glUniform1i(uniform.location, uniform.integer);
+        }
+    }
+
+    size_t textureBindings() const { return bindings.size(); }
+
+    // hash of the bindings and uniform values, equal for materials that bind the same things
+    uint32_t sortKey() const { return key; }
+
+    // whether binding other after this one would change nothing
+    bool sameBindings(const Material &other) const
+    {
+        if(key != other.key || bindings.size() != other.bindings.size() || uniforms.size() != other.uniforms.size())
+            return false;
+        for(size_t i = 0; i < bindings.size(); i++)
+            if(bindings[i].unit != other.bindings[i].unit || bindings[i].target != other.bindings[i].target || bindings[i].texture != other.bindings[i].texture)
+                return false;
+        for(size_t i = 0; i < uniforms.size(); i++)
+            if(uniforms[i].name.hash != other.uniforms[i].name.hash || uniforms[i].integer != other.uniforms[i].integer || uniforms[i].value != other.uniforms[i].value)
+                return false;
+        return true;
+    }
+
+private:
+    struct TextureBinding {
+        unsigned int unit;
+        GLenum target;
+        unsigned int texture;
+    };
+    struct UniformValue {
+        UniformName name;
+        GLint location = -1;
+        bool vector = false; // vec4 in value, int in integer otherwise
+        int integer = 0;
+        glm::vec4 value = glm::vec4(0.0f);
+
+        explicit UniformValue(const std::string &name) : name(name) {}
+    };
+
+    std::vector<TextureBinding> bindings;
+    std::vector<UniformValue> uniforms;
+    unsigned int revision = 0; // of the program the locations were resolved for, 0 for none
+    uint32_t key = 0;
+
+    void updateKey()
+    {
+        uint32_t hash = 2166136261u;
+        auto mix = [&hash](uint32_t value) { hash = (hash ^ value) * 16777619u; };
+        for(const TextureBinding &binding : bindings)
+        {
+            mix(binding.unit);
+            mix(binding.target);
+            mix(binding.texture);
+        }
+        for(const UniformValue &uniform : uniforms)
+        {
+            mix(uint32_t(uniform.name.hash));
+            mix(uint32_t(uniform.integer));
+        }
+        key = hash;
+    }
+
+    void addInt(const std::string &name, int value)
+    {
+        UniformValue uniform(name);
+        uniform.integer = value;
+        uniforms.push_back(uniform);
+    }
+};
+#endif
@@ -6,35 +6,30 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include <material.h>
+#include <meshlet.h>
 #include <shader.h>
+#include <vertex_format.h>
 
+#include <cmath>
 #include <string>
+#include <utility>
 #include <vector>
 using namespace std;
 
-#define MAX_BONE_INFLUENCE 4
-
-struct Vertex {
-    // position
-    glm::vec3 Position;
-    // normal
-    glm::vec3 Normal;
-    // texCoords
-    glm::vec2 TexCoords;
-    // tangent
-    glm::vec3 Tangent;
-    // bitangent
-    glm::vec3 Bitangent;
-	//bone indexes which will influence this vertex
-	int m_BoneIDs[MAX_BONE_INFLUENCE];
-	//weights from each bone
-	float m_Weights[MAX_BONE_INFLUENCE];
+// a simplified index list over the mesh's own vertices, see mesh_simplifier.h
+struct MeshLod {
+    vector<unsigned int> indices;
+    float error = 0.0f;     // object space error of this level
+    size_t indexOffset = 0; // in bytes, inside the buffer the mesh lives in
+    GLsizei indexCount = 0;
 };
 
-struct Texture {
-    unsigned int id;
-    string type;
-    string path;
+// what a mesh keeps in system memory once its data is on the GPU
+enum class MeshResidency {
+    KeepAll,             // vertices, indices and lod indices stay around
+    PositionsAndIndices, // enough for picking and collision: positions + full detail indices
+    BoundsOnly           // nothing but the bounds (and meshlets, which are bounds as well)
 };
 
 class Mesh {
@@ -43,63 +38,126 @@ public:
     vector<Vertex>       vertices;
     vector<unsigned int> indices;
     vector<Texture>      textures;
-    unsigned int VAO;
-
-    // constructor
-    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
+    // the textures' bindings, rebuild with material.build(textures) whenever textures change
+    Material             material;
+    unsigned int VAO = 0;
+    // how the vertices are packed on the GPU, and the index type that was picked for them
+    VertexLayout layout;
+    GLenum indexType = GL_UNSIGNED_INT;
+    // where the mesh lives inside its buffers. a mesh that uploads itself starts at 0,
+    // one packed into a GeometryArena shares the VAO with the rest of its model.
+    GLint baseVertex = 0;
+    size_t indexOffset = 0; // in bytes
+    GLsizei indexCount = 0;
+    unsigned int materialIndex = 0;
+    // a translated copy of geometry that is on the GPU already, drawn through an InstanceGroup instead
+    bool sharesGeometry = false;
+    // culling clusters over the index buffer, see meshlet.h
+    vector<Meshlet> meshlets;
+    // coarser levels of detail, lods[0] is level 1. level 0 is the mesh itself.
+    vector<MeshLod> lods;
+    // object space bounds, valid whatever the residency
+    glm::vec3 boundsMin = glm::vec3(0.0f), boundsMax = glm::vec3(0.0f);
+    glm::vec3 boundsCenter = glm::vec3(0.0f);
+    float boundsRadius = 0.0f;
+    // texture coordinates the mesh spans, valid whatever the residency
+    glm::vec2 uvMin = glm::vec2(0.0f), uvMax = glm::vec2(0.0f);
+    size_t vertexCount = 0;
+    // only filled after releaseCpuData(MeshResidency::PositionsAndIndices), vertices is empty then
+    vector<glm::vec3> positions;
+    MeshResidency residency = MeshResidency::KeepAll;
+
+    // constructor. the data is moved in, so pass temporaries or std::move.
+    // pass upload = false when the mesh is going to be packed into a GeometryArena.
+    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures, VertexLayout layout = VertexLayout::Full(), bool upload = true)
     {
-        this->vertices = vertices;
-        this->indices = indices;
-        this->textures = textures;
+        this->vertices = std::move(vertices);
+        this->indices = std::move(indices);
+        this->textures = std::move(textures);
+        this->layout = layout;
+        material.build(this->textures);
+        this->indexCount = static_cast<GLsizei>(this->indices.size());
+        this->vertexCount = this->vertices.size();
+        computeBounds();
 
         // now that we have all the required data, set the vertex buffers and its attribute pointers.
-        setupMesh();
+        if(upload)
+            setupMesh();
     }
 
     // render the mesh
     void Draw(Shader &shader) 
     {
-        // bind appropriate textures
-        unsigned int diffuseNr  = 1;
-        unsigned int specularNr = 1;
-        unsigned int normalNr   = 1;
-        unsigned int heightNr   = 1;
-        for(unsigned int i = 0; i < textures.size(); i++)
+        material.bind(shader);
+
+        // tell the vertex shader how the normals are encoded
+        shader.setBool("octNormals", layout.normals == NormalEncoding::Octahedral);
+
+        // draw mesh
+        GLState::current().bindVertexArray(VAO);
+        glDrawElementsBaseVertex(GL_TRIANGLES, indexCount, indexType, reinterpret_cast<void*>(indexOffset), baseVertex);
+    }
+
+    // drops the system memory copies the residency policy doesn't ask for. only call this once the data
+    // is uploaded (by setupMesh or a GeometryArena). returns the number of bytes released.
+    size_t releaseCpuData(MeshResidency policy)
+    {
+        size_t before = cpuBytes();
+        if(policy == MeshResidency::KeepAll)
+            return 0;
+        if(policy == MeshResidency::PositionsAndIndices && positions.empty() && !vertices.empty())
         {
-            glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
-            // retrieve texture number (the N in diffuse_textureN)
-            string number;
-            string name = textures[i].type;
-            if(name == "texture_diffuse")
-                number = std::to_string(diffuseNr++);
-            else if(name == "texture_specular")
-                number = std::to_string(specularNr++); // transfer unsigned int to string
-            else if(name == "texture_normal")
-                number = std::to_string(normalNr++); // transfer unsigned int to string
-            else if(name == "texture_height")
-                number = std::to_string(heightNr++); // transfer unsigned int to string
-
-            // now set the sampler to the correct texture unit
-            GLint uniformLocation = glGetUniformLocation(shader.ID, (name + number).c_str());
-            if(uniformLocation != -1) {
-                glUniform1i(uniformLocation, i);
-            }
-            // and finally bind the texture
-            glBindTexture(GL_TEXTURE_2D, textures[i].id);
+            positions.reserve(vertices.size());
+            for(const Vertex &v : vertices)
+                positions.push_back(v.Position);
         }
-        
-        // draw mesh
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, static_cast<unsigned int>(indices.size()), GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
+        if(policy == MeshResidency::BoundsOnly)
+        {
+            vector<glm::vec3>().swap(positions);
+            vector<unsigned int>().swap(indices);
+        }
+        vector<Vertex>().swap(vertices);
+        for(MeshLod &lod : lods)
+            vector<unsigned int>().swap(lod.indices);
+        residency = policy;
+        size_t after = cpuBytes();
+        return before > after ? before - after : 0;
+    }
 
-        // always good practice to set everything back to defaults once configured.
-        glActiveTexture(GL_TEXTURE0);
+    // system memory held by the geometry of this mesh
+    size_t cpuBytes() const
+    {
+        size_t bytes = vertices.capacity() * sizeof(Vertex) + indices.capacity() * sizeof(unsigned int) +
+                       positions.capacity() * sizeof(glm::vec3) + meshlets.capacity() * sizeof(Meshlet);
+        for(const MeshLod &lod : lods)
+            bytes += lod.indices.capacity() * sizeof(unsigned int);
+        return bytes;
     }
 
 private:
     // render data 
-    unsigned int VBO, EBO;
+    unsigned int VBO = 0, EBO = 0;
+
+    void computeBounds()
+    {
+        if(vertices.empty())
+            return;
+        boundsMin = glm::vec3(INFINITY);
+        boundsMax = glm::vec3(-INFINITY);
+        uvMin = glm::vec2(INFINITY);
+        uvMax = glm::vec2(-INFINITY);
+        for(const Vertex &v : vertices)
+        {
+            boundsMin = glm::min(boundsMin, v.Position);
+            boundsMax = glm::max(boundsMax, v.Position);
+            uvMin = glm::min(uvMin, v.TexCoords);
+            uvMax = glm::max(uvMax, v.TexCoords);
+        }
+        boundsCenter = (boundsMin + boundsMax) * 0.5f;
+        boundsRadius = 0.0f;
+        for(const Vertex &v : vertices)
+            boundsRadius = glm::max(boundsRadius, glm::length(v.Position - boundsCenter));
+    }
 
     // initializes all the buffer objects/arrays
     void setupMesh()
@@ -109,41 +167,21 @@ private:
         glGenBuffers(1, &VBO);
         glGenBuffers(1, &EBO);
 
-        glBindVertexArray(VAO);
-        // load data into vertex buffers
+        GLState::current().bindVertexArray(VAO);
+        // load data into vertex buffers, packed to whatever the layout asks for. the compact layouts
+        // quantize normals, uvs and bone data so the buffer is a fraction of sizeof(Vertex) per vertex.
+        vector<unsigned char> vertexData = packVertices(vertices, layout);
         glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        // A great thing about structs is that their memory layout is sequential for all its items.
-        // The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
-        // again translates to 3/2 floats which translates to a byte array.
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);  
+        glBufferData(GL_ARRAY_BUFFER, vertexData.size(), vertexData.data(), GL_STATIC_DRAW);
 
+        // meshes that fit into 16 bit indices get a half size index buffer
+        indexType = chooseIndexType(layout, vertices.size());
+        vector<unsigned char> indexData = packIndices(indices, indexType);
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
-
-        // set the vertex attribute pointers
-        // vertex Positions
-        glEnableVertexAttribArray(0);	
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-        // vertex normals
-        glEnableVertexAttribArray(1);	
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
-        // vertex texture coords
-        glEnableVertexAttribArray(2);	
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
-        // vertex tangent
-        glEnableVertexAttribArray(3);
-        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
-        // vertex bitangent
-        glEnableVertexAttribArray(4);
-        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
-		// ids
-		glEnableVertexAttribArray(5);
-		glVertexAttribIPointer(5, 4, GL_INT, sizeof(Vertex), (void*)offsetof(Vertex, m_BoneIDs));
-
-		// weights
-		glEnableVertexAttribArray(6);
-		glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, m_Weights));
-        glBindVertexArray(0);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexData.size(), indexData.data(), GL_STATIC_DRAW);
+
+        // set the vertex attribute pointers to match the layout
+        setupVertexAttributes(layout);
     }
 };
 #endif
\ No newline at end of file
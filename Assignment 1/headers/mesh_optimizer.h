@@ -0,0 +1,374 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <glm/glm.hpp>
+
+#include <meshlet.h>
+#include <vertex_format.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+// import time mesh optimization, run between the importer and Mesh construction:
+//   1. weld vertices that are bitwise identical in every attribute the renderer uses
+//   2. reorder triangles for the post transform vertex cache (Tipsify, Sander et al. 2007)
+//   3. reorder the resulting clusters so the ones likely to occlude are drawn first
+//   4. optionally regroup the triangles into meshlets for cluster culling (see meshlet.h)
+//   5. reorder vertices in first use order so vertex fetch walks memory linearly
+
+struct MeshOptimizeSettings {
+    bool weld     = true;
+    bool cache    = true;
+    bool overdraw = true;
+    bool fetch    = true;
+    unsigned int cacheSize  = 16;    // post transform cache size tipsify optimizes for
+    float overdrawThreshold = 1.05f; // how much ACMR the overdraw pass may give back
+};
+
+struct MeshOptimizeStats {
+    size_t verticesBefore = 0, verticesAfter = 0;
+    float acmrBefore = 0.0f, acmrAfter = 0.0f;
+};
+
+// average cache miss ratio: transformed vertices per triangle for a FIFO cache of cacheSize entries.
+// 0.5 is the ideal for large regular meshes, 3.0 is the worst case. measured over the indices in
+// [first, last) with the caller's per vertex timestamps, so a mesh's clusters can be measured one after
+// the other without a buffer each. the timestamps are never cleared: time only grows, and moving it on
+// by more than cacheSize empties the cache.
+inline float computeACMR(const unsigned int *first, const unsigned int *last, std::vector<unsigned int> &timestamps, unsigned int &time,
+                         unsigned int cacheSize)
+{
+    const size_t count = size_t(last - first);
+    if(count < 3)
+        return 0.0f;
+    time += cacheSize + 1;
+    size_t misses = 0;
+    for(const unsigned int *index = first; index != last; index++)
+    {
+        unsigned int v = *index;
+        if(time - timestamps[v] > cacheSize)
+        {
+            timestamps[v] = time++;
+            misses++;
+        }
+    }
+    return float(misses) / float(count / 3);
+}
+
+// the same over a whole index buffer
+inline float computeACMR(const std::vector<unsigned int> &indices, size_t vertexCount, unsigned int cacheSize = 16)
+{
+    std::vector<unsigned int> timestamps(vertexCount, 0);
+    unsigned int time = 0;
+    return computeACMR(indices.data(), indices.data() + indices.size(), timestamps, time, cacheSize);
+}
+
+// merges identical vertices and rewrites the index buffer. only the attributes that end up in a vertex
+// buffer are compared, bone data only with compareBones since static meshes don't upload it.
+inline void weldVertices(std::vector<Vertex> &vertices, std::vector<unsigned int> &indices, bool compareBones = false)
+{
+    struct Key {
+        float data[14];
+        int bones[MAX_BONE_INFLUENCE];
+        float weights[MAX_BONE_INFLUENCE];
+        bool operator==(const Key &o) const { return std::memcmp(this, &o, sizeof(Key)) == 0; }
+    };
+    struct KeyHash {
+        size_t operator()(const Key &k) const
+        {
+            // FNV-1a over the raw bytes
+            const unsigned char *p = reinterpret_cast<const unsigned char*>(&k);
+            uint64_t h = 14695981039346656037ull;
+            for(size_t i = 0; i < sizeof(Key); i++)
+                h = (h ^ p[i]) * 1099511628211ull;
+            return size_t(h);
+        }
+    };
+
+    std::unordered_map<Key, unsigned int, KeyHash> unique;
+    unique.reserve(vertices.size());
+    std::vector<unsigned int> remap(vertices.size());
+    std::vector<Vertex> welded;
+    welded.reserve(vertices.size());
+    for(size_t i = 0; i < vertices.size(); i++)
+    {
+        const Vertex &v = vertices[i];
+        Key key;
+        std::memset(&key, 0, sizeof(key));
+        std::memcpy(key.data + 0, &v.Position, 12);
+        std::memcpy(key.data + 3, &v.Normal, 12);
+        std::memcpy(key.data + 6, &v.TexCoords, 8);
+        std::memcpy(key.data + 8, &v.Tangent, 12);
+        std::memcpy(key.data + 11, &v.Bitangent, 12);
+        if(compareBones)
+        {
+            std::memcpy(key.bones, v.m_BoneIDs, sizeof(key.bones));
+            std::memcpy(key.weights, v.m_Weights, sizeof(key.weights));
+        }
+        // -0.0f and 0.0f should weld
+        for(int j = 0; j < 14; j++)
+            if(key.data[j] == 0.0f)
+                key.data[j] = 0.0f;
+
+        auto it = unique.find(key);
+        if(it == unique.end())
+        {
+            unsigned int index = static_cast<unsigned int>(welded.size());
+            unique.emplace(key, index);
+            welded.push_back(v);
+            remap[i] = index;
+        }
+        else
+            remap[i] = it->second;
+    }
+    for(size_t i = 0; i < indices.size(); i++)
+        indices[i] = remap[indices[i]];
+    vertices.swap(welded);
+}
+
+// tipsify triangle reordering. returns the new index list, clusterStarts receives the triangle index of every
+// hard boundary (a point where the fanning vertex had to jump, i.e. the cache effectively starts cold).
+inline std::vector<unsigned int> optimizeVertexCache(const std::vector<unsigned int> &indices, size_t vertexCount,
+                                                     unsigned int cacheSize, std::vector<unsigned int> *clusterStarts = nullptr)
+{
+    const size_t triangleCount = indices.size() / 3;
+    std::vector<unsigned int> result;
+    result.reserve(indices.size());
+    if(clusterStarts)
+        clusterStarts->clear();
+    if(triangleCount == 0)
+        return result;
+
+    // vertex -> triangle adjacency in CSR form
+    std::vector<unsigned int> live(vertexCount, 0);
+    for(size_t i = 0; i < triangleCount * 3; i++)
+        live[indices[i]]++;
+    std::vector<unsigned int> offsets(vertexCount + 1, 0);
+    for(size_t v = 0; v < vertexCount; v++)
+        offsets[v + 1] = offsets[v] + live[v];
+    std::vector<unsigned int> adjacency(triangleCount * 3);
+    std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+    for(size_t t = 0; t < triangleCount; t++)
+        for(int k = 0; k < 3; k++)
+            adjacency[fill[indices[t * 3 + k]]++] = static_cast<unsigned int>(t);
+
+    std::vector<unsigned int> cacheTime(vertexCount, 0);
+    std::vector<char> emitted(triangleCount, 0);
+    std::vector<unsigned int> deadEnd;
+    std::vector<unsigned int> candidates;
+    unsigned int time = cacheSize + 1;
+    size_t cursor = 0;
+
+    // first fanning vertex is the first used vertex
+    int fanning = -1;
+    while(cursor < vertexCount && live[cursor] == 0)
+        cursor++;
+    if(cursor < vertexCount)
+        fanning = static_cast<int>(cursor);
+    if(clusterStarts)
+        clusterStarts->push_back(0);
+
+    while(fanning >= 0)
+    {
+        candidates.clear();
+        for(unsigned int a = offsets[fanning]; a < offsets[fanning + 1]; a++)
+        {
+            unsigned int t = adjacency[a];
+            if(emitted[t])
+                continue;
+            for(int k = 0; k < 3; k++)
+            {
+                unsigned int v = indices[t * 3 + k];
+                result.push_back(v);
+                deadEnd.push_back(v);
+                candidates.push_back(v);
+                live[v]--;
+                if(time - cacheTime[v] > cacheSize)
+                    cacheTime[v] = time++;
+            }
+            emitted[t] = 1;
+        }
+
+        // pick the candidate that is still in cache after its remaining triangles are emitted, oldest first
+        int best = -1;
+        int bestPriority = -1;
+        for(unsigned int v : candidates)
+        {
+            if(live[v] == 0)
+                continue;
+            int priority = 0;
+            if(time - cacheTime[v] + 2 * live[v] <= cacheSize)
+                priority = int(time - cacheTime[v]);
+            if(priority > bestPriority)
+            {
+                bestPriority = priority;
+                best = int(v);
+            }
+        }
+        if(best < 0)
+        {
+            // dead end: fall back to recently touched vertices, then to the input order
+            while(!deadEnd.empty())
+            {
+                unsigned int v = deadEnd.back();
+                deadEnd.pop_back();
+                if(live[v] > 0)
+                {
+                    best = int(v);
+                    break;
+                }
+            }
+            if(best < 0)
+            {
+                while(cursor < vertexCount && live[cursor] == 0)
+                    cursor++;
+                if(cursor < vertexCount)
+                {
+                    best = int(cursor);
+                    if(clusterStarts && result.size() < indices.size())
+                        clusterStarts->push_back(static_cast<unsigned int>(result.size() / 3));
+                }
+            }
+        }
+        fanning = best;
+    }
+    return result;
+}
+
+// splits the hard clusters from optimizeVertexCache further wherever the running ACMR of a cluster is good
+// enough, then sorts the clusters front to back as seen from outside the mesh (Sander et al. 2007).
+inline void optimizeOverdraw(std::vector<unsigned int> &indices, const std::vector<Vertex> &vertices,
+                             const std::vector<unsigned int> &hardClusters, unsigned int cacheSize, float threshold)
+{
+    const size_t triangleCount = indices.size() / 3;
+    if(triangleCount == 0 || hardClusters.empty())
+        return;
+
+    // soft boundaries
+    std::vector<unsigned int> clusters;
+    std::vector<unsigned int> timestamps(vertices.size(), 0);
+    unsigned int time = cacheSize + 1;
+    for(size_t c = 0; c < hardClusters.size(); c++)
+    {
+        size_t start = hardClusters[c];
+        size_t end = c + 1 < hardClusters.size() ? hardClusters[c + 1] : triangleCount;
+        float clusterACMR = computeACMR(indices.data() + start * 3, indices.data() + end * 3, timestamps, time, cacheSize);
+
+        clusters.push_back(static_cast<unsigned int>(start));
+        time += cacheSize + 1; // flush
+        size_t misses = 0, triangles = 0;
+        for(size_t t = start; t < end; t++)
+        {
+            for(int k = 0; k < 3; k++)
+            {
+                unsigned int v = indices[t * 3 + k];
+                if(time - timestamps[v] > cacheSize)
+                {
+                    timestamps[v] = time++;
+                    misses++;
+                }
+            }
+            triangles++;
+            if(t + 1 < end && float(misses) / float(triangles) <= clusterACMR * threshold && triangles >= 8)
+            {
+                clusters.push_back(static_cast<unsigned int>(t + 1));
+                time += cacheSize + 1;
+                misses = 0;
+                triangles = 0;
+            }
+        }
+    }
+
+    // mesh centroid
+    glm::vec3 meshCentroid(0.0f);
+    for(size_t i = 0; i < vertices.size(); i++)
+        meshCentroid += vertices[i].Position;
+    meshCentroid /= float(glm::max<size_t>(vertices.size(), 1));
+
+    struct ClusterSort { float key; unsigned int start, end; };
+    std::vector<ClusterSort> sorted;
+    sorted.reserve(clusters.size());
+    for(size_t c = 0; c < clusters.size(); c++)
+    {
+        unsigned int start = clusters[c];
+        unsigned int end = c + 1 < clusters.size() ? clusters[c + 1] : static_cast<unsigned int>(triangleCount);
+        glm::vec3 centroid(0.0f), normal(0.0f);
+        float area = 0.0f;
+        for(unsigned int t = start; t < end; t++)
+        {
+            const glm::vec3 &p0 = vertices[indices[t * 3 + 0]].Position;
+            const glm::vec3 &p1 = vertices[indices[t * 3 + 1]].Position;
+            const glm::vec3 &p2 = vertices[indices[t * 3 + 2]].Position;
+            glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+            float a = glm::length(n);
+            centroid += (p0 + p1 + p2) * (a / 3.0f);
+            normal += n;
+            area += a;
+        }
+        if(area > 0.0f)
+            centroid /= area;
+        float len = glm::length(normal);
+        if(len > 0.0f)
+            normal /= len;
+        sorted.push_back({ glm::dot(centroid - meshCentroid, normal), start, end });
+    }
+    std::stable_sort(sorted.begin(), sorted.end(), [](const ClusterSort &a, const ClusterSort &b) { return a.key > b.key; });
+
+    std::vector<unsigned int> result;
+    result.reserve(indices.size());
+    for(const ClusterSort &c : sorted)
+        result.insert(result.end(), indices.begin() + c.start * 3, indices.begin() + c.end * 3);
+    indices.swap(result);
+}
+
+// reorders vertices in the order the index buffer first references them and drops unreferenced ones
+inline void optimizeVertexFetch(std::vector<Vertex> &vertices, std::vector<unsigned int> &indices)
+{
+    const unsigned int unused = ~0u;
+    std::vector<unsigned int> remap(vertices.size(), unused);
+    std::vector<Vertex> reordered;
+    reordered.reserve(vertices.size());
+    for(size_t i = 0; i < indices.size(); i++)
+    {
+        unsigned int &r = remap[indices[i]];
+        if(r == unused)
+        {
+            r = static_cast<unsigned int>(reordered.size());
+            reordered.push_back(vertices[indices[i]]);
+        }
+        indices[i] = r;
+    }
+    vertices.swap(reordered);
+}
+
+// runs the whole pipeline in place. pass meshlets to also split the mesh into culling clusters.
+inline MeshOptimizeStats optimizeMesh(std::vector<Vertex> &vertices, std::vector<unsigned int> &indices,
+                                      const MeshOptimizeSettings &settings = MeshOptimizeSettings(),
+                                      std::vector<Meshlet> *meshlets = nullptr)
+{
+    MeshOptimizeStats stats;
+    stats.verticesBefore = vertices.size();
+    stats.acmrBefore = computeACMR(indices, vertices.size(), settings.cacheSize);
+
+    if(settings.weld)
+        weldVertices(vertices, indices);
+    if(settings.cache)
+    {
+        std::vector<unsigned int> clusters;
+        indices = optimizeVertexCache(indices, vertices.size(), settings.cacheSize, &clusters);
+        if(settings.overdraw)
+            optimizeOverdraw(indices, vertices, clusters, settings.cacheSize, settings.overdrawThreshold);
+    }
+    if(meshlets)
+        *meshlets = buildMeshlets(vertices, indices);
+    if(settings.fetch)
+        optimizeVertexFetch(vertices, indices); // only renumbers vertices, meshlet ranges and bounds stay valid
+
+    stats.verticesAfter = vertices.size();
+    stats.acmrAfter = computeACMR(indices, vertices.size(), settings.cacheSize);
+    return stats;
+}
+#endif
@@ -0,0 +1,390 @@
+#ifndef MESH_SIMPLIFIER_H
+#define MESH_SIMPLIFIER_H
+
+#include <glm/glm.hpp>
+
+#include <mesh_optimizer.h>
+#include <vertex_format.h>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// quadric error metric simplification by half edge collapse (Garland & Heckbert 97). a vertex is always
+// collapsed onto one of its neighbours, so every level of detail indexes into the original vertex buffer
+// and can live next to the full detail indices in the same index buffer.
+//
+// vertices that share a position but differ in uv or normal are seams. those, and open borders, are only
+// ever collapsed along the seam/border itself (both sides of a seam together), so uv islands and hard
+// normal edges keep their outline while the interior is simplified.
+
+struct Quadric {
+    // symmetric 4x4 matrix, upper triangle, plus the accumulated weight
+    double a00 = 0, a01 = 0, a02 = 0, a03 = 0;
+    double a11 = 0, a12 = 0, a13 = 0;
+    double a22 = 0, a23 = 0;
+    double a33 = 0;
+    double weight = 0;
+
+    // plane n.p + d = 0 with |n| = 1
+    void addPlane(const glm::dvec3 &n, double d, double w)
+    {
+        a00 += w * n.x * n.x; a01 += w * n.x * n.y; a02 += w * n.x * n.z; a03 += w * n.x * d;
+        a11 += w * n.y * n.y; a12 += w * n.y * n.z; a13 += w * n.y * d;
+        a22 += w * n.z * n.z; a23 += w * n.z * d;
+        a33 += w * d * d;
+        weight += w;
+    }
+    void add(const Quadric &q)
+    {
+        a00 += q.a00; a01 += q.a01; a02 += q.a02; a03 += q.a03;
+        a11 += q.a11; a12 += q.a12; a13 += q.a13;
+        a22 += q.a22; a23 += q.a23;
+        a33 += q.a33;
+        weight += q.weight;
+    }
+    // weighted sum of squared distances of p to all planes
+    double evaluate(const glm::vec3 &p) const
+    {
+        double x = p.x, y = p.y, z = p.z;
+        double r = a00 * x * x + 2 * a01 * x * y + 2 * a02 * x * z + 2 * a03 * x
+                 + a11 * y * y + 2 * a12 * y * z + 2 * a13 * y
+                 + a22 * z * z + 2 * a23 * z
+                 + a33;
+        return r > 0.0 ? r : 0.0;
+    }
+};
+
+enum class SimplifyVertexKind : unsigned char { Manifold, Border, Seam, Locked };
+
+struct SimplifyResult {
+    std::vector<unsigned int> indices;
+    float error = 0.0f; // object space distance, roughly the largest deviation from the input surface
+};
+
+// simplifies indices (a triangle list into vertices) down to about targetIndexCount indices or until
+// collapsing would move the surface by more than maxError
+inline SimplifyResult simplifyMesh(const std::vector<Vertex> &vertices, const std::vector<unsigned int> &indices,
+                                   size_t targetIndexCount, float maxError = FLT_MAX)
+{
+    SimplifyResult result;
+    result.indices = indices;
+    const size_t vertexCount = vertices.size();
+    if(indices.size() <= targetIndexCount || vertexCount == 0)
+        return result;
+
+    // 1. positions: canonical vertex per position and a cyclic list of the wedges sharing it
+    std::vector<unsigned int> position(vertexCount);
+    std::vector<unsigned int> wedge(vertexCount);
+    {
+        struct PosHash {
+            size_t operator()(const glm::vec3 &p) const
+            {
+                glm::vec3 q = p + glm::vec3(0.0f); // -0 and 0 compare equal, so they have to hash equal too
+                uint32_t h[3];
+                std::memcpy(h, &q, sizeof(h));
+                return size_t(h[0] * 73856093u ^ h[1] * 19349663u ^ h[2] * 83492791u);
+            }
+        };
+        std::unordered_map<glm::vec3, unsigned int, PosHash> canonical;
+        canonical.reserve(vertexCount);
+        for(unsigned int v = 0; v < vertexCount; v++)
+        {
+            auto it = canonical.emplace(vertices[v].Position, v).first;
+            position[v] = it->second;
+            wedge[v] = v;
+        }
+        for(unsigned int v = 0; v < vertexCount; v++)
+            if(position[v] != v)
+            {
+                // insert v into the ring of its canonical vertex
+                unsigned int c = position[v];
+                wedge[v] = wedge[c];
+                wedge[c] = v;
+            }
+    }
+
+    // 2. classify vertices from the open (unpaired) edges of the input
+    auto edgeKey = [](unsigned int a, unsigned int b) { return (uint64_t(a) << 32) | b; };
+    std::unordered_set<uint64_t> edges;
+    edges.reserve(indices.size());
+    for(size_t i = 0; i < indices.size(); i += 3)
+        for(int k = 0; k < 3; k++)
+            edges.insert(edgeKey(indices[i + k], indices[i + (k + 1) % 3]));
+
+    std::vector<unsigned int> openOut(vertexCount, ~0u), openIn(vertexCount, ~0u);
+    std::vector<unsigned char> openCount(vertexCount, 0);
+    for(size_t i = 0; i < indices.size(); i += 3)
+        for(int k = 0; k < 3; k++)
+        {
+            unsigned int a = indices[i + k], b = indices[i + (k + 1) % 3];
+            if(edges.count(edgeKey(b, a)) == 0)
+            {
+                openOut[a] = b;
+                openIn[b] = a;
+                openCount[a] = (unsigned char)std::min(openCount[a] + 1, 255);
+                openCount[b] = (unsigned char)std::min(openCount[b] + 1, 255);
+            }
+        }
+
+    std::vector<SimplifyVertexKind> kind(vertexCount, SimplifyVertexKind::Locked);
+    for(unsigned int v = 0; v < vertexCount; v++)
+    {
+        unsigned int wedges = 1;
+        for(unsigned int w = wedge[v]; w != v; w = wedge[w])
+            wedges++;
+        if(wedges == 1)
+        {
+            if(openCount[v] == 0)
+                kind[v] = SimplifyVertexKind::Manifold;
+            else if(openCount[v] == 2 && openOut[v] != ~0u && openIn[v] != ~0u)
+                kind[v] = SimplifyVertexKind::Border;
+        }
+        else if(wedges == 2)
+        {
+            // a seam: both wedges have exactly one open edge in each direction, and the open edges of
+            // one wedge are the reversed open edges of the other in position space
+            unsigned int w = wedge[v];
+            if(openCount[v] == 2 && openCount[w] == 2 && openOut[v] != ~0u && openIn[v] != ~0u &&
+               openOut[w] != ~0u && openIn[w] != ~0u &&
+               position[openOut[v]] == position[openIn[w]] && position[openIn[v]] == position[openOut[w]])
+                kind[v] = SimplifyVertexKind::Seam;
+        }
+    }
+
+    // 3. quadrics per position: triangle planes, plus perpendicular planes along borders and seams so they stay put
+    std::vector<Quadric> quadrics(vertexCount);
+    for(size_t i = 0; i < indices.size(); i += 3)
+    {
+        glm::dvec3 p0 = vertices[indices[i + 0]].Position;
+        glm::dvec3 p1 = vertices[indices[i + 1]].Position;
+        glm::dvec3 p2 = vertices[indices[i + 2]].Position;
+        glm::dvec3 n = glm::cross(p1 - p0, p2 - p0);
+        double area = glm::length(n);
+        if(area <= 0.0)
+            continue;
+        n /= area;
+        Quadric q;
+        q.addPlane(n, -glm::dot(n, p0), area);
+        for(int k = 0; k < 3; k++)
+            quadrics[position[indices[i + k]]].add(q);
+
+        for(int k = 0; k < 3; k++)
+        {
+            unsigned int a = indices[i + k], b = indices[i + (k + 1) % 3];
+            if(openOut[a] != b)
+                continue;
+            glm::dvec3 pa = vertices[a].Position, pb = vertices[b].Position;
+            glm::dvec3 edge = pb - pa;
+            double length = glm::length(edge);
+            if(length <= 0.0)
+                continue;
+            glm::dvec3 perpendicular = glm::normalize(glm::cross(edge, n));
+            Quadric e;
+            e.addPlane(perpendicular, -glm::dot(perpendicular, pa), length * length * 10.0);
+            quadrics[position[a]].add(e);
+            quadrics[position[b]].add(e);
+        }
+    }
+
+    // 4. collapse passes
+    std::vector<unsigned int> &current = result.indices;
+    std::vector<unsigned int> collapse(vertexCount);
+    std::vector<unsigned char> touched(vertexCount);
+    std::vector<unsigned int> offsets, adjacency;
+    struct Collapse { unsigned int v0, v1; float cost; };
+    std::vector<Collapse> candidates;
+    float maxCost = 0.0f;
+    const double maxErrorSquared = maxError >= FLT_MAX ? DBL_MAX : double(maxError) * double(maxError);
+
+    while(current.size() > targetIndexCount)
+    {
+        const size_t triangleCount = current.size() / 3;
+
+        // position -> triangle adjacency for the flip test
+        offsets.assign(vertexCount + 1, 0);
+        for(size_t i = 0; i < current.size(); i++)
+            offsets[position[current[i]] + 1]++;
+        for(size_t v = 0; v < vertexCount; v++)
+            offsets[v + 1] += offsets[v];
+        adjacency.resize(current.size());
+        {
+            std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+            for(size_t i = 0; i < current.size(); i++)
+                adjacency[fill[position[current[i]]]++] = static_cast<unsigned int>(i / 3);
+        }
+        edges.clear();
+        for(size_t i = 0; i < current.size(); i += 3)
+            for(int k = 0; k < 3; k++)
+                edges.insert(edgeKey(current[i + k], current[i + (k + 1) % 3]));
+        auto isOpen = [&](unsigned int a, unsigned int b) {
+            return edges.count(edgeKey(a, b)) != 0 && edges.count(edgeKey(b, a)) == 0;
+        };
+
+        // candidate collapses, one per edge direction that the vertex kinds allow
+        candidates.clear();
+        for(size_t i = 0; i < current.size(); i += 3)
+            for(int k = 0; k < 3; k++)
+            {
+                unsigned int a = current[i + k], b = current[i + (k + 1) % 3];
+                for(int dir = 0; dir < 2; dir++)
+                {
+                    unsigned int v0 = dir ? b : a, v1 = dir ? a : b;
+                    SimplifyVertexKind k0 = kind[v0];
+                    if(k0 == SimplifyVertexKind::Locked || position[v0] == position[v1])
+                        continue;
+                    if(k0 != SimplifyVertexKind::Manifold && !(isOpen(v0, v1) || isOpen(v1, v0)))
+                        continue; // borders and seams only slide along themselves
+                    if(k0 != SimplifyVertexKind::Manifold && kind[v1] == SimplifyVertexKind::Manifold)
+                        continue;
+                    // manifold edges show up twice, once from each triangle; keep the direction from the lower index
+                    if(k0 == SimplifyVertexKind::Manifold && kind[v1] == SimplifyVertexKind::Manifold && !isOpen(a, b) && a > b)
+                        continue;
+                    Quadric q = quadrics[position[v0]];
+                    q.add(quadrics[position[v1]]);
+                    double cost = q.weight > 0.0 ? q.evaluate(vertices[v1].Position) / q.weight : 0.0;
+                    candidates.push_back({ v0, v1, float(cost) });
+                }
+            }
+        if(candidates.empty())
+            break;
+        std::sort(candidates.begin(), candidates.end(), [](const Collapse &x, const Collapse &y) { return x.cost < y.cost; });
+
+        for(unsigned int v = 0; v < vertexCount; v++)
+            collapse[v] = v;
+        std::fill(touched.begin(), touched.end(), 0);
+        size_t removed = 0;
+        const size_t triangleTarget = targetIndexCount / 3;
+        size_t applied = 0;
+
+        for(const Collapse &c : candidates)
+        {
+            if(triangleCount - removed <= triangleTarget)
+                break;
+            if(double(c.cost) > maxErrorSquared)
+                break;
+            unsigned int p0 = position[c.v0], p1 = position[c.v1];
+            if(touched[p0] || touched[p1])
+                continue;
+
+            // for seams the other wedge has to collapse along its own open edge to a vertex at p1
+            unsigned int sibling0 = ~0u, sibling1 = ~0u;
+            if(kind[c.v0] == SimplifyVertexKind::Seam)
+            {
+                sibling0 = wedge[c.v0];
+                unsigned int w = c.v1;
+                do
+                {
+                    if(isOpen(sibling0, w) || isOpen(w, sibling0))
+                        sibling1 = w;
+                    w = wedge[w];
+                } while(w != c.v1);
+                if(sibling1 == ~0u)
+                    continue;
+            }
+
+            // reject collapses that flip a triangle around p0
+            bool flips = false;
+            glm::vec3 target = vertices[c.v1].Position;
+            size_t collapsing = 0;
+            for(unsigned int a = offsets[p0]; a < offsets[p0 + 1] && !flips; a++)
+            {
+                unsigned int t = adjacency[a];
+                unsigned int tri[3] = { current[t * 3], current[t * 3 + 1], current[t * 3 + 2] };
+                bool hasP1 = position[tri[0]] == p1 || position[tri[1]] == p1 || position[tri[2]] == p1;
+                if(hasP1)
+                {
+                    collapsing++;
+                    continue; // this triangle disappears
+                }
+                glm::vec3 q[3], r[3];
+                for(int k = 0; k < 3; k++)
+                {
+                    q[k] = vertices[tri[k]].Position;
+                    r[k] = position[tri[k]] == p0 ? target : q[k];
+                }
+                glm::vec3 before = glm::cross(q[1] - q[0], q[2] - q[0]);
+                glm::vec3 after = glm::cross(r[1] - r[0], r[2] - r[0]);
+                if(glm::dot(before, after) <= 0.25f * glm::length(before) * glm::length(after))
+                    flips = true;
+            }
+            if(flips)
+                continue;
+
+            collapse[c.v0] = c.v1;
+            if(sibling0 != ~0u)
+                collapse[sibling0] = sibling1;
+            quadrics[p1].add(quadrics[p0]);
+            maxCost = std::max(maxCost, c.cost);
+            removed += collapsing;
+            applied++;
+
+            // lock the one ring of p0 for the rest of the pass, the flip test above assumed it doesn't move
+            for(unsigned int a = offsets[p0]; a < offsets[p0 + 1]; a++)
+            {
+                unsigned int t = adjacency[a];
+                for(int k = 0; k < 3; k++)
+                    touched[position[current[t * 3 + k]]] = 1;
+            }
+            touched[p0] = touched[p1] = 1;
+        }
+        if(applied == 0)
+            break;
+
+        // rewrite the index buffer and drop triangles that became degenerate
+        size_t write = 0;
+        for(size_t i = 0; i < current.size(); i += 3)
+        {
+            unsigned int a = collapse[current[i]], b = collapse[current[i + 1]], c = collapse[current[i + 2]];
+            if(position[a] == position[b] || position[b] == position[c] || position[a] == position[c])
+                continue;
+            current[write++] = a;
+            current[write++] = b;
+            current[write++] = c;
+        }
+        current.resize(write);
+    }
+
+    result.error = std::sqrt(maxCost);
+    return result;
+}
+
+struct LodSettings {
+    unsigned int maxLevels = 4;  // levels generated on top of the full detail mesh
+    float reduction = 0.5f;      // triangle ratio between consecutive levels
+    float minReduction = 0.85f;  // stop once a level keeps more than this fraction of the previous one
+    unsigned int minTriangles = 64;
+};
+
+// builds a chain of progressively simplified index lists over the same vertices. each level is simplified
+// from the previous one and cache optimized; the error of a level includes the error of the levels before it.
+inline std::vector<SimplifyResult> generateLodChain(const std::vector<Vertex> &vertices, const std::vector<unsigned int> &indices,
+                                                    const LodSettings &settings = LodSettings(), unsigned int cacheSize = 16)
+{
+    std::vector<SimplifyResult> lods;
+    lods.reserve(settings.maxLevels); // previous points into lods, it must not reallocate
+    const std::vector<unsigned int> *previous = &indices;
+    float error = 0.0f;
+    for(unsigned int level = 0; level < settings.maxLevels; level++)
+    {
+        size_t triangles = previous->size() / 3;
+        if(triangles <= settings.minTriangles)
+            break;
+        size_t target = std::max<size_t>(size_t(triangles * settings.reduction), settings.minTriangles) * 3;
+        SimplifyResult lod = simplifyMesh(vertices, *previous, target);
+        if(lod.indices.empty() || lod.indices.size() > previous->size() * settings.minReduction)
+            break;
+        error += lod.error;
+        lod.error = error;
+        lod.indices = optimizeVertexCache(lod.indices, vertices.size(), cacheSize);
+        lods.push_back(std::move(lod));
+        previous = &lods.back().indices;
+    }
+    return lods;
+}
+#endif
@@ -0,0 +1,222 @@
+#ifndef MESHLET_H
+#define MESHLET_H
+
+#include <glm/glm.hpp>
+
+#include <frustum.h>
+#include <vertex_format.h>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#define MESHLET_MAX_VERTICES  64
+#define MESHLET_MAX_TRIANGLES 124
+
+// a small contiguous run of a mesh's index buffer with bounds for culling. buildMeshlets reorders the
+// index buffer so each meshlet is a plain index range that can be submitted on its own.
+struct Meshlet {
+    unsigned int firstIndex;    // relative to the owning mesh's indices
+    unsigned int triangleCount;
+    // bounding sphere
+    glm::vec3 center;
+    float radius;
+    // normal cone: every triangle normal is within acos(sqrt(1 - coneCutoff^2)) of coneAxis.
+    // a zero axis means the triangles face too many ways for the cone to ever cull.
+    glm::vec3 coneAxis;
+    float coneCutoff;
+    // texture coordinates the triangles span, for streaming just the virtual texture tiles they sample
+    glm::vec2 uvMin, uvMax;
+};
+
+// bounds of one meshlet from the triangles in indices[first, first + count * 3)
+inline Meshlet computeMeshletBounds(const std::vector<Vertex> &vertices, const std::vector<unsigned int> &indices,
+                                    unsigned int first, unsigned int triangleCount)
+{
+    Meshlet meshlet;
+    meshlet.firstIndex = first;
+    meshlet.triangleCount = triangleCount;
+
+    glm::vec3 min(INFINITY), max(-INFINITY);
+    meshlet.uvMin = glm::vec2(INFINITY);
+    meshlet.uvMax = glm::vec2(-INFINITY);
+    for(unsigned int i = first; i < first + triangleCount * 3; i++)
+    {
+        min = glm::min(min, vertices[indices[i]].Position);
+        max = glm::max(max, vertices[indices[i]].Position);
+        meshlet.uvMin = glm::min(meshlet.uvMin, vertices[indices[i]].TexCoords);
+        meshlet.uvMax = glm::max(meshlet.uvMax, vertices[indices[i]].TexCoords);
+    }
+    meshlet.center = (min + max) * 0.5f;
+    float radius2 = 0.0f;
+    for(unsigned int i = first; i < first + triangleCount * 3; i++)
+    {
+        glm::vec3 d = vertices[indices[i]].Position - meshlet.center;
+        radius2 = std::max(radius2, glm::dot(d, d));
+    }
+    meshlet.radius = std::sqrt(radius2);
+
+    // normal cone from the face normals
+    std::vector<glm::vec3> normals;
+    normals.reserve(triangleCount);
+    glm::vec3 axis(0.0f);
+    for(unsigned int t = 0; t < triangleCount; t++)
+    {
+        const glm::vec3 &p0 = vertices[indices[first + t * 3 + 0]].Position;
+        const glm::vec3 &p1 = vertices[indices[first + t * 3 + 1]].Position;
+        const glm::vec3 &p2 = vertices[indices[first + t * 3 + 2]].Position;
+        glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+        float len = glm::length(n);
+        if(len <= 0.0f)
+            continue; // degenerate triangles never rasterize, they don't constrain the cone
+        n /= len;
+        normals.push_back(n);
+        axis += n;
+    }
+    float axisLength = glm::length(axis);
+    meshlet.coneAxis = glm::vec3(0.0f);
+    meshlet.coneCutoff = 1.0f;
+    if(axisLength > 0.0f && !normals.empty())
+    {
+        axis /= axisLength;
+        float minDot = 1.0f;
+        for(const glm::vec3 &n : normals)
+            minDot = std::min(minDot, glm::dot(axis, n));
+        if(minDot > 0.0f)
+        {
+            meshlet.coneAxis = axis;
+            meshlet.coneCutoff = std::sqrt(1.0f - minDot * minDot); // sin of the cone half angle
+        }
+    }
+    return meshlet;
+}
+
+// groups triangles into meshlets of at most maxVertices unique vertices and maxTriangles triangles and rewrites
+// the index buffer so every meshlet is a contiguous range. meshlets are seeded in the existing triangle order
+// and grown through shared vertices, preferring triangles that add few vertices and keep the normal cone tight.
+inline std::vector<Meshlet> buildMeshlets(const std::vector<Vertex> &vertices, std::vector<unsigned int> &indices,
+                                          unsigned int maxVertices = MESHLET_MAX_VERTICES, unsigned int maxTriangles = MESHLET_MAX_TRIANGLES)
+{
+    std::vector<Meshlet> meshlets;
+    const unsigned int triangleCount = static_cast<unsigned int>(indices.size() / 3);
+    if(triangleCount == 0)
+        return meshlets;
+
+    // vertex -> triangle adjacency in CSR form
+    std::vector<unsigned int> offsets(vertices.size() + 1, 0);
+    for(size_t i = 0; i < size_t(triangleCount) * 3; i++)
+        offsets[indices[i] + 1]++;
+    for(size_t v = 0; v < vertices.size(); v++)
+        offsets[v + 1] += offsets[v];
+    std::vector<unsigned int> adjacency(size_t(triangleCount) * 3);
+    std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+    for(unsigned int t = 0; t < triangleCount; t++)
+        for(int k = 0; k < 3; k++)
+            adjacency[fill[indices[t * 3 + k]]++] = t;
+
+    std::vector<glm::vec3> faceNormals(triangleCount);
+    for(unsigned int t = 0; t < triangleCount; t++)
+    {
+        const glm::vec3 &p0 = vertices[indices[t * 3 + 0]].Position;
+        const glm::vec3 &p1 = vertices[indices[t * 3 + 1]].Position;
+        const glm::vec3 &p2 = vertices[indices[t * 3 + 2]].Position;
+        glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+        float len = glm::length(n);
+        faceNormals[t] = len > 0.0f ? n / len : glm::vec3(0.0f);
+    }
+
+    std::vector<char> emitted(triangleCount, 0);
+    std::vector<unsigned int> inMeshlet(vertices.size(), ~0u); // meshlet that last referenced the vertex
+    std::vector<unsigned int> candidates;
+    std::vector<unsigned int> reordered;
+    reordered.reserve(indices.size());
+    unsigned int seed = 0;
+    unsigned int current = 0;
+
+    while(true)
+    {
+        while(seed < triangleCount && emitted[seed])
+            seed++;
+        if(seed == triangleCount)
+            break;
+
+        unsigned int first = static_cast<unsigned int>(reordered.size());
+        unsigned int vertexCount = 0, triangles = 0;
+        glm::vec3 normalSum(0.0f);
+        candidates.clear();
+        unsigned int next = seed;
+        while(true)
+        {
+            // emit the triangle and make its neighbours candidates
+            emitted[next] = 1;
+            triangles++;
+            normalSum += faceNormals[next];
+            for(int k = 0; k < 3; k++)
+            {
+                unsigned int v = indices[next * 3 + k];
+                reordered.push_back(v);
+                if(inMeshlet[v] != current)
+                {
+                    inMeshlet[v] = current;
+                    vertexCount++;
+                    for(unsigned int a = offsets[v]; a < offsets[v + 1]; a++)
+                        if(!emitted[adjacency[a]])
+                            candidates.push_back(adjacency[a]);
+                }
+            }
+            if(triangles >= maxTriangles)
+                break;
+
+            // best candidate: fewest new vertices, then closest to the current average normal
+            glm::vec3 axis = glm::length(normalSum) > 0.0f ? glm::normalize(normalSum) : glm::vec3(0.0f);
+            int best = -1;
+            float bestScore = INFINITY;
+            for(size_t c = 0; c < candidates.size(); c++)
+            {
+                unsigned int t = candidates[c];
+                if(emitted[t])
+                {
+                    candidates[c--] = candidates.back();
+                    candidates.pop_back();
+                    continue;
+                }
+                unsigned int added = 0;
+                for(int k = 0; k < 3; k++)
+                    if(inMeshlet[indices[t * 3 + k]] != current)
+                        added++;
+                if(vertexCount + added > maxVertices)
+                    continue;
+                float score = float(added) + (1.0f - glm::dot(axis, faceNormals[t]));
+                if(score < bestScore)
+                {
+                    bestScore = score;
+                    best = int(t);
+                }
+            }
+            if(best < 0)
+                break;
+            next = static_cast<unsigned int>(best);
+        }
+        meshlets.push_back(Meshlet{ first, triangles, glm::vec3(0.0f), 0.0f, glm::vec3(0.0f), 1.0f, glm::vec2(0.0f), glm::vec2(0.0f) });
+        current++;
+    }
+
+    indices.swap(reordered);
+    for(Meshlet &meshlet : meshlets)
+        meshlet = computeMeshletBounds(vertices, indices, meshlet.firstIndex, meshlet.triangleCount);
+    return meshlets;
+}
+
+// true if every triangle of the meshlet faces away from the camera. cameraPosition and the frustum
+// have to be in the same (object) space as the meshlet bounds.
+inline bool meshletBackfacing(const Meshlet &meshlet, const glm::vec3 &cameraPosition)
+{
+    glm::vec3 toCenter = meshlet.center - cameraPosition;
+    return glm::dot(toCenter, meshlet.coneAxis) >= meshlet.coneCutoff * glm::length(toCenter) + meshlet.radius;
+}
+
+inline bool meshletVisible(const Meshlet &meshlet, const Frustum &frustum, const glm::vec3 &cameraPosition)
+{
+    return !meshletBackfacing(meshlet, cameraPosition) && frustum.intersectsSphere(meshlet.center, meshlet.radius);
+}
+#endif
@@ -10,18 +10,497 @@
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 
+#include <asset_pack_io.h>
+#include <batch_reader.h>
+#include <bounds_culling.h>
+#include <cooked_asset.h>
+#include <geometry_arena.h>
+#include <geometry_registry.h>
+#include <gl_state.h>
+#include <image_resample.h>
+#include <lod.h>
 #include <mesh.h>
+#include <mesh_import.h>
+#include <mesh_optimizer.h>
+#include <mesh_simplifier.h>
+#include <occlusion_culler.h>
+#include <png_stream.h>
+#include <render_queue.h>
 #include <shader.h>
 
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 #include <map>
+#include <memory>
 #include <vector>
 using namespace std;
 
-unsigned int TextureFromFile(const char *path, const string &directory, bool gamma = false);
+// 0 if the image can't be loaded, a texture is only returned once it is complete
+unsigned int TextureFromFile(const char *path, const string &directory, int maxDimension = 0);
+GLenum TextureFormat(int channels);
+unsigned int BeginTextureUpload(uint32_t width, uint32_t height, int channels);
+void UploadTextureBand(unsigned int textureID, uint32_t y, uint32_t width, uint32_t rows, int channels, const unsigned char *pixels);
+void EndTextureUpload(unsigned int textureID);
+bool TextureFromCooked(const unsigned char *data, size_t size, const string &filename, unsigned int textureID);
+bool HasS3TC();
+
+// textures shared by several models (see SceneLoader), keyed by file path. owns the texture objects.
+struct TextureCache {
+    map<string, Texture> textures;
+
+    void release()
+    {
+        for(auto &entry : textures)
+            if(entry.second.id != 0)
+            {
+                GLState::current().forgetTexture(entry.second.id);
+                glDeleteTextures(1, &entry.second.id);
+            }
+        textures.clear();
+    }
+};
+
+// gathers the rows of an image, box filtered down by factor, into bands of about a megabyte and hands
+// every full band to sink: sink.begin(width, height, channels) once, then sink.band(y, rows, pixels),
+// which may take the pixels. either returns false to stop.
+template <typename Sink>
+class TextureBandWriter {
+public:
+    TextureBandWriter(Sink &sink, uint32_t width, uint32_t height, int channels, uint32_t factor) : sink(sink), channels(channels)
+    {
+        downsampler.init(width, height, channels, factor);
+        rowBytes = size_t(downsampler.dstWidth) * channels;
+        bandRows = static_cast<uint32_t>(std::max<size_t>(1, (1u << 20) / rowBytes));
+    }
+
+    bool begin() { return sink.begin(downsampler.dstWidth, downsampler.dstHeight, channels); }
+
+    // adds the next source row
+    bool push(const unsigned char *row)
+    {
+        if(band.empty())
+            band.resize(rowBytes * std::min(bandRows, downsampler.dstHeight - bandStart));
+        if(!downsampler.pushRow(row, band.data() + rowBytes * bandFill))
+            return true;
+        if(size_t(++bandFill) * rowBytes < band.size())
+            return true;
+        bool ok = sink.band(bandStart, bandFill, band);
+        bandStart += bandFill;
+        bandFill = 0;
+        band.clear();
+        return ok;
+    }
+
+private:
+    Sink &sink;
+    int channels;
+    BoxDownsampler downsampler;
+    size_t rowBytes;
+    uint32_t bandRows, bandStart = 0, bandFill = 0;
+    vector<unsigned char> band;
+};
+
+// decodes the image at filename, or its contents in data if given, downscaled to at most maxDimension
+// (0 = keep the size) and hands it to sink in bands (see TextureBandWriter). PNGs are decoded row by row,
+// so they never sit in memory whole; other formats go through stb_image. makes no GL calls.
+template <typename Sink>
+bool DecodeTextureBands(const string &filename, int maxDimension, const AssetView *data, Sink &sink)
+{
+    const uint32_t limit = static_cast<uint32_t>(std::max(maxDimension, 0));
+    PngStreamDecoder png;
+    if(data ? png.open(data->data, data->size) : png.open(filename))
+    {
+        TextureBandWriter<Sink> writer(sink, png.width, png.height, png.channels, downsampleFactor(png.width, png.height, limit));
+        if(!writer.begin())
+            return false;
+        vector<unsigned char> row(size_t(png.width) * png.channels);
+        for(uint32_t y = 0; y < png.height; y++)
+        {
+            if(!png.readRow(row.data()))
+            {
+                std::cout << "Texture failed to stream at path: " << filename << " (row " << y << ")" << std::endl;
+                return false;
+            }
+            if(!writer.push(row.data()))
+                return false;
+        }
+        return true;
+    }
+
+    int width, height, nrComponents;
+    unsigned char *pixels = data ? stbi_load_from_memory(data->data, int(data->size), &width, &height, &nrComponents, 0)
+                                 : stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
+    if(!pixels)
+    {
+        std::cout << "Texture failed to load at path: " << filename << " (stbi_load returned NULL)" << std::endl;
+        return false;
+    }
+    TextureBandWriter<Sink> writer(sink, width, height, nrComponents, downsampleFactor(width, height, limit));
+    bool ok = writer.begin();
+    for(int y = 0; y < height && ok; y++)
+        ok = writer.push(pixels + size_t(y) * width * nrComponents);
+    stbi_image_free(pixels);
+    return ok;
+}
+
+// loads textures into a TextureCache, each file once however often it is requested. workers decode the
+// images (DecodeTextureBands) and pass them on in bands through a queue of at most maxBands per texture,
+// and pump(), on the GL thread, allocates each texture, uploads the bands with glTexSubImage2D as they
+// arrive and generates the mipmaps after the last one. a texture in flight never holds more than a few
+// bands of memory, whatever its size. cooked textures are read in one batch per request and uploaded as
+// they are. images over the requested maximum size that have a tile file are left to the model's
+// VirtualTexture and don't go into the cache, failed ones go in with id 0.
+class TextureStreamer {
+public:
+    static const size_t maxBands = 4;
+    // called on a worker whenever it handed something to pump(), for callers that wait for more than textures
+    std::function<void()> onProgress;
+
+    // construct on the GL thread, pump() runs there. threads 0 uses every core, they start with the first request
+    explicit TextureStreamer(TextureCache &cache, unsigned int threads = 0)
+        : cache(cache), threadCount(threads ? threads : std::max(1u, std::thread::hardware_concurrency())), s3tc(HasS3TC()) {}
+
+    ~TextureStreamer()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        workCondition.notify_all();
+        spaceCondition.notify_all();
+        for(std::thread &worker : workers)
+            worker.join();
+        // textures that were cut off halfway
+        for(auto &entry : jobs)
+            if(!entry.second->complete && entry.second->id != 0)
+            {
+                GLState::current().forgetTexture(entry.second->id);
+                glDeleteTextures(1, &entry.second->id);
+            }
+    }
+    TextureStreamer(const TextureStreamer&) = delete;
+    TextureStreamer &operator=(const TextureStreamer&) = delete;
+
+    // queues the files (full paths) that weren't requested before, to be downscaled to at most
+    // maxDimension. can be called from any thread.
+    void request(const vector<string> &filenames, int maxDimension)
+    {
+        shared_ptr<Batch> batch(new Batch());
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for(const string &filename : filenames)
+            {
+                unique_ptr<Job> &job = jobs[filename];
+                if(job)
+                    continue;
+                job.reset(new Job());
+                job->filename = filename;
+                job->maxDimension = maxDimension;
+                batch->jobs.push_back(job.get());
+            }
+            if(batch->jobs.empty())
+                return;
+            batches.push_back(batch);
+            while(workers.size() < threadCount)
+                workers.emplace_back(&TextureStreamer::work, this);
+        }
+        workCondition.notify_one();
+    }
+
+    // whether every one of the files is done and, unless it is left to a VirtualTexture, in the cache
+    bool loaded(const vector<string> &filenames)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for(const string &filename : filenames)
+        {
+            auto found = jobs.find(filename);
+            if(found == jobs.end() || !found->second->complete)
+                return false;
+        }
+        return true;
+    }
+
+    // whether pump() has something to do
+    bool hasWork()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return hasWorkLocked();
+    }
+
+    // uploads the bands the workers handed over and completes the textures they are done with. GL thread only
+    void pump()
+    {
+        vector<Job*> work;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            work = active;
+        }
+        for(Job *job : work)
+        {
+            deque<Band> bands;
+            Result result;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                bands.swap(job->bands);
+                result = job->result;
+            }
+            if(!bands.empty())
+                spaceCondition.notify_all();
+            if(job->begun && job->id == 0)
+                job->id = BeginTextureUpload(job->width, job->height, job->channels);
+            for(const Band &band : bands)
+                UploadTextureBand(job->id, band.y, job->width, band.rows, job->channels, band.pixels.data());
+            if(result != Result::Pending)
+                complete(*job, result);
+        }
+    }
+
+    // pumps until the files requested before are loaded. GL thread only
+    void finish(const vector<string> &filenames)
+    {
+        while(true)
+        {
+            pump();
+            std::unique_lock<std::mutex> lock(mutex);
+            bool done = true;
+            for(const string &filename : filenames)
+            {
+                auto found = jobs.find(filename);
+                done = done && (found == jobs.end() || found->second->complete);
+            }
+            if(done)
+                return;
+            progressCondition.wait(lock, [&]() { return hasWorkLocked(); });
+        }
+    }
+
+private:
+    enum class Result { Pending, Decoded, Cooked, Virtual, Failed };
+    struct Band {
+        uint32_t y, rows;
+        vector<unsigned char> pixels;
+    };
+    struct Batch;
+    struct Job {
+        string filename;
+        int maxDimension = 0;
+        // set by a worker
+        shared_ptr<Batch> batch;         // holds the cooked file until it is uploaded
+        const AssetView *cooked = nullptr;
+        bool begun = false;              // the size is known and bands may follow
+        uint32_t width = 0, height = 0;
+        int channels = 0;
+        deque<Band> bands;
+        bool handedOver = false;         // in active
+        Result result = Result::Pending; // the worker is done with it
+        // GL thread
+        unsigned int id = 0;
+        bool complete = false;
+    };
+    // the jobs of one request, whose cooked versions are read together
+    struct Batch {
+        vector<Job*> jobs;
+        BatchReader reader;
+        vector<BatchRead> cooked;
+    };
+    // DecodeTextureBands sink of a worker
+    struct QueueSink {
+        TextureStreamer &streamer;
+        Job &job;
+
+        bool begin(uint32_t width, uint32_t height, int channels)
+        {
+            if(TextureFormat(channels) == 0)
+            {
+                std::cout << "Texture failed to load at path: " << job.filename << " (" << channels << " channels)" << std::endl;
+                return false;
+            }
+            {
+                std::lock_guard<std::mutex> lock(streamer.mutex);
+                job.width = width;
+                job.height = height;
+                job.channels = channels;
+                job.begun = true;
+                streamer.handOver(job);
+            }
+            streamer.notifyProgress();
+            return true;
+        }
+
+        bool band(uint32_t y, uint32_t rows, vector<unsigned char> &pixels)
+        {
+            {
+                std::unique_lock<std::mutex> lock(streamer.mutex);
+                streamer.spaceCondition.wait(lock, [&]() { return streamer.stopping || job.bands.size() < maxBands; });
+                if(streamer.stopping)
+                    return false;
+                job.bands.push_back(Band{ y, rows, std::move(pixels) });
+            }
+            streamer.notifyProgress();
+            return true;
+        }
+    };
+
+    TextureCache &cache;
+    const unsigned int threadCount;
+    const bool s3tc; // cooked textures are only read if they can be uploaded
+    std::mutex mutex;
+    std::condition_variable workCondition, spaceCondition, progressCondition;
+    bool stopping = false;
+    vector<std::thread> workers;
+    map<string, unique_ptr<Job>> jobs; // every file requested, by full path
+    deque<shared_ptr<Batch>> batches;  // requests whose cooked files aren't read yet
+    deque<Job*> queued;                // jobs no worker has taken yet
+    vector<Job*> active;               // jobs with something for pump()
+
+    bool hasWorkLocked() const
+    {
+        for(const Job *job : active)
+            if(!job->bands.empty() || job->result != Result::Pending || (job->begun && job->id == 0))
+                return true;
+        return false;
+    }
+
+    void handOver(Job &job)
+    {
+        if(!job.handedOver)
+            active.push_back(&job);
+        job.handedOver = true;
+    }
+
+    void notifyProgress()
+    {
+        progressCondition.notify_all();
+        if(onProgress)
+            onProgress();
+    }
+
+    void work()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        while(true)
+        {
+            workCondition.wait(lock, [&]() { return stopping || !batches.empty() || !queued.empty(); });
+            if(stopping)
+                return;
+            if(!batches.empty())
+            {
+                shared_ptr<Batch> batch = batches.front();
+                batches.pop_front();
+                lock.unlock();
+                for(Job *job : batch->jobs)
+                    batch->cooked.push_back(BatchRead(job->filename + ".ctex"));
+                if(s3tc)
+                    batch->reader.read(batch->cooked);
+                lock.lock();
+                // the batch is complete, so the views stay where they are from here on
+                for(size_t i = 0; i < batch->jobs.size(); i++)
+                {
+                    if(batch->cooked[i].ok)
+                    {
+                        batch->jobs[i]->batch = batch;
+                        batch->jobs[i]->cooked = &batch->cooked[i].view;
+                    }
+                    queued.push_back(batch->jobs[i]);
+                }
+                workCondition.notify_all();
+                continue;
+            }
+            Job *job = queued.front();
+            queued.pop_front();
+            lock.unlock();
+            Result result = decode(*job);
+            lock.lock();
+            job->result = result;
+            handOver(*job);
+            lock.unlock();
+            notifyProgress();
+            lock.lock();
+        }
+    }
+
+    Result decode(Job &job)
+    {
+        AssetView packed;
+        const AssetView *data = readPackedAsset(job.filename, packed) ? &packed : nullptr;
+        int width = 0, height = 0, nrComponents = 0;
+        bool known = data ? stbi_info_from_memory(data->data, int(data->size), &width, &height, &nrComponents)
+                          : stbi_info(job.filename.c_str(), &width, &height, &nrComponents);
+        bool oversized = known && job.maxDimension > 0 && std::max(width, height) > job.maxDimension;
+        if(oversized)
+        {
+            // too big to upload whole, the model streams it as tiles instead (see Model::loadTexture)
+            string tileFile = job.filename + ".vt";
+            AssetPack *pack = AssetPack::mounted();
+            if((pack && pack->contains(tileFile)) || std::ifstream(tileFile.c_str()).good())
+                return Result::Virtual;
+        }
+        if(job.cooked)
+            return Result::Cooked;
+        if(oversized)
+            std::cout << "Model: '" << job.filename << "' is " << width << "x" << height << ", downscaling. Run TextureTiler on it to create '"
+                      << job.filename << ".vt' and stream it at full resolution" << std::endl;
+        QueueSink sink = { *this, job };
+        return DecodeTextureBands(job.filename, job.maxDimension, data, sink) ? Result::Decoded : Result::Failed;
+    }
+
+    // finishes a texture the worker is done with and puts it in the cache
+    void complete(Job &job, Result result)
+    {
+        Texture texture;
+        texture.id = 0;
+        if(result == Result::Decoded && job.id != 0)
+        {
+            EndTextureUpload(job.id);
+            texture.id = job.id;
+        }
+        else if(result == Result::Cooked)
+        {
+            glGenTextures(1, &texture.id);
+            if(!TextureFromCooked(job.cooked->data, job.cooked->size, job.filename, texture.id))
+            {
+                GLState::current().forgetTexture(texture.id);
+                glDeleteTextures(1, &texture.id);
+                size_t slash = job.filename.find_last_of('/');
+                texture.id = TextureFromFile(job.filename.substr(slash + 1).c_str(), job.filename.substr(0, slash), job.maxDimension);
+            }
+        }
+        else if(job.id != 0)
+        {
+            // whatever a failed decode uploaded never gets used
+            GLState::current().forgetTexture(job.id);
+            glDeleteTextures(1, &job.id);
+        }
+        job.id = texture.id;
+        if(result != Result::Virtual)
+            cache.textures[job.filename] = texture;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        job.cooked = nullptr;
+        job.batch.reset();
+        job.complete = true;
+        active.erase(std::find(active.begin(), active.end(), &job));
+    }
+};
+
+// a mesh, or a copy of shared geometry, as drawn for instances of the whole model. levels holds its
+// index range (byte offset and count) at every model level of detail.
+struct InstancedDraw {
+    unsigned int VAO;
+    GLenum indexType;
+    Material *material;
+    GLint baseVertex;
+    glm::vec3 copyOffset; // translation of a copy inside the model, (0,0,0) for meshes
+    vector<std::pair<size_t, GLsizei>> levels;
+};
 
 class Model 
 {
@@ -31,227 +510,1022 @@ public:
     vector<Mesh>    meshes;
     string directory;
     bool gammaCorrection;
+    VertexLayout vertexLayout; // how the meshes pack their vertices on the GPU
+    MeshResidency residency;   // what the meshes keep in system memory after upload
+    MeshOptimizeSettings optimizeSettings; // import time welding/reordering, see mesh_optimizer.h
+    shared_ptr<GeometryArena> arena = make_shared<GeometryArena>(); // shared vertex/index buffers of all meshes, instance groups of other models may hold it too
+    vector<DrawBatch> batches; // one multi draw per material
+    vector<InstanceGroup> instanceGroups; // translated copies of geometry that is uploaded once
+    vector<InstancedDraw> instancedDraws; // everything SubmitInstances draws, grouped by material
+    // culling stats of the last DrawCulled call, meshesVisible after frustum and occlusion culling
+    unsigned int meshesVisible = 0, meshesTotal = 0;
+    unsigned int meshletsVisible = 0, meshletsTotal = 0;
+    // levels of detail: settings used at import, the error of each level over all meshes, and the runtime selector
+    LodSettings lodSettings;
+    vector<float> lodErrors;
+    LodSelector lodSelector;
+    // object space bounding box and sphere of the whole model, and the box of every mesh
+    glm::vec3 boundsMin = glm::vec3(0.0f), boundsMax = glm::vec3(0.0f);
+    glm::vec3 boundsCenter = glm::vec3(0.0f);
+    float boundsRadius = 0.0f;
+    BoundsSoA meshBounds;
+    // textures larger than this are not decoded whole but streamed from a tile file made by TextureTiler
+    int maxTextureDimension = 8192;
+    vector<unique_ptr<VirtualTexture>> virtualTextures;
+
+    // threads processMesh and the texture decoding are spread over, 0 uses every core
+    unsigned int importThreads = 0;
+    // prints the level of detail, optimization and memory statistics of every load
+    bool verbose = false;
 
     // constructor, expects a filepath to a 3D model.
-    Model(string const &path, bool gamma = false) : gammaCorrection(gamma)
+    Model(string const &path, bool gamma = false, VertexLayout layout = VertexLayout::Compact(),
+          MeshResidency residency = MeshResidency::PositionsAndIndices)
+        : gammaCorrection(gamma), vertexLayout(layout), residency(residency)
     {
-        loadModel(path);
+        if(Import(path))
+            Upload();
     }
 
-    // draws the model, and thus all its meshes
-    void Draw(Shader &shader)
+    // an empty model for loading in two steps, Import (on any thread) and then Upload (on the GL thread)
+    Model() : gammaCorrection(false), vertexLayout(VertexLayout::Compact()), residency(MeshResidency::PositionsAndIndices) {}
+
+    // CPU half of loading: imports the model (or its cooked version) and optimizes the meshes. makes no
+    // GL calls, so several models can be imported on worker threads at once.
+    bool Import(string const &path)
+    {
+        // Debug: announce model loading
+        cout << "Model: loading '" << path << "'" << endl;
+        sourcePath = path;
+
+        // retrieve the directory path of the filepath
+        directory = path.substr(0, path.find_last_of('/'));
+
+        // the AssetCooker output has everything processNode would compute already
+        if(!loadCooked(path + ".cooked"))
+        {
+            // read file via ASSIMP, one importer per model so imports can run side by side
+            Assimp::Importer importer;
+            // read the model and its material files out of the asset pack if one is mounted
+            if(AssetPack *pack = AssetPack::mounted())
+                importer.SetIOHandler(new AssetPackIOSystem(*pack));
+            const aiScene* scene = importer.ReadFile(path, MODEL_IMPORT_FLAGS);
+            // check for errors
+            if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
+            {
+                cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
+                return false;
+            }
+
+            // material textures in the order the shaders expect them: diffuse, specular, normal, height
+            materials.assign(scene->mNumMaterials, CookedMaterial());
+            for(unsigned int m = 0; m < scene->mNumMaterials; m++)
+                for(const MaterialTextureSlot &slot : MATERIAL_TEXTURE_SLOTS)
+                    for(unsigned int t = 0; t < scene->mMaterials[m]->GetTextureCount(slot.type); t++)
+                    {
+                        aiString str;
+                        scene->mMaterials[m]->GetTexture(slot.type, t, &str);
+                        materials[m].types.push_back(slot.name);
+                        materials[m].paths.push_back(str.C_Str());
+                    }
+
+            // process ASSIMP's meshes, spread over the import threads
+            vector<aiMesh*> sceneMeshes;
+            processNode(scene->mRootNode, scene, sceneMeshes);
+            processMeshes(sceneMeshes);
+        }
+        return true;
+    }
+
+    // full paths of the material textures, once each. known after Import
+    vector<string> TextureFiles() const
+    {
+        vector<string> files;
+        for(const CookedMaterial &material : materials)
+            for(const string &path : material.paths)
+                files.push_back(directory + '/' + path);
+        std::sort(files.begin(), files.end());
+        files.erase(std::unique(files.begin(), files.end()), files.end());
+        return files;
+    }
+
+    // GL half of loading: loads the textures and packs the meshes into the arena. the textures are
+    // decoded on worker threads and uploaded band by band by streamer, which has to load into cache, or
+    // by a streamer of the model's own. they are looked up in and added to cache if one is given, so
+    // models sharing a texture load it once.
+    // meshes whose geometry is in registry already (from this model or, with a shared registry, any
+    // other) aren't uploaded again but drawn as instances of the first copy.
+    void Upload(TextureCache *cache = nullptr, GeometryRegistry *registry = nullptr, TextureStreamer *streamer = nullptr)
     {
+        textureCache = cache;
+        TextureCache modelTextures; // owned by the model, see Release
+        TextureCache &textures = cache ? *cache : modelTextures;
+        {
+            vector<string> files;
+            for(const string &file : TextureFiles())
+                if(!textures.textures.count(file))
+                    files.push_back(file);
+            unique_ptr<TextureStreamer> modelStreamer;
+            if(!streamer)
+            {
+                modelStreamer.reset(new TextureStreamer(textures, importThreads));
+                streamer = modelStreamer.get();
+            }
+            streamer->request(files, maxTextureDimension);
+            streamer->finish(files);
+        }
+        vector<vector<Texture>> materialTextures(materials.size());
+        for(unsigned int m = 0; m < materials.size(); m++)
+            for(unsigned int t = 0; t < materials[m].paths.size(); t++)
+                materialTextures[m].push_back(loadTexture(materials[m].paths[t], materials[m].types[t], textures));
+        for(unsigned int i = 0; i < meshes.size(); i++)
+            if(meshes[i].materialIndex < materialTextures.size())
+            {
+                meshes[i].textures = materialTextures[meshes[i].materialIndex];
+                meshes[i].material.build(meshes[i].textures);
+            }
+
+        // find the meshes that are copies of geometry registered before
+        GeometryRegistry modelRegistry;
+        geometryRegistry = registry;
+        GeometryRegistry &geometry = registry ? *registry : modelRegistry;
+        vector<GeometryKey> keys(meshes.size());
+        vector<GeometryData> contents(meshes.size());
+        multimap<GeometryKey, unsigned int> firstCopy;
+        for(unsigned int i = 0; i < meshes.size(); i++)
+        {
+            keys[i] = geometryKey(meshes[i], vertexLayout, contents[i]);
+            bool copy = geometry.find(keys[i], contents[i]) != nullptr;
+            auto range = firstCopy.equal_range(keys[i]);
+            for(auto it = range.first; it != range.second && !copy; ++it)
+                copy = contents[it->second] == contents[i];
+            meshes[i].sharesGeometry = meshes[i].indexCount > 0 && copy;
+            if(!meshes[i].sharesGeometry)
+                firstCopy.emplace(keys[i], i);
+        }
+
+        // pack every other mesh into the shared buffers and group them into per material draws
+        arena->build(meshes, vertexLayout);
+        batches = GeometryArena::buildBatches(meshes);
+        for(auto &entry : firstCopy)
+            geometry.add(entry.first, contents[entry.second], meshes[entry.second], arena);
+        buildInstanceGroups(keys, contents, geometry);
+        computeBounds();
+
+        // a model level of detail is the same level of every mesh, its error the worst of them
+        lodErrors.assign(1, 0.0f);
+        vector<size_t> lodTriangles(1, 0);
         for(unsigned int i = 0; i < meshes.size(); i++)
-            meshes[i].Draw(shader);
+        {
+            lodTriangles[0] += meshes[i].indices.size() / 3;
+            for(unsigned int l = 0; l < meshes[i].lods.size(); l++)
+            {
+                if(lodErrors.size() < l + 2)
+                {
+                    lodErrors.push_back(0.0f);
+                    lodTriangles.push_back(0);
+                }
+                lodErrors[l + 1] = std::max(lodErrors[l + 1], meshes[i].lods[l].error);
+            }
+        }
+        // meshes with fewer levels keep drawing their coarsest one
+        for(unsigned int l = 1; l < lodErrors.size(); l++)
+        {
+            lodErrors[l] = std::max(lodErrors[l], lodErrors[l - 1]);
+            for(unsigned int i = 0; i < meshes.size(); i++)
+            {
+                unsigned int level = std::min<unsigned int>(l, static_cast<unsigned int>(meshes[i].lods.size()));
+                lodTriangles[l] += (level == 0 ? meshes[i].indices.size() : meshes[i].lods[level - 1].indices.size()) / 3;
+            }
+        }
+        buildInstancedDraws();
+        if(verbose)
+        {
+            cout << "Model: " << lodErrors.size() << " level(s) of detail, triangles";
+            for(unsigned int l = 0; l < lodTriangles.size(); l++)
+                cout << (l ? " / " : " ") << lodTriangles[l];
+            cout << endl;
+        }
+
+        if(verbose && optimizedTriangles > 0)
+            cout << "Model: optimized " << optimizedTriangles << " triangles, ACMR " << missesBefore / optimizedTriangles
+                 << " -> " << missesAfter / optimizedTriangles << " (cache size " << optimizeSettings.cacheSize << ")" << endl;
+        // everything is on the GPU now, drop what the residency policy doesn't need
+        size_t vertexCount = 0, released = 0, resident = 0;
+        for(unsigned int i = 0; i < meshes.size(); i++)
+        {
+            vertexCount += meshes[i].vertexCount;
+            released += meshes[i].releaseCpuData(residency);
+            resident += meshes[i].cpuBytes();
+        }
+        if(verbose && !instanceGroups.empty())
+        {
+            size_t copies = 0, savedBytes = 0;
+            for(const InstanceGroup &group : instanceGroups)
+                for(unsigned int m : group.meshIndices)
+                {
+                    copies++;
+                    savedBytes += meshes[m].vertexCount * vertexLayout.stride() + meshes[m].indexCount * indexSize(arena->indexType);
+                }
+            cout << "Model: " << copies << " mesh(es) are translated copies drawn as instances of " << instanceGroups.size()
+                 << " shared geometry(s), " << savedBytes / 1024 << " KB not uploaded" << endl;
+        }
+        if(verbose)
+            cout << "Model: released " << released / 1024 << " KB of CPU mesh data, " << resident / 1024 << " KB stay resident" << endl;
+        cout << "Model: loaded '" << sourcePath << "' with " << meshes.size() << " mesh(es) in " << batches.size() << " draw batch(es), "
+             << vertexCount << " vertices, " << vertexLayout.stride() << " bytes/vertex (" << sizeof(Vertex) << " unpacked), "
+             << (arena->vertexBytes + arena->indexBytes) / 1024 << " KB of vertex+index data" << endl;
+    }
+
+    // draws the model, and thus all its meshes. the meshes share one VAO, so this is a single
+    // glMultiDrawElementsBaseVertex per material instead of a VAO bind and draw per mesh.
+    // the "model" uniform is left to the caller.
+    void Draw(Shader &shader)
+    {
+        submitDraws(drawQueue, shader, nullptr, nullptr, nullptr, glm::vec3(0.0f), 0, 0.0f);
+        drawQueue.flush();
+    }
+
+    // picks the level of detail for one instance of this model from its screen space error
+    int SelectLod(LodState &state, const glm::mat4 &model, const glm::vec3 &cameraPosition, float fovY, float viewportHeight)
+    {
+        float scale = glm::max(glm::length(glm::vec3(model[0])), glm::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+        glm::vec3 center = glm::vec3(model * glm::vec4(boundsCenter, 1.0f));
+        return SelectLod(state, center, scale, cameraPosition, fovY, viewportHeight);
+    }
+
+    // the same for an instance scaled uniformly by scale whose bounds center ended up at center
+    int SelectLod(LodState &state, const glm::vec3 &center, float scale, const glm::vec3 &cameraPosition, float fovY, float viewportHeight)
+    {
+        float distance = glm::length(center - cameraPosition) - boundsRadius * scale;
+        // the selector works in object space units, so scale the distance down instead of the errors up
+        return lodSelector.select(state, lodErrors, distance / glm::max(scale, 1e-6f), fovY, viewportHeight);
+    }
+
+    // requests the virtual texture tiles the model samples from this view and streams finished tiles in.
+    // every visible meshlet (or mesh, without meshlets) asks for the tiles under its uv bounds at the level
+    // its screen size needs: a part spanning uvSize of the texture and covering pixels on screen needs the
+    // texture about pixels / uvSize texels across. call once per frame before drawing.
+    void UpdateVirtualTextures(const glm::mat4 &projection, const glm::mat4 &view, const glm::mat4 &model, float fovY, float viewportHeight)
+    {
+        if(virtualTextures.empty())
+            return;
+        // object space, like Submit. sizes and distances are then both unscaled, so the ratio needs no scale
+        Frustum frustum = Frustum::fromMatrix(projection * view * model);
+        glm::vec3 cameraPosition = glm::vec3(glm::inverse(view * model)[3]);
+        float pixelsPerUnit = viewportHeight / (2.0f * std::tan(fovY * 0.5f));
+        auto request = [&](VirtualTexture &vt, const glm::vec3 &center, float radius, glm::vec2 uvMin, glm::vec2 uvMax) {
+            float distance = glm::max(glm::length(center - cameraPosition) - radius, 1e-3f);
+            float pixels = 2.0f * radius / distance * pixelsPerUnit;
+            glm::vec2 uvSize = glm::max(uvMax - uvMin, glm::vec2(1e-6f));
+            vt.requestRegion(uvMin, uvMax, vt.levelForFootprint(pixels / glm::max(uvSize.x, uvSize.y)));
+        };
+        for(const Mesh &mesh : meshes)
+        {
+            for(const Texture &texture : mesh.textures)
+            {
+                if(!texture.virtualTexture || mesh.vertexCount == 0 || !frustum.intersectsAABB(mesh.boundsMin, mesh.boundsMax))
+                    continue;
+                if(mesh.meshlets.empty())
+                {
+                    request(*texture.virtualTexture, mesh.boundsCenter, mesh.boundsRadius, mesh.uvMin, mesh.uvMax);
+                    continue;
+                }
+                for(const Meshlet &meshlet : mesh.meshlets)
+                    if(meshletVisible(meshlet, frustum, cameraPosition))
+                        request(*texture.virtualTexture, meshlet.center, meshlet.radius, meshlet.uvMin, meshlet.uvMax);
+            }
+        }
+        for(unsigned int i = 0; i < virtualTextures.size(); i++)
+            virtualTextures[i]->update();
+    }
+
+    // queues the model's draws with the given transform for the frame's queue to sort together with
+    // everything else. only the meshlets that are inside the view frustum and not entirely backfacing are
+    // drawn, visible meshlets that are adjacent in the index buffer are merged into one range. lod > 0 draws
+    // that level of detail of every mesh instead, coarse levels skip meshlet culling. the draw lists live in
+    // the model, so submit a model once per flush. with an occlusion culler the meshes hidden behind its
+    // occluders are left out as well.
+    void Submit(RenderQueue &queue, Shader &shader, const glm::mat4 &projection, const glm::mat4 &view, const glm::mat4 &model, int lod = 0,
+                const OcclusionCuller *occlusion = nullptr)
+    {
+        // all of it hidden, no need to look at the meshes
+        if(occlusion && !occlusion->visible(boundsMin, boundsMax, model))
+        {
+            meshesTotal = static_cast<unsigned int>(meshes.size());
+            meshesVisible = 0;
+            meshletsVisible = 0;
+            meshletsTotal = 0;
+            return;
+        }
+        // cull in object space, that way the meshlet bounds never have to be transformed
+        Frustum frustum = Frustum::fromMatrix(projection * view * model);
+        glm::vec3 cameraPosition = glm::vec3(glm::inverse(view * model)[3]);
+        float depth = -(view * model * glm::vec4(boundsCenter, 1.0f)).z;
+        submitDraws(queue, shader, &model, &frustum, occlusion, cameraPosition, lod, depth);
+    }
+
+    // offers the meshes that kept their positions in system memory to the culler as occluders, placed by model
+    void AddOccluders(OcclusionCuller &occlusion, const glm::mat4 &model) const
+    {
+        for(const Mesh &mesh : meshes)
+            occlusion.addMesh(mesh, model);
+    }
+
+    // queues the model count times in one instanced draw per mesh, placed by the InstanceTransforms in
+    // instanceBuffer from offset on (see fleet.h). shader has to read them instead of "model". no meshlet
+    // culling, cull the instances before writing the buffer.
+    void SubmitInstances(RenderQueue &queue, Shader &shader, unsigned int instanceBuffer, size_t offset, GLsizei count, int lod, float depth)
+    {
+        if(arena->VAO == 0 || count == 0)
+            return;
+        DrawCommand command;
+        command.type = DrawCommand::Type::ElementsInstanced;
+        command.shader = &shader;
+        command.octNormals = arena->layout.normals == NormalEncoding::Octahedral;
+        command.instanceCount = count;
+        command.instanceBuffer = instanceBuffer;
+        command.instanceOffset = offset;
+        command.instanceTransforms = true;
+        for(const InstancedDraw &draw : instancedDraws)
+        {
+            const std::pair<size_t, GLsizei> &range = draw.levels[std::min<size_t>(lod, draw.levels.size() - 1)];
+            command.VAO = draw.VAO;
+            command.indexType = draw.indexType;
+            command.material = draw.material;
+            command.indexOffset = range.first;
+            command.count = range.second;
+            command.baseVertex = draw.baseVertex;
+            // the copies of shared geometry are instances already, each is one more instanced draw of the whole set
+            command.copyOffset = draw.copyOffset;
+            queue.submit(RenderBucket::Opaque, 0, depth, command);
+        }
+    }
+
+    // Submit and draw right away
+    void DrawCulled(Shader &shader, const glm::mat4 &projection, const glm::mat4 &view, const glm::mat4 &model, int lod = 0)
+    {
+        Submit(drawQueue, shader, projection, view, model, lod);
+        drawQueue.flush();
     }
     
+    // deletes the model's buffers and textures. the model is empty afterwards
+    void Release()
+    {
+        // the buffers are deleted with the last model drawing from them, copies of this model's geometry
+        // in other models' instance groups keep them alive until those are released too
+        if(geometryRegistry)
+            geometryRegistry->remove(arena->VAO);
+        for(InstanceGroup &group : instanceGroups)
+            releaseArena(group.geometry.arena);
+        releaseArena(arena);
+        arena = make_shared<GeometryArena>();
+        if(instanceVBO != 0)
+            glDeleteBuffers(1, &instanceVBO);
+        instanceVBO = 0;
+        instanceGroups.clear();
+        for(unsigned int i = 0; i < textures_loaded.size(); i++)
+            if(textures_loaded[i].id != 0 && !(textureCache && textureCache->textures.count(directory + '/' + textures_loaded[i].path)))
+            {
+                GLState::current().forgetTexture(textures_loaded[i].id);
+                glDeleteTextures(1, &textures_loaded[i].id);
+            }
+        textures_loaded.clear();
+        virtualTextures.clear();
+        meshes.clear();
+        meshBounds.resize(0);
+        batches.clear();
+        instancedDraws.clear();
+    }
+
+    // reloads the texture at path (relative to the model) from directory and points every mesh using it at
+    // the new texture object. the old texture stays in use if the new file fails to load.
+    bool ReloadTexture(const string &path, const string &fromDirectory)
+    {
+        unsigned int oldId = 0;
+        bool found = false;
+        for(unsigned int i = 0; i < textures_loaded.size() && !found; i++)
+            if(textures_loaded[i].path == path)
+            {
+                if(textures_loaded[i].virtualTexture != nullptr)
+                {
+                    std::cout << "Model: '" << path << "' is streamed from its tile file, run TextureTiler again and restart to see changes" << std::endl;
+                    return false;
+                }
+                if(textureCache && textureCache->textures.count(directory + '/' + path))
+                {
+                    std::cout << "Model: '" << path << "' is shared with other models, reload the scene to see changes" << std::endl;
+                    return false;
+                }
+                oldId = textures_loaded[i].id;
+                found = true;
+            }
+        if(!found)
+            return false;
+
+        unsigned int id = TextureFromFile(path.c_str(), fromDirectory, maxTextureDimension);
+        if(id == 0)
+        {
+            std::cout << "Model: keeping the previous '" << path << "', the new file failed to load" << std::endl;
+            return false;
+        }
+        for(unsigned int i = 0; i < textures_loaded.size(); i++)
+            if(textures_loaded[i].id == oldId)
+                textures_loaded[i].id = id;
+        for(unsigned int i = 0; i < meshes.size(); i++)
+        {
+            bool changed = false;
+            for(unsigned int j = 0; j < meshes[i].textures.size(); j++)
+                if(meshes[i].textures[j].id == oldId && meshes[i].textures[j].virtualTexture == nullptr)
+                {
+                    meshes[i].textures[j].id = id;
+                    changed = true;
+                }
+            if(changed)
+                meshes[i].material.build(meshes[i].textures);
+        }
+        GLState::current().forgetTexture(oldId);
+        glDeleteTextures(1, &oldId);
+        return true;
+    }
+
 private:
-    // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
-    void loadModel(string const &path)
+    // draw lists of the last submission, one per batch. they have to outlive the queue's flush and are
+    // kept around so culling doesn't allocate every frame.
+    struct CulledBatch {
+        vector<GLsizei> counts;
+        vector<void*>   offsets;
+        vector<GLint>   baseVertices;
+    };
+    vector<CulledBatch> culled;
+    vector<uint32_t> visibleMeshes; // of the last submission, by index
+    vector<uint8_t> meshVisible;    // the same as a flag per mesh
+    RenderQueue drawQueue; // for Draw and DrawCulled
+
+    string sourcePath;
+    // the registry this model's geometry was added to, when it is shared with other models
+    GeometryRegistry *geometryRegistry = nullptr;
+    // per instance offsets of the instance groups, refilled with the visible ones every draw
+    unsigned int instanceVBO = 0;
+    vector<glm::vec3> visibleOffsets; // of every group, uploaded to instanceVBO in one go
+    // texture types and paths of each material, from the import
+    vector<CookedMaterial> materials;
+    // textures shared with other models, owned by the cache. set by Upload
+    TextureCache *textureCache = nullptr;
+
+    // optimization totals over all meshes, ACMR is reported triangle weighted
+    double missesBefore = 0.0, missesAfter = 0.0;
+    size_t optimizedTriangles = 0;
+
+    // builds the meshes from a cooked model (see cooked_asset.h). false if there is none, it is damaged or
+    // it was cooked with other optimization or level of detail settings; the model is then imported normally.
+    bool loadCooked(const string &cookedPath)
     {
-        // Debug: announce model loading
-        cout << "Model: loading '" << path << "'" << endl;
+        AssetView view;
+        if(!readAssetFile(cookedPath, view))
+            return false;
+        CookedModel cooked;
+        if(!readCookedModel(view.data, view.size, cooked) || cooked.settingsHash != cookSettingsHash(optimizeSettings, lodSettings))
+        {
+            cout << "Model: ignoring out of date cooked model '" << cookedPath << "'" << endl;
+            return false;
+        }
 
-        // read file via ASSIMP
-        Assimp::Importer importer;
-        const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
-        // check for errors
-        if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
+        materials = std::move(cooked.materials);
+        for(unsigned int i = 0; i < cooked.meshes.size(); i++)
         {
-            cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
+            CookedMesh &mesh = cooked.meshes[i];
+            // the textures are attached by Upload
+            Mesh result(std::move(mesh.vertices), std::move(mesh.indices), vector<Texture>(), vertexLayout, false);
+            result.materialIndex = mesh.materialIndex;
+            result.meshlets = std::move(mesh.meshlets);
+            for(unsigned int l = 0; l < mesh.lods.size(); l++)
+            {
+                MeshLod lod;
+                lod.indices = std::move(mesh.lods[l].indices);
+                lod.error = mesh.lods[l].error;
+                result.lods.push_back(std::move(lod));
+            }
+            meshes.push_back(std::move(result));
+        }
+        cout << "Model: using cooked '" << cookedPath << "'" << endl;
+        return true;
+    }
+
+    // groups the meshes that share geometry by that geometry and their material, one instanced draw each
+    void buildInstanceGroups(const vector<GeometryKey> &keys, const vector<GeometryData> &contents, const GeometryRegistry &geometry)
+    {
+        instanceGroups.clear();
+        map<std::pair<const SharedGeometry*, unsigned int>, size_t> groups;
+        for(unsigned int i = 0; i < meshes.size(); i++)
+        {
+            if(!meshes[i].sharesGeometry)
+                continue;
+            const SharedGeometry *shared = geometry.find(keys[i], contents[i]);
+            auto it = groups.find(std::make_pair(shared, meshes[i].materialIndex));
+            if(it == groups.end())
+            {
+                InstanceGroup group;
+                group.geometry = *shared;
+                group.firstMesh = i;
+                it = groups.emplace(std::make_pair(shared, meshes[i].materialIndex), instanceGroups.size()).first;
+                instanceGroups.push_back(group);
+            }
+            instanceGroups[it->second].meshIndices.push_back(i);
+            instanceGroups[it->second].offsets.push_back(meshes[i].boundsMin - shared->origin);
+        }
+        if(!instanceGroups.empty() && instanceVBO == 0)
+            glGenBuffers(1, &instanceVBO);
+    }
+
+    // drops a reference to an arena and deletes its buffers if it was the last one
+    static void releaseArena(shared_ptr<GeometryArena> &shared)
+    {
+        if(shared && shared.use_count() == 1)
+            shared->release();
+        shared.reset();
+    }
+
+    // one InstancedDraw per mesh in batch order, then one per copy of shared geometry. meshes with fewer
+    // levels than the model keep drawing their coarsest one.
+    void buildInstancedDraws()
+    {
+        instancedDraws.clear();
+        for(const DrawBatch &batch : batches)
+            for(unsigned int m : batch.meshIndices)
+            {
+                Mesh &mesh = meshes[m];
+                if(mesh.indexCount == 0)
+                    continue;
+                InstancedDraw draw = { arena->VAO, arena->indexType, &mesh.material, mesh.baseVertex, glm::vec3(0.0f), {} };
+                for(unsigned int l = 0; l < lodErrors.size(); l++)
+                {
+                    unsigned int level = std::min<unsigned int>(l, static_cast<unsigned int>(mesh.lods.size()));
+                    draw.levels.push_back(level == 0 ? std::make_pair(mesh.indexOffset, mesh.indexCount)
+                                                     : std::make_pair(mesh.lods[level - 1].indexOffset, mesh.lods[level - 1].indexCount));
+                }
+                instancedDraws.push_back(draw);
+            }
+        for(const InstanceGroup &group : instanceGroups)
+            for(const glm::vec3 &copyOffset : group.offsets)
+            {
+                InstancedDraw draw = { group.geometry.VAO, group.geometry.indexType, &meshes[group.firstMesh].material, group.geometry.baseVertex, copyOffset, {} };
+                for(unsigned int l = 0; l < lodErrors.size(); l++)
+                {
+                    unsigned int level = std::min<unsigned int>(l, static_cast<unsigned int>(group.geometry.lods.size()));
+                    draw.levels.push_back(level == 0 ? std::make_pair(group.geometry.indexOffset, group.geometry.indexCount) : group.geometry.lods[level - 1]);
+                }
+                instancedDraws.push_back(draw);
+            }
+    }
+
+    // queues a draw per batch and per instance group. transform is the "model" matrix of the draws (left
+    // alone if null), frustum and cameraPosition are in object space and cull meshlets and instances if given.
+    // occlusion additionally culls the meshes that survived the frustum, it needs transform and frustum.
+    void submitDraws(RenderQueue &queue, Shader &shader, const glm::mat4 *transform, const Frustum *frustum, const OcclusionCuller *occlusion,
+                     const glm::vec3 &cameraPosition, int lod, float depth)
+    {
+        if(arena->VAO == 0)
             return;
+        DrawCommand command;
+        command.shader = &shader;
+        command.hasTransform = transform != nullptr;
+        if(transform)
+            command.transform = *transform;
+        command.octNormals = arena->layout.normals == NormalEncoding::Octahedral;
+
+        const size_t stride = indexSize(arena->indexType);
+        meshletsVisible = 0;
+        meshletsTotal = 0;
+        // whole meshes first, eight boxes at a time. meshlets are only looked at for the visible ones
+        meshesTotal = static_cast<unsigned int>(meshes.size());
+        meshesVisible = meshesTotal;
+        if(frustum)
+        {
+            visibleMeshes.clear();
+            cullBounds(*frustum, meshBounds, visibleMeshes);
+            if(occlusion && transform)
+            {
+                size_t kept = 0;
+                for(uint32_t m : visibleMeshes)
+                    if(occlusion->visible(meshes[m].boundsMin, meshes[m].boundsMax, *transform))
+                        visibleMeshes[kept++] = m;
+                visibleMeshes.resize(kept);
+            }
+            meshVisible.assign(meshes.size(), 0);
+            for(uint32_t m : visibleMeshes)
+                meshVisible[m] = 1;
+            meshesVisible = static_cast<unsigned int>(visibleMeshes.size());
+        }
+        culled.resize(batches.size());
+        for(unsigned int i = 0; i < batches.size(); i++)
+        {
+            const DrawBatch &batch = batches[i];
+            CulledBatch &draws = culled[i];
+            draws.counts.clear();
+            draws.offsets.clear();
+            draws.baseVertices.clear();
+            for(unsigned int m = 0; m < batch.meshIndices.size() && (frustum || lod > 0); m++)
+            {
+                if(frustum && !meshVisible[batch.meshIndices[m]])
+                    continue;
+                const Mesh &mesh = meshes[batch.meshIndices[m]];
+                int level = std::min<int>(lod, static_cast<int>(mesh.lods.size()));
+                if(level > 0)
+                {
+                    draws.counts.push_back(mesh.lods[level - 1].indexCount);
+                    draws.offsets.push_back(reinterpret_cast<void*>(mesh.lods[level - 1].indexOffset));
+                    draws.baseVertices.push_back(mesh.baseVertex);
+                    continue;
+                }
+                if(mesh.meshlets.empty() || !frustum)
+                {
+                    draws.counts.push_back(mesh.indexCount);
+                    draws.offsets.push_back(reinterpret_cast<void*>(mesh.indexOffset));
+                    draws.baseVertices.push_back(mesh.baseVertex);
+                    continue;
+                }
+                for(const Meshlet &meshlet : mesh.meshlets)
+                {
+                    meshletsTotal++;
+                    if(!meshletVisible(meshlet, *frustum, cameraPosition))
+                        continue;
+                    meshletsVisible++;
+                    size_t offset = mesh.indexOffset + meshlet.firstIndex * stride;
+                    GLsizei count = static_cast<GLsizei>(meshlet.triangleCount * 3);
+                    if(!draws.counts.empty() && draws.baseVertices.back() == mesh.baseVertex &&
+                       reinterpret_cast<size_t>(draws.offsets.back()) + draws.counts.back() * stride == offset)
+                        draws.counts.back() += count;
+                    else
+                    {
+                        draws.counts.push_back(count);
+                        draws.offsets.push_back(reinterpret_cast<void*>(offset));
+                        draws.baseVertices.push_back(mesh.baseVertex);
+                    }
+                }
+            }
+            // everything at full detail, the batch's own lists will do
+            const bool whole = !frustum && lod == 0;
+            command.type = DrawCommand::Type::MultiElements;
+            command.VAO = arena->VAO;
+            command.indexType = arena->indexType;
+            command.material = &meshes[batch.firstMesh].material;
+            command.counts = whole ? batch.counts.data() : draws.counts.data();
+            command.offsets = whole ? batch.offsets.data() : draws.offsets.data();
+            command.baseVertices = whole ? batch.baseVertices.data() : draws.baseVertices.data();
+            command.drawCount = static_cast<GLsizei>(whole ? batch.counts.size() : draws.counts.size());
+            if(command.drawCount > 0)
+                queue.submit(RenderBucket::Opaque, 0, depth, command);
         }
-        // retrieve the directory path of the filepath
-        directory = path.substr(0, path.find_last_of('/'));
 
-        // process ASSIMP's root node recursively
-        processNode(scene->mRootNode, scene);
-        cout << "Model: loaded '" << path << "' with " << meshes.size() << " mesh(es)" << endl;
+        // the copies of shared geometry, their offsets all go into one buffer and each group reads its part.
+        // the instance offset is fed through ATTRIB_INSTANCE_OFFSET with a divisor of 1.
+        visibleOffsets.clear();
+        vector<std::pair<size_t, GLsizei>> ranges(instanceGroups.size());
+        for(unsigned int g = 0; g < instanceGroups.size(); g++)
+        {
+            const InstanceGroup &group = instanceGroups[g];
+            ranges[g].first = visibleOffsets.size();
+            for(unsigned int m = 0; m < group.meshIndices.size(); m++)
+            {
+                if(!frustum || meshVisible[group.meshIndices[m]])
+                    visibleOffsets.push_back(group.offsets[m]);
+            }
+            ranges[g].second = static_cast<GLsizei>(visibleOffsets.size() - ranges[g].first);
+        }
+        if(visibleOffsets.empty())
+            return;
+        glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+        glBufferData(GL_ARRAY_BUFFER, visibleOffsets.size() * sizeof(glm::vec3), visibleOffsets.data(), GL_STREAM_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        for(unsigned int g = 0; g < instanceGroups.size(); g++)
+        {
+            const InstanceGroup &group = instanceGroups[g];
+            if(ranges[g].second == 0)
+                continue;
+            command.type = DrawCommand::Type::ElementsInstanced;
+            command.VAO = group.geometry.VAO;
+            command.indexType = group.geometry.indexType;
+            command.material = &meshes[group.firstMesh].material;
+            command.indexOffset = group.geometry.indexOffset;
+            command.count = group.geometry.indexCount;
+            int level = std::min<int>(lod, static_cast<int>(group.geometry.lods.size()));
+            if(level > 0)
+            {
+                command.indexOffset = group.geometry.lods[level - 1].first;
+                command.count = group.geometry.lods[level - 1].second;
+            }
+            command.baseVertex = group.geometry.baseVertex;
+            command.instanceCount = ranges[g].second;
+            command.instanceBuffer = instanceVBO;
+            command.instanceOffset = ranges[g].first * sizeof(glm::vec3);
+            queue.submit(RenderBucket::Opaque, 0, depth, command);
+        }
     }
 
-    // processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
-    void processNode(aiNode *node, const aiScene *scene)
+    // box and bounding sphere around the union of the mesh bounds
+    void computeBounds()
     {
-        // process each mesh located at the current node
+        glm::vec3 min(INFINITY), max(-INFINITY);
+        meshBounds.resize(meshes.size());
+        for(unsigned int i = 0; i < meshes.size(); i++)
+        {
+            // an empty mesh gets an empty box, it draws nothing either way
+            meshBounds.set(i, meshes[i].boundsMin, meshes[i].vertexCount == 0 ? meshes[i].boundsMin : meshes[i].boundsMax);
+            if(meshes[i].vertexCount == 0)
+                continue;
+            min = glm::min(min, meshes[i].boundsMin);
+            max = glm::max(max, meshes[i].boundsMax);
+        }
+        if(min.x > max.x)
+            return;
+        boundsMin = min;
+        boundsMax = max;
+        boundsCenter = (min + max) * 0.5f;
+        boundsRadius = 0.0f;
+        for(unsigned int i = 0; i < meshes.size(); i++)
+            if(meshes[i].vertexCount > 0)
+                boundsRadius = glm::max(boundsRadius, glm::length(meshes[i].boundsCenter - boundsCenter) + meshes[i].boundsRadius);
+    }
+
+    // processes a node in a recursive fashion. Collects each individual mesh located at the node and repeats this process on its children nodes (if any).
+    void processNode(aiNode *node, const aiScene *scene, vector<aiMesh*> &sceneMeshes)
+    {
+        // collect each mesh located at the current node
         for(unsigned int i = 0; i < node->mNumMeshes; i++)
         {
             // the node object only contains indices to index the actual objects in the scene. 
             // the scene contains all the data, node is just to keep stuff organized (like relations between nodes).
-            aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-            meshes.push_back(processMesh(mesh, scene));
+            sceneMeshes.push_back(scene->mMeshes[node->mMeshes[i]]);
         }
         // after we've processed all of the meshes (if any) we then recursively process each of the children nodes
         for(unsigned int i = 0; i < node->mNumChildren; i++)
         {
-            processNode(node->mChildren[i], scene);
+            processNode(node->mChildren[i], scene, sceneMeshes);
         }
 
     }
 
-    Mesh processMesh(aiMesh *mesh, const aiScene *scene)
+    // processes the meshes in parallel, they are independent of each other. the results keep the node order.
+    void processMeshes(const vector<aiMesh*> &sceneMeshes)
+    {
+        vector<unique_ptr<Mesh>> results(sceneMeshes.size());
+        vector<MeshOptimizeStats> stats(sceneMeshes.size());
+        std::atomic<size_t> next(0);
+        auto work = [&]() {
+            for(size_t i = next++; i < sceneMeshes.size(); i = next++)
+                results[i].reset(new Mesh(processMesh(sceneMeshes[i], stats[i])));
+        };
+        unsigned int threadCount = importThreads ? importThreads : std::max(1u, std::thread::hardware_concurrency());
+        threadCount = std::min<unsigned int>(threadCount, static_cast<unsigned int>(sceneMeshes.size()));
+        vector<std::thread> threads;
+        for(unsigned int i = 1; i < threadCount; i++)
+            threads.emplace_back(work);
+        work();
+        for(std::thread &thread : threads)
+            thread.join();
+
+        for(size_t i = 0; i < results.size(); i++)
+        {
+            size_t triangles = results[i]->indices.size() / 3;
+            missesBefore += double(stats[i].acmrBefore) * triangles;
+            missesAfter += double(stats[i].acmrAfter) * triangles;
+            optimizedTriangles += triangles;
+            meshes.push_back(std::move(*results[i]));
+        }
+    }
+
+    Mesh processMesh(aiMesh *mesh, MeshOptimizeStats &stats)
     {
         // data to fill
         vector<Vertex> vertices;
         vector<unsigned int> indices;
-        vector<Texture> textures;
-
-        // walk through each of the mesh's vertices
-        for(unsigned int i = 0; i < mesh->mNumVertices; i++)
-        {
-            Vertex vertex;
-            glm::vec3 vector; // we declare a placeholder vector since assimp uses its own vector class that doesn't directly convert to glm's vec3 class so we transfer the data to this placeholder glm::vec3 first.
-            // positions
-            vector.x = mesh->mVertices[i].x;
-            vector.y = mesh->mVertices[i].y;
-            vector.z = mesh->mVertices[i].z;
-            vertex.Position = vector;
-            // normals
-            if (mesh->HasNormals())
-            {
-                vector.x = mesh->mNormals[i].x;
-                vector.y = mesh->mNormals[i].y;
-                vector.z = mesh->mNormals[i].z;
-                vertex.Normal = vector;
-            }
-            // texture coordinates
-            if(mesh->mTextureCoords[0]) // does the mesh contain texture coordinates?
+        importMeshData(mesh, vertices, indices);
+        // weld, then reorder triangles and vertices for the post transform cache, overdraw and vertex fetch,
+        // and split into meshlets for per cluster frustum and backface culling
+        vector<Meshlet> meshlets;
+        stats = optimizeMesh(vertices, indices, optimizeSettings, &meshlets);
+
+        // simplified levels of detail over the same vertices
+        vector<SimplifyResult> lodChain = generateLodChain(vertices, indices, lodSettings, optimizeSettings.cacheSize);
+
+        // return a mesh object created from the extracted mesh data, the upload happens once all meshes are
+        // known and can be packed into the model's arena. the material textures are attached by Upload
+        Mesh result(std::move(vertices), std::move(indices), vector<Texture>(), vertexLayout, false);
+        result.materialIndex = mesh->mMaterialIndex;
+        result.meshlets = std::move(meshlets);
+        for(unsigned int l = 0; l < lodChain.size(); l++)
+        {
+            MeshLod lod;
+            lod.indices = std::move(lodChain[l].indices);
+            lod.error = lodChain[l].error;
+            result.lods.push_back(std::move(lod));
+        }
+        return result;
+    }
+
+    // loads a texture by its path relative to the model, unless it was loaded before. textures is filled
+    // by a TextureStreamer already, except for the ones it left to a VirtualTexture.
+    Texture loadTexture(const string &path, const string &typeName, TextureCache &textures)
+    {
+        // check if texture was loaded before and if so, continue to next iteration: skip loading a new texture
+        for(unsigned int j = 0; j < textures_loaded.size(); j++)
+        {
+            if(textures_loaded[j].path == path)
+                return textures_loaded[j]; // a texture with the same filepath has already been loaded, continue to next one. (optimization)
+        }
+        string filename = this->directory + '/' + path;
+        // streamed in, possibly by another model of the scene
+        auto cached = textures.textures.find(filename);
+        if(cached != textures.textures.end())
+        {
+            Texture texture = cached->second;
+            texture.type = typeName;
+            texture.path = path;
+            textures_loaded.push_back(texture);
+            return texture;
+        }
+        // if texture hasn't been loaded already, load it
+        Texture texture;
+        texture.id = 0;
+        int width = 0, height = 0, nrComponents = 0;
+        AssetView packed;
+        bool known = readPackedAsset(filename, packed) ? stbi_info_from_memory(packed.data, int(packed.size), &width, &height, &nrComponents)
+                                                       : stbi_info(filename.c_str(), &width, &height, &nrComponents);
+        if(known && std::max(width, height) > maxTextureDimension)
+        {
+            // too big to decode and upload whole, stream it as tiles instead
+            string tileFile = filename + ".vt";
+            unique_ptr<VirtualTexture> vt(new VirtualTexture(tileFile));
+            if(vt->valid())
             {
-                glm::vec2 vec;
-                // a vertex can contain up to 8 different texture coordinates. We thus make the assumption that we won't 
-                // use models where a vertex can have multiple texture coordinates so we always take the first set (0).
-                vec.x = mesh->mTextureCoords[0][i].x; 
-                vec.y = mesh->mTextureCoords[0][i].y;
-                vertex.TexCoords = vec;
-                // tangent
-                vector.x = mesh->mTangents[i].x;
-                vector.y = mesh->mTangents[i].y;
-                vector.z = mesh->mTangents[i].z;
-                vertex.Tangent = vector;
-                // bitangent
-                vector.x = mesh->mBitangents[i].x;
-                vector.y = mesh->mBitangents[i].y;
-                vector.z = mesh->mBitangents[i].z;
-                vertex.Bitangent = vector;
+                texture.virtualTexture = vt.get();
+                virtualTextures.push_back(std::move(vt));
             }
             else
-                vertex.TexCoords = glm::vec2(0.0f, 0.0f);
-
-            vertices.push_back(vertex);
-        }
-        // now wak through each of the mesh's faces (a face is a mesh its triangle) and retrieve the corresponding vertex indices.
-        for(unsigned int i = 0; i < mesh->mNumFaces; i++)
-        {
-            aiFace face = mesh->mFaces[i];
-            // retrieve all indices of the face and store them in the indices vector
-            for(unsigned int j = 0; j < face.mNumIndices; j++)
-                indices.push_back(face.mIndices[j]);        
-        }
-        // process materials
-        aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];    
-        // we assume a convention for sampler names in the shaders. Each diffuse texture should be named
-        // as 'texture_diffuseN' where N is a sequential number ranging from 1 to MAX_SAMPLER_NUMBER. 
-        // Same applies to other texture as the following list summarizes:
-        // diffuse: texture_diffuseN
-        // specular: texture_specularN
-        // normal: texture_normalN
-
-        // 1. diffuse maps
-        vector<Texture> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
-        textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
-        // 2. specular maps
-        vector<Texture> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
-        textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
-        // 3. normal maps
-        std::vector<Texture> normalMaps = loadMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal");
-        textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
-        // 4. height maps
-        std::vector<Texture> heightMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height");
-        textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
-        
-        // return a mesh object created from the extracted mesh data
-        return Mesh(vertices, indices, textures);
-    }
-
-    // checks all material textures of a given type and loads the textures if they're not loaded yet.
-    // the required info is returned as a Texture struct.
-    vector<Texture> loadMaterialTextures(aiMaterial *mat, aiTextureType type, string typeName)
-    {
-        vector<Texture> textures;
-        for(unsigned int i = 0; i < mat->GetTextureCount(type); i++)
-        {
-            aiString str;
-            mat->GetTexture(type, i, &str);
-            // check if texture was loaded before and if so, continue to next iteration: skip loading a new texture
-            bool skip = false;
-            for(unsigned int j = 0; j < textures_loaded.size(); j++)
             {
-                if(std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0)
-                {
-                    textures.push_back(textures_loaded[j]);
-                    skip = true; // a texture with the same filepath has already been loaded, continue to next one. (optimization)
-                    break;
-                }
-            }
-            if(!skip)
-            {   // if texture hasn't been loaded already, load it
-                Texture texture;
-                texture.id = TextureFromFile(str.C_Str(), this->directory);
-                texture.type = typeName;
-                texture.path = str.C_Str();
-                textures.push_back(texture);
-                textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecessary load duplicate textures.
+                std::cout << "Model: '" << filename << "' is " << width << "x" << height << ", downscaling. Run TextureTiler on it to create '" << tileFile << "' and stream it at full resolution" << std::endl;
+                texture.id = TextureFromFile(path.c_str(), this->directory, maxTextureDimension);
             }
         }
-        return textures;
+        else
+            texture.id = TextureFromFile(path.c_str(), this->directory);
+        texture.type = typeName;
+        texture.path = path;
+        // virtual textures belong to the model, everything else can be shared
+        if(texture.virtualTexture == nullptr)
+            textures.textures[filename] = texture;
+        textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecessary load duplicate textures.
+        return texture;
     }
 };
 
 
-unsigned int TextureFromFile(const char *path, const string &directory, bool gamma)
+// the pixel format of an 8 bit image with that many channels, 0 for counts GL has none for
+GLenum TextureFormat(int channels)
 {
-    string filename = string(path);
-    filename = directory + '/' + filename;
-
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
+    switch(channels)
+    {
+    case 1: return GL_RED;
+    case 2: return GL_RG;
+    case 3: return GL_RGB;
+    case 4: return GL_RGBA;
+    default: return 0;
+    }
+}
 
-    int width, height, nrComponents;
-    // Debug: print which texture file we're attempting to load
-    std::cout << "TextureFromFile: trying '" << filename << "'" << std::endl;
+// DecodeTextureBands sink that uploads every band right away, for loading a single texture on the GL thread
+struct TextureUploadSink {
+    unsigned int textureID = 0;
+    uint32_t width = 0;
+    int channels = 0;
 
-    // Check file existence before attempting to load
-    std::ifstream fcheck(filename.c_str());
-    if(!fcheck.good()) {
-        std::cout << "TextureFromFile: file not found: '" << filename << "'" << std::endl;
+    bool begin(uint32_t width, uint32_t height, int channels)
+    {
+        this->width = width;
+        this->channels = channels;
+        textureID = BeginTextureUpload(width, height, channels);
+        return textureID != 0;
     }
-    unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-    if (data)
+
+    bool band(uint32_t y, uint32_t rows, vector<unsigned char> &pixels)
     {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
+        UploadTextureBand(textureID, y, width, rows, channels, pixels.data());
+        return true;
+    }
+};
 
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
+unsigned int TextureFromFile(const char *path, const string &directory, int maxDimension)
+{
+    string filename = string(path);
+    filename = directory + '/' + filename;
 
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    // a texture the AssetCooker compressed already uploads as is
+    AssetView cooked;
+    if(readAssetFile(filename + ".ctex", cooked))
+    {
+        unsigned int textureID;
+        glGenTextures(1, &textureID);
+        if(TextureFromCooked(cooked.data, cooked.size, filename, textureID))
+            return textureID;
+        GLState::current().forgetTexture(textureID);
+        glDeleteTextures(1, &textureID);
+    }
 
-        stbi_image_free(data);
+    // in the mounted asset pack it is in memory already and there is no file to open
+    AssetView packed;
+    TextureUploadSink sink;
+    if(DecodeTextureBands(filename, maxDimension, readPackedAsset(filename, packed) ? &packed : nullptr, sink))
+    {
+        EndTextureUpload(sink.textureID);
+        return sink.textureID;
     }
-    else
+    // whatever a failed decode uploaded never gets used
+    if(sink.textureID != 0)
     {
-        std::cout << "Texture failed to load at path: " << filename << " (stbi_load returned NULL)" << std::endl;
-        if(data) stbi_image_free(data);
+        GLState::current().forgetTexture(sink.textureID);
+        glDeleteTextures(1, &sink.textureID);
     }
+    return 0;
+}
 
+// allocates a texture for an 8 bit image to be uploaded band by band, 0 if GL has no format for its channels
+unsigned int BeginTextureUpload(uint32_t width, uint32_t height, int channels)
+{
+    GLenum format = TextureFormat(channels);
+    if(format == 0)
+        return 0;
+    unsigned int textureID;
+    glGenTextures(1, &textureID);
+    GLState::current().bindTextureForUpload(GL_TEXTURE_2D, textureID);
+    glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, NULL);
     return textureID;
 }
+
+// uploads rows [y, y + rows) of level 0, tightly packed
+void UploadTextureBand(unsigned int textureID, uint32_t y, uint32_t width, uint32_t rows, int channels, const unsigned char *pixels)
+{
+    GLenum format = TextureFormat(channels);
+    GLState::current().bindTextureForUpload(GL_TEXTURE_2D, textureID);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, y, width, rows, format, GL_UNSIGNED_BYTE, pixels);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
+
+// generates the mipmaps once every band is in and sets the sampling state
+void EndTextureUpload(unsigned int textureID)
+{
+    GLState::current().bindTextureForUpload(GL_TEXTURE_2D, textureID);
+    glGenerateMipmap(GL_TEXTURE_2D);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+}
+
+// cooked textures are BC1/BC3, which every desktop GL driver has but core profile doesn't guarantee,
+// so it is checked once
+bool HasS3TC()
+{
+    static int s3tc = -1;
+    if(s3tc < 0)
+    {
+        s3tc = 0;
+        GLint count = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+        for(GLint i = 0; i < count && !s3tc; i++)
+            s3tc = std::strcmp(reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i)), "GL_EXT_texture_compression_s3tc") == 0;
+    }
+    return s3tc != 0;
+}
+
+// uploads a cooked BC1/BC3 texture with its mip chain (see cooked_asset.h)
+bool TextureFromCooked(const unsigned char *data, size_t size, const string &filename, unsigned int textureID)
+{
+    CookedReader reader(data, size);
+    CookedTextureHeader header;
+    if(!HasS3TC() || !reader.read(&header, sizeof(header)) || header.magic != COOKED_TEXTURE_MAGIC || header.version != COOKED_TEXTURE_VERSION)
+        return false;
+
+    const GLenum COMPRESSED_RGB_S3TC_DXT1 = 0x83F0, COMPRESSED_RGBA_S3TC_DXT5 = 0x83F3;
+    GLenum format = header.format == COOKED_BC3 ? COMPRESSED_RGBA_S3TC_DXT5 : COMPRESSED_RGB_S3TC_DXT1;
+    GLState::current().bindTextureForUpload(GL_TEXTURE_2D, textureID);
+    for(uint32_t level = 0; level < header.levels; level++)
+    {
+        uint32_t bytes;
+        if(!reader.readU32(bytes) || !reader.skip(bytes))
+        {
+            std::cout << "Texture failed to load at path: " << filename << ".ctex (truncated)" << std::endl;
+            return false;
+        }
+        glCompressedTexImage2D(GL_TEXTURE_2D, level, format, std::max(1u, header.width >> level), std::max(1u, header.height >> level), 0,
+                               bytes, reader.current() - bytes);
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    return true;
+}
 #endif
\ No newline at end of file
@@ -0,0 +1,352 @@
+#ifndef OCCLUSION_CULLER_H
+#define OCCLUSION_CULLER_H
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define OCCLUSION_CULLER_SSE2
+#endif
+
+#include <glm/glm.hpp>
+
+#include <mesh.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// software occlusion culling, entirely on the CPU so it needs no GPU readback:
+//   1. begin() with the frame's projection * view, addMesh() the candidate occluders
+//   2. rasterize() draws the largest of them (by projected size, up to triangleBudget) into a small depth
+//      buffer. the buffer is split into tiles, the triangles are binned per tile and worker threads take
+//      the tiles one at a time, four pixels per SSE2 step
+//   3. a hierarchical Z pyramid is built from it, each texel the farthest depth of the four below
+//   4. visible() tests a box against the pyramid level where it covers about 2x2 texels: the box is
+//      hidden when its nearest point is behind the farthest occluder depth everywhere it covers
+// depth is NDC depth mapped to [0, 1]. anything the culler can't decide (boxes crossing the near plane,
+// boxes off screen) counts as visible.
+class OcclusionCuller {
+public:
+    static const int TILE_WIDTH = 64, TILE_HEIGHT = 32;
+
+    size_t triangleBudget = 30000; // occluder triangles rasterized per frame
+    // of the last frame
+    size_t occluderTriangles = 0;
+    mutable std::atomic<unsigned int> tested{0}, occluded{0};
+
+    OcclusionCuller(int width = 256, int height = 128, unsigned int threadCount = 0)
+        : width(width), height(height)
+    {
+        tilesX = (width + TILE_WIDTH - 1) / TILE_WIDTH;
+        tilesY = (height + TILE_HEIGHT - 1) / TILE_HEIGHT;
+        bins.resize(size_t(tilesX) * tilesY);
+        // the pyramid, level 0 is the depth buffer itself
+        for(int w = width, h = height; ; w = std::max(1, (w + 1) / 2), h = std::max(1, (h + 1) / 2))
+        {
+            levels.push_back(Level{ w, h, std::vector<float>(size_t(w) * h, 1.0f) });
+            if(w == 1 && h == 1)
+                break;
+        }
+        // the calling thread rasterizes as well
+        if(threadCount == 0)
+            threadCount = std::min(std::max(1u, std::thread::hardware_concurrency()), 8u) - 1;
+        for(unsigned int i = 0; i < threadCount; i++)
+            workers.push_back(std::thread(&OcclusionCuller::work, this));
+    }
+    ~OcclusionCuller()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
+        }
+        wake.notify_all();
+        for(std::thread &worker : workers)
+            worker.join();
+    }
+    OcclusionCuller(const OcclusionCuller&) = delete;
+    OcclusionCuller &operator=(const OcclusionCuller&) = delete;
+
+    void begin(const glm::mat4 &viewProjection)
+    {
+        this->viewProjection = viewProjection;
+        candidates.clear();
+        tested = 0;
+        occluded = 0;
+    }
+
+    // offers the mesh, drawn with the given model matrix, as an occluder. needs its positions and
+    // indices in system memory (any residency but BoundsOnly), others are ignored
+    void addMesh(const Mesh &mesh, const glm::mat4 &model)
+    {
+        if(mesh.indices.empty() || (mesh.positions.empty() && mesh.vertices.empty()))
+            return;
+        glm::vec4 center = viewProjection * model * glm::vec4(mesh.boundsCenter, 1.0f);
+        float scale = glm::max(glm::length(glm::vec3(model[0])), glm::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+        // how much of the view the mesh's sphere spans, roughly
+        float size = mesh.boundsRadius * scale / std::max(center.w, 1e-3f);
+        candidates.push_back(Candidate{ &mesh, model, size });
+    }
+
+    void rasterize()
+    {
+        std::sort(candidates.begin(), candidates.end(), [](const Candidate &a, const Candidate &b) { return a.size > b.size; });
+        triangles.clear();
+        occluderTriangles = 0;
+        for(const Candidate &candidate : candidates)
+        {
+            if(occluderTriangles + candidate.mesh->indices.size() / 3 > triangleBudget && occluderTriangles > 0)
+                break;
+            addTriangles(*candidate.mesh, candidate.model);
+            occluderTriangles += candidate.mesh->indices.size() / 3;
+        }
+        for(std::vector<uint32_t> &bin : bins)
+            bin.clear();
+        for(uint32_t t = 0; t < triangles.size(); t++)
+        {
+            const Triangle &triangle = triangles[t];
+            int x0 = std::max(0, int(std::floor(triangle.minX)) / TILE_WIDTH), x1 = std::min(tilesX - 1, int(std::ceil(triangle.maxX)) / TILE_WIDTH);
+            int y0 = std::max(0, int(std::floor(triangle.minY)) / TILE_HEIGHT), y1 = std::min(tilesY - 1, int(std::ceil(triangle.maxY)) / TILE_HEIGHT);
+            for(int y = y0; y <= y1; y++)
+                for(int x = x0; x <= x1; x++)
+                    bins[size_t(y) * tilesX + x].push_back(t);
+        }
+
+        // every thread takes tiles until none are left
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            nextTile = 0;
+            busy = static_cast<unsigned int>(workers.size());
+            generation++;
+        }
+        wake.notify_all();
+        rasterizeTiles();
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            done.wait(lock, [this]() { return busy == 0; });
+        }
+        buildPyramid();
+    }
+
+    // whether the box (object space, placed by model) may be visible
+    bool visible(const glm::vec3 &min, const glm::vec3 &max, const glm::mat4 &model = glm::mat4(1.0f)) const
+    {
+        tested++;
+        glm::mat4 clip = viewProjection * model;
+        float minX = INFINITY, minY = INFINITY, maxX = -INFINITY, maxY = -INFINITY, nearest = INFINITY;
+        for(int corner = 0; corner < 8; corner++)
+        {
+            glm::vec4 p = clip * glm::vec4(corner & 1 ? max.x : min.x, corner & 2 ? max.y : min.y, corner & 4 ? max.z : min.z, 1.0f);
+            if(p.w <= 1e-5f || p.z < -p.w)
+                return true; // crosses the near plane
+            float x = (p.x / p.w * 0.5f + 0.5f) * width, y = (p.y / p.w * 0.5f + 0.5f) * height;
+            minX = std::min(minX, x);
+            maxX = std::max(maxX, x);
+            minY = std::min(minY, y);
+            maxY = std::max(maxY, y);
+            nearest = std::min(nearest, p.z / p.w * 0.5f + 0.5f);
+        }
+        int x0 = std::max(0, int(std::floor(minX))), x1 = std::min(width - 1, int(std::floor(maxX)));
+        int y0 = std::max(0, int(std::floor(minY))), y1 = std::min(height - 1, int(std::floor(maxY)));
+        if(x0 > x1 || y0 > y1)
+            return true; // off screen, the frustum is the judge of that
+        // the level where the rectangle spans at most 2 texels each way, so at most 3x3 are read
+        int span = std::max(x1 - x0, y1 - y0) + 1;
+        int level = 0;
+        while(span > 2 && level + 1 < int(levels.size()))
+        {
+            span = (span + 1) / 2;
+            level++;
+        }
+        const Level &pyramid = levels[level];
+        x0 >>= level;
+        x1 >>= level;
+        y0 >>= level;
+        y1 >>= level;
+        float farthest = 0.0f;
+        for(int y = y0; y <= y1; y++)
+            for(int x = x0; x <= x1; x++)
+                farthest = std::max(farthest, pyramid.depth[size_t(y) * pyramid.width + x]);
+        if(nearest <= farthest)
+            return true;
+        occluded++;
+        return false;
+    }
+
+private:
+    struct Candidate {
+        const Mesh *mesh;
+        glm::mat4 model;
+        float size;
+    };
+    // in pixels, depth in [0, 1]
+    struct Triangle {
+        glm::vec3 v[3];
+        float minX, minY, maxX, maxY;
+    };
+    struct Level {
+        int width, height;
+        std::vector<float> depth;
+    };
+
+    int width, height;
+    int tilesX, tilesY;
+    glm::mat4 viewProjection = glm::mat4(1.0f);
+    std::vector<Candidate> candidates;
+    std::vector<Triangle> triangles;
+    std::vector<std::vector<uint32_t>> bins; // triangle indices per tile
+    std::vector<Level> levels;
+    std::vector<glm::vec4> clipPositions;
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake, done;
+    std::atomic<size_t> nextTile{0};
+    unsigned int busy = 0;       // workers still on the current frame
+    unsigned int generation = 0; // frames handed to the workers so far
+    bool stop = false;
+
+    void work()
+    {
+        unsigned int seen = 0;
+        for(;;)
+        {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [&]() { return stop || generation != seen; });
+                if(stop)
+                    return;
+                seen = generation;
+            }
+            rasterizeTiles();
+            std::lock_guard<std::mutex> lock(mutex);
+            if(--busy == 0)
+                done.notify_one();
+        }
+    }
+
+    // transforms the mesh to screen space and keeps its triangles that are entirely in front of the near
+    // plane. leaving out the others only makes the occluder smaller, never wrong
+    void addTriangles(const Mesh &mesh, const glm::mat4 &model)
+    {
+        glm::mat4 clip = viewProjection * model;
+        size_t vertexCount = mesh.positions.empty() ? mesh.vertices.size() : mesh.positions.size();
+        clipPositions.resize(vertexCount);
+        for(size_t i = 0; i < vertexCount; i++)
+            clipPositions[i] = clip * glm::vec4(mesh.positions.empty() ? mesh.vertices[i].Position : mesh.positions[i], 1.0f);
+        for(size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+        {
+            Triangle triangle;
+            bool inFront = true;
+            for(int k = 0; k < 3 && inFront; k++)
+            {
+                const glm::vec4 &p = clipPositions[mesh.indices[i + k]];
+                inFront = p.w > 1e-5f && p.z >= -p.w;
+                triangle.v[k] = glm::vec3((p.x / p.w * 0.5f + 0.5f) * width, (p.y / p.w * 0.5f + 0.5f) * height, p.z / p.w * 0.5f + 0.5f);
+            }
+            if(!inFront)
+                continue;
+            triangle.minX = std::min(triangle.v[0].x, std::min(triangle.v[1].x, triangle.v[2].x));
+            triangle.maxX = std::max(triangle.v[0].x, std::max(triangle.v[1].x, triangle.v[2].x));
+            triangle.minY = std::min(triangle.v[0].y, std::min(triangle.v[1].y, triangle.v[2].y));
+            triangle.maxY = std::max(triangle.v[0].y, std::max(triangle.v[1].y, triangle.v[2].y));
+            if(triangle.maxX < 0.0f || triangle.maxY < 0.0f || triangle.minX >= width || triangle.minY >= height)
+                continue;
+            triangles.push_back(triangle);
+        }
+    }
+
+    void rasterizeTiles()
+    {
+        for(size_t tile = nextTile++; tile < bins.size(); tile = nextTile++)
+            rasterizeTile(tile);
+    }
+
+    // clears the tile and draws its triangles, keeping the nearest depth. pixels are sampled at their centers
+    void rasterizeTile(size_t tile)
+    {
+        const int tileX0 = int(tile % tilesX) * TILE_WIDTH, tileY0 = int(tile / tilesX) * TILE_HEIGHT;
+        const int tileX1 = std::min(tileX0 + TILE_WIDTH, width), tileY1 = std::min(tileY0 + TILE_HEIGHT, height);
+        std::vector<float> &depth = levels[0].depth;
+        for(int y = tileY0; y < tileY1; y++)
+            std::fill(depth.begin() + size_t(y) * width + tileX0, depth.begin() + size_t(y) * width + tileX1, 1.0f);
+
+        for(uint32_t t : bins[tile])
+        {
+            const Triangle &triangle = triangles[t];
+            glm::vec3 a = triangle.v[0], b = triangle.v[1], c = triangle.v[2];
+            float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+            if(std::fabs(area) < 1e-8f)
+                continue;
+            // both windings are drawn, counter clockwise edges are made to be positive inside
+            if(area < 0.0f)
+            {
+                std::swap(b, c);
+                area = -area;
+            }
+            // edge functions e = A x + B y + C, and depth as a plane z = zA x + zB y + zC
+            float edgeA[3] = { a.y - b.y, b.y - c.y, c.y - a.y };
+            float edgeB[3] = { b.x - a.x, c.x - b.x, a.x - c.x };
+            float edgeC[3] = { a.x * b.y - a.y * b.x, b.x * c.y - b.y * c.x, c.x * a.y - c.y * a.x };
+            float zA = ((b.z - a.z) * (c.y - a.y) - (c.z - a.z) * (b.y - a.y)) / area;
+            float zB = ((c.z - a.z) * (b.x - a.x) - (b.z - a.z) * (c.x - a.x)) / area;
+            float zC = a.z - zA * a.x - zB * a.y;
+
+            int x0 = std::max(tileX0, int(std::floor(triangle.minX))), x1 = std::min(tileX1 - 1, int(std::ceil(triangle.maxX)));
+            int y0 = std::max(tileY0, int(std::floor(triangle.minY))), y1 = std::min(tileY1 - 1, int(std::ceil(triangle.maxY)));
+            for(int y = y0; y <= y1; y++)
+            {
+                float py = float(y) + 0.5f;
+                float *row = &depth[size_t(y) * width];
+                int x = x0;
+#ifdef OCCLUSION_CULLER_SSE2
+                const __m128 steps = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+                for(; x + 3 <= x1; x += 4)
+                {
+                    __m128 px = _mm_add_ps(_mm_set1_ps(float(x)), steps);
+                    __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+                    for(int e = 0; e < 3; e++)
+                    {
+                        __m128 value = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(edgeA[e]), px), _mm_set1_ps(edgeB[e] * py + edgeC[e]));
+                        inside = _mm_and_ps(inside, _mm_cmpge_ps(value, _mm_setzero_ps()));
+                    }
+                    __m128 z = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(zA), px), _mm_set1_ps(zB * py + zC));
+                    __m128 current = _mm_loadu_ps(row + x);
+                    __m128 nearer = _mm_min_ps(current, z);
+                    _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, current)));
+                }
+#endif
+                for(; x <= x1; x++)
+                {
+                    float px = float(x) + 0.5f;
+                    bool inside = true;
+                    for(int e = 0; e < 3; e++)
+                        inside &= edgeA[e] * px + edgeB[e] * py + edgeC[e] >= 0.0f;
+                    if(inside)
+                        row[x] = std::min(row[x], zA * px + zB * py + zC);
+                }
+            }
+        }
+    }
+
+    void buildPyramid()
+    {
+        for(size_t l = 1; l < levels.size(); l++)
+        {
+            const Level &below = levels[l - 1];
+            Level &level = levels[l];
+            for(int y = 0; y < level.height; y++)
+                for(int x = 0; x < level.width; x++)
+                {
+                    int x0 = std::min(2 * x, below.width - 1), x1 = std::min(2 * x + 1, below.width - 1);
+                    int y0 = std::min(2 * y, below.height - 1), y1 = std::min(2 * y + 1, below.height - 1);
+                    level.depth[size_t(y) * level.width + x] = std::max(std::max(below.depth[size_t(y0) * below.width + x0], below.depth[size_t(y0) * below.width + x1]),
+                                                                        std::max(below.depth[size_t(y1) * below.width + x0], below.depth[size_t(y1) * below.width + x1]));
+                }
+        }
+    }
+};
+#endif
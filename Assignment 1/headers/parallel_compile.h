@@ -0,0 +1,50 @@
+#ifndef PARALLEL_COMPILE_H
+#define PARALLEL_COMPILE_H
+
+#include <glad/glad.h>
+
+#include <cstring>
+
+// GL_KHR_parallel_shader_compile (or the ARB version, same enum): the driver compiles and links on its own
+// threads, and GL_COMPLETION_STATUS_KHR asks whether a shader or program is done without waiting for it.
+// glad isn't generated with it, so it is loaded here. without it Shader still defers its status queries
+// (see ShaderBuild::Async), drivers that compile in the background get to overlap the builds either way.
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+typedef void (APIENTRYP PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)(GLuint count);
+
+struct ParallelShaderCompile {
+    bool supported = false;
+    PFNGLMAXSHADERCOMPILERTHREADSKHRPROC maxShaderCompilerThreads = nullptr;
+
+    static ParallelShaderCompile &get()
+    {
+        static ParallelShaderCompile extension;
+        return extension;
+    }
+
+    // call once after gladLoadGLLoader with the same loader. lets the driver use as many threads as it likes
+    bool load(GLADloadproc loader)
+    {
+        supported = false;
+        GLint count = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+        for(GLint i = 0; i < count && !supported; i++)
+        {
+            const char *name = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, GLuint(i)));
+            if(!name)
+                continue;
+            if(std::strcmp(name, "GL_KHR_parallel_shader_compile") == 0)
+                maxShaderCompilerThreads = reinterpret_cast<PFNGLMAXSHADERCOMPILERTHREADSKHRPROC>(loader("glMaxShaderCompilerThreadsKHR"));
+            else if(std::strcmp(name, "GL_ARB_parallel_shader_compile") == 0)
+                maxShaderCompilerThreads = reinterpret_cast<PFNGLMAXSHADERCOMPILERTHREADSKHRPROC>(loader("glMaxShaderCompilerThreadsARB"));
+            supported = maxShaderCompilerThreads != nullptr;
+        }
+        if(supported)
+            maxShaderCompilerThreads(0xFFFFFFFFu);
+        return supported;
+    }
+};
+#endif
@@ -0,0 +1,339 @@
+#ifndef PNG_STREAM_H
+#define PNG_STREAM_H
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// decodes a PNG one row at a time, from a file or from memory. only the compressed input buffer, the inflate
+// window and two scanlines are ever held in memory, unlike stbi_load which needs the whole decoded image at once.
+//
+// rows come out as 8 bit samples: grey -> 1 channel, rgb and palette -> 3 channels, anything with alpha
+// (including a palette with tRNS) -> 4 channels. interlaced images aren't supported, open() fails on them
+// so the caller can fall back to stb_image.
+class PngStreamDecoder {
+public:
+    uint32_t width = 0, height = 0;
+    int bitDepth = 0, colorType = 0;
+    int channels = 0; // of the rows returned by readRow
+
+    PngStreamDecoder() { std::memset(&stream, 0, sizeof(stream)); }
+    ~PngStreamDecoder() { close(); }
+    PngStreamDecoder(const PngStreamDecoder&) = delete;
+    PngStreamDecoder &operator=(const PngStreamDecoder&) = delete;
+
+    // reads the header chunks up to the first IDAT. false if the file isn't a PNG this decoder handles.
+    bool open(const std::string &path)
+    {
+        file = std::fopen(path.c_str(), "rb");
+        if(!file)
+            return false;
+        return readHeader();
+    }
+
+    // same, for a PNG that is already in memory (e.g. in an asset pack). data has to outlive the decoder.
+    bool open(const unsigned char *data, size_t size)
+    {
+        memory = data;
+        memorySize = size;
+        memoryPosition = 0;
+        return readHeader();
+    }
+
+    // decodes the next row into dst (width * channels bytes)
+    bool readRow(unsigned char *dst)
+    {
+        if(!inflating || row >= height)
+            return false;
+        stream.next_out = scanline.data();
+        stream.avail_out = static_cast<uInt>(scanline.size());
+        while(stream.avail_out > 0)
+        {
+            if(stream.avail_in == 0 && !refill())
+                return fail("truncated image data");
+            int result = inflate(&stream, Z_NO_FLUSH);
+            if(result == Z_STREAM_END && stream.avail_out > 0)
+                return fail("image data ends early");
+            if(result != Z_OK && result != Z_STREAM_END)
+                return fail("corrupt image data");
+        }
+        if(!unfilter())
+            return fail("bad filter type");
+        expand(dst);
+        row++;
+        return true;
+    }
+
+    void close()
+    {
+        if(inflating)
+            inflateEnd(&stream);
+        inflating = false;
+        if(file)
+            std::fclose(file);
+        file = nullptr;
+        memory = nullptr;
+    }
+
+private:
+    FILE *file = nullptr;
+    const unsigned char *memory = nullptr;
+    size_t memorySize = 0, memoryPosition = 0;
+    z_stream stream;
+    bool inflating = false;
+    uint32_t remaining = 0; // bytes left in the current IDAT chunk
+    uint32_t row = 0;
+    size_t rowBytes = 0, pixelBytes = 0;
+    std::vector<unsigned char> input;
+    std::vector<unsigned char> scanline; // filter byte + filtered row
+    std::vector<unsigned char> previous; // previous row, unfiltered
+    std::vector<unsigned char> palette;  // RGBA
+
+    bool readHeader()
+    {
+        static const unsigned char signature[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+        unsigned char header[8];
+        if(readBytes(header, 8) != 8 || std::memcmp(header, signature, 8) != 0)
+            return fail(nullptr);
+
+        bool haveHeader = false;
+        int interlace = 0;
+        bool hasTransparency = false;
+        while(true)
+        {
+            uint32_t length;
+            char type[4];
+            if(!readChunkHeader(length, type))
+                return fail("truncated file");
+            if(std::memcmp(type, "IHDR", 4) == 0)
+            {
+                unsigned char ihdr[13];
+                if(length != 13 || readBytes(ihdr, 13) != 13)
+                    return fail("bad IHDR");
+                width = readBigEndian(ihdr);
+                height = readBigEndian(ihdr + 4);
+                bitDepth = ihdr[8];
+                colorType = ihdr[9];
+                interlace = ihdr[12];
+                haveHeader = true;
+                skip(4);
+            }
+            else if(std::memcmp(type, "PLTE", 4) == 0)
+            {
+                palette.assign(256 * 4, 255);
+                for(uint32_t i = 0; i < length / 3 && i < 256; i++)
+                {
+                    unsigned char rgb[3];
+                    if(readBytes(rgb, 3) != 3)
+                        return fail("bad PLTE");
+                    std::memcpy(&palette[i * 4], rgb, 3);
+                }
+                skip(length - std::min<uint32_t>(length / 3, 256) * 3 + 4);
+            }
+            else if(std::memcmp(type, "tRNS", 4) == 0 && colorType == 3 && !palette.empty())
+            {
+                for(uint32_t i = 0; i < length && i < 256; i++)
+                {
+                    if(readBytes(&palette[i * 4 + 3], 1) != 1)
+                        return fail("bad tRNS");
+                }
+                hasTransparency = true;
+                skip(length - std::min<uint32_t>(length, 256) + 4);
+            }
+            else if(std::memcmp(type, "IDAT", 4) == 0)
+            {
+                remaining = length;
+                break;
+            }
+            else if(std::memcmp(type, "IEND", 4) == 0)
+                return fail("no image data");
+            else
+                skip(length + 4);
+        }
+
+        if(!haveHeader || width == 0 || height == 0)
+            return fail("missing IHDR");
+        if(interlace != 0)
+            return fail("interlaced images are not streamed");
+        int samples;
+        switch(colorType)
+        {
+            case 0: samples = 1; channels = 1; break;
+            case 2: samples = 3; channels = 3; break;
+            case 3: samples = 1; channels = hasTransparency ? 4 : 3; break;
+            case 4: samples = 2; channels = 4; break;
+            case 6: samples = 4; channels = 4; break;
+            default: return fail("unknown color type");
+        }
+        if((colorType == 3 && palette.empty()) || (bitDepth != 1 && bitDepth != 2 && bitDepth != 4 && bitDepth != 8 && bitDepth != 16))
+            return fail("unsupported bit depth or missing palette");
+
+        rowBytes = (size_t(width) * samples * bitDepth + 7) / 8;
+        pixelBytes = std::max<size_t>(1, size_t(samples) * bitDepth / 8);
+        scanline.assign(rowBytes + 1, 0);
+        previous.assign(rowBytes, 0);
+        if(file)
+            input.resize(64 * 1024);
+        if(inflateInit(&stream) != Z_OK)
+            return fail("inflateInit failed");
+        inflating = true;
+        return true;
+    }
+
+    static uint32_t readBigEndian(const unsigned char *p)
+    {
+        return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+    }
+
+    bool readChunkHeader(uint32_t &length, char type[4])
+    {
+        unsigned char header[8];
+        if(readBytes(header, 8) != 8)
+            return false;
+        length = readBigEndian(header);
+        std::memcpy(type, header + 4, 4);
+        return true;
+    }
+
+    size_t readBytes(void *dst, size_t bytes)
+    {
+        if(file)
+            return std::fread(dst, 1, bytes, file);
+        bytes = std::min(bytes, memorySize - memoryPosition);
+        std::memcpy(dst, memory + memoryPosition, bytes);
+        memoryPosition += bytes;
+        return bytes;
+    }
+
+    void skip(uint32_t bytes)
+    {
+        if(file)
+            std::fseek(file, long(bytes), SEEK_CUR);
+        else
+            memoryPosition = std::min(memoryPosition + bytes, memorySize);
+    }
+
+    bool fail(const char *reason)
+    {
+        if(reason)
+            std::cout << "ERROR::PNG_STREAM::" << reason << std::endl;
+        close();
+        return false;
+    }
+
+    // feeds the next piece of compressed data to inflate, moving on to the next IDAT chunk if needed
+    bool refill()
+    {
+        while(remaining == 0)
+        {
+            skip(4); // crc of the chunk we're done with
+            uint32_t length;
+            char type[4];
+            if(!readChunkHeader(length, type) || std::memcmp(type, "IDAT", 4) != 0)
+                return false;
+            remaining = length;
+        }
+        size_t bytes;
+        if(memory)
+        {
+            // inflate straight from the mapped data, no copy
+            bytes = std::min<size_t>(remaining, memorySize - memoryPosition);
+            stream.next_in = const_cast<unsigned char*>(memory + memoryPosition);
+            memoryPosition += bytes;
+            remaining -= static_cast<uint32_t>(bytes);
+            stream.avail_in = static_cast<uInt>(bytes);
+            return bytes > 0;
+        }
+        bytes = std::fread(input.data(), 1, std::min<size_t>(remaining, input.size()), file);
+        if(bytes == 0)
+            return false;
+        remaining -= static_cast<uint32_t>(bytes);
+        stream.next_in = input.data();
+        stream.avail_in = static_cast<uInt>(bytes);
+        return true;
+    }
+
+    static unsigned char paeth(int a, int b, int c)
+    {
+        int p = a + b - c;
+        int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+        if(pa <= pb && pa <= pc)
+            return static_cast<unsigned char>(a);
+        return static_cast<unsigned char>(pb <= pc ? b : c);
+    }
+
+    // undoes the row filter in place, the result ends up in previous
+    bool unfilter()
+    {
+        unsigned char *cur = scanline.data() + 1;
+        const unsigned char *up = previous.data();
+        const size_t bpp = pixelBytes;
+        switch(scanline[0])
+        {
+            case 0:
+                break;
+            case 1:
+                for(size_t i = bpp; i < rowBytes; i++)
+                    cur[i] = static_cast<unsigned char>(cur[i] + cur[i - bpp]);
+                break;
+            case 2:
+                for(size_t i = 0; i < rowBytes; i++)
+                    cur[i] = static_cast<unsigned char>(cur[i] + up[i]);
+                break;
+            case 3:
+                for(size_t i = 0; i < rowBytes; i++)
+                    cur[i] = static_cast<unsigned char>(cur[i] + ((i >= bpp ? cur[i - bpp] : 0) + up[i]) / 2);
+                break;
+            case 4:
+                for(size_t i = 0; i < rowBytes; i++)
+                    cur[i] = static_cast<unsigned char>(cur[i] + paeth(i >= bpp ? cur[i - bpp] : 0, up[i], i >= bpp ? up[i - bpp] : 0));
+                break;
+            default:
+                return false;
+        }
+        std::memcpy(previous.data(), cur, rowBytes);
+        return true;
+    }
+
+    // unfiltered row -> 8 bit samples in the output channel layout
+    void expand(unsigned char *dst) const
+    {
+        const unsigned char *src = previous.data();
+        if(bitDepth < 8)
+        {
+            const int mask = (1 << bitDepth) - 1;
+            const int scale = colorType == 0 ? 255 / mask : 1; // grey levels are stretched, palette indices are not
+            for(uint32_t x = 0; x < width; x++)
+            {
+                size_t bit = size_t(x) * bitDepth;
+                int value = (src[bit / 8] >> (8 - bitDepth - int(bit % 8))) & mask;
+                if(colorType == 3)
+                    std::memcpy(dst + size_t(x) * channels, &palette[value * 4], channels);
+                else
+                    dst[x] = static_cast<unsigned char>(value * scale);
+            }
+            return;
+        }
+        const size_t step = bitDepth / 8; // 16 bit samples keep their high byte
+        for(uint32_t x = 0; x < width; x++)
+        {
+            unsigned char *out = dst + size_t(x) * channels;
+            switch(colorType)
+            {
+                case 0: out[0] = src[x * step]; break;
+                case 2: for(int c = 0; c < 3; c++) out[c] = src[(size_t(x) * 3 + c) * step]; break;
+                case 3: std::memcpy(out, &palette[src[x] * 4], channels); break;
+                case 4: out[0] = out[1] = out[2] = src[size_t(x) * 2 * step]; out[3] = src[(size_t(x) * 2 + 1) * step]; break;
+                case 6: for(int c = 0; c < 4; c++) out[c] = src[(size_t(x) * 4 + c) * step]; break;
+            }
+        }
+    }
+};
+#endif
@@ -0,0 +1,205 @@
+#ifndef PROGRAM_CACHE_H
+#define PROGRAM_CACHE_H
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// linked programs as the driver's own binaries (glGetProgramBinary), so a start after the first one loads
+// them instead of compiling and linking the GLSL again. a binary is looked up by a key over the driver's
+// vendor, renderer and version strings and every stage's type and source, so an edited shader or a driver
+// update just misses and compiles. loading is checked three times: the file header (magic, version, key),
+// a hash of the binary, and the driver's GL_LINK_STATUS after glProgramBinary, which drivers fail for
+// binaries they no longer accept. whatever fails falls back to compiling.
+//
+// <directory>/<key as 16 hex digits>.pbin:
+//   ProgramBinaryHeader, then length bytes of binary in the driver's format
+
+#define PROGRAM_BINARY_MAGIC   0x4E494250u // "PBIN"
+#define PROGRAM_BINARY_VERSION 1u
+
+struct ProgramBinaryHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t format; // as returned by glGetProgramBinary
+    uint32_t length;
+    uint64_t key;
+    uint64_t binaryHash;
+};
+
+// a stage of the program being built, its type and source are part of the key
+struct ProgramStageSource {
+    GLenum type;
+    const std::string *source;
+};
+
+// 64 bit FNV-1a
+inline uint64_t hashProgramBytes(const void *data, size_t size, uint64_t hash = 14695981039346656037ull)
+{
+    const unsigned char *bytes = static_cast<const unsigned char*>(data);
+    for(size_t i = 0; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+class ProgramCache {
+public:
+    std::string directory = "shader_cache";
+    bool enabled = true;
+    // of this run
+    unsigned int hits = 0, misses = 0;
+
+    static ProgramCache &get()
+    {
+        static ProgramCache cache;
+        return cache;
+    }
+
+    uint64_t key(const std::vector<ProgramStageSource> &stages)
+    {
+        uint64_t hash = driverHash();
+        for(const ProgramStageSource &stage : stages)
+        {
+            uint32_t type = stage.type;
+            uint64_t size = stage.source->size();
+            hash = hashProgramBytes(&type, sizeof(type), hash);
+            hash = hashProgramBytes(&size, sizeof(size), hash);
+            hash = hashProgramBytes(stage.source->data(), stage.source->size(), hash);
+        }
+        return hash;
+    }
+
+    // whether binaries can be used at all: the cache is enabled and the driver offers a binary format
+    bool usable()
+    {
+        if(supported < 0)
+        {
+            GLint formats = 0;
+            glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+            supported = formats > 0 ? 1 : 0;
+        }
+        return enabled && supported == 1;
+    }
+
+    // loads the binary stored under key into program, which has to be created but not linked. false if
+    // there is none or it doesn't check out, the program is unlinked then and can be built from source
+    bool load(GLuint program, uint64_t key)
+    {
+        if(!usable())
+            return false;
+        std::ifstream in(path(key).c_str(), std::ios::binary);
+        if(!in.good())
+        {
+            misses++;
+            return false;
+        }
+        ProgramBinaryHeader header;
+        std::vector<char> binary;
+        bool valid = bool(in.read(reinterpret_cast<char*>(&header), sizeof(header))) && header.magic == PROGRAM_BINARY_MAGIC &&
+                     header.version == PROGRAM_BINARY_VERSION && header.key == key && header.length > 0;
+        if(valid)
+        {
+            binary.resize(header.length);
+            valid = bool(in.read(binary.data(), std::streamsize(binary.size()))) && hashProgramBytes(binary.data(), binary.size()) == header.binaryHash;
+        }
+        GLint linked = 0;
+        if(valid)
+        {
+            glProgramBinary(program, header.format, binary.data(), GLsizei(binary.size()));
+            glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        }
+        if(!linked)
+        {
+            std::cout << "ERROR::PROGRAM_CACHE::STALE_BINARY: rebuilding " << path(key) << std::endl;
+            misses++;
+            return false;
+        }
+        hits++;
+        return true;
+    }
+
+    // call on a program before linking it, so the driver keeps what store() asks for
+    void prepare(GLuint program)
+    {
+        if(usable())
+            glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+
+    // writes the binary of a successfully linked program under key
+    void store(GLuint program, uint64_t key)
+    {
+        if(!usable())
+            return;
+        GLint length = 0;
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+        if(length <= 0)
+            return;
+        std::vector<char> binary(length);
+        GLenum format = 0;
+        GLsizei written = 0;
+        glGetProgramBinary(program, length, &written, &format, binary.data());
+        if(written <= 0)
+            return;
+        binary.resize(written);
+
+        std::error_code error;
+        std::filesystem::create_directories(directory, error);
+        // written next to the final name and renamed, a crash midway never leaves a truncated binary behind
+        std::string file = path(key), temporary = file + ".tmp";
+        {
+            std::ofstream out(temporary.c_str(), std::ios::binary);
+            ProgramBinaryHeader header = { PROGRAM_BINARY_MAGIC, PROGRAM_BINARY_VERSION, format, static_cast<uint32_t>(binary.size()), key,
+                                           hashProgramBytes(binary.data(), binary.size()) };
+            out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            out.write(binary.data(), std::streamsize(binary.size()));
+            if(!out.good())
+            {
+                std::cout << "ERROR::PROGRAM_CACHE::WRITE_FAILED: " << temporary << std::endl;
+                return;
+            }
+        }
+        std::filesystem::rename(temporary, file, error);
+        if(error)
+            std::cout << "ERROR::PROGRAM_CACHE::WRITE_FAILED: " << file << std::endl;
+    }
+
+private:
+    int supported = -1; // not asked yet
+    bool hashedDriver = false;
+    uint64_t driverKey = 0;
+
+    uint64_t driverHash()
+    {
+        if(!hashedDriver)
+        {
+            const uint32_t version = PROGRAM_BINARY_VERSION;
+            driverKey = hashProgramBytes(&version, sizeof(version));
+            for(GLenum name : { GL_VENDOR, GL_RENDERER, GL_VERSION })
+            {
+                const char *value = reinterpret_cast<const char*>(glGetString(name));
+                std::string text = value ? value : "";
+                text.push_back('\0');
+                driverKey = hashProgramBytes(text.data(), text.size(), driverKey);
+            }
+            hashedDriver = true;
+        }
+        return driverKey;
+    }
+
+    std::string path(uint64_t key) const
+    {
+        char name[32];
+        std::snprintf(name, sizeof(name), "%016llx.pbin", static_cast<unsigned long long>(key));
+        return directory + "/" + name;
+    }
+};
+#endif
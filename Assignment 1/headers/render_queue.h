@@ -0,0 +1,281 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <gl43.h>
+#include <gl_state.h>
+#include <material.h>
+#include <shader.h>
+#include <vertex_format.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// collects the draws of a frame, sorts them by a 64 bit key and submits them with as few state changes
+// as the order allows: a program is switched, a material bound and a VAO bound only when they differ from
+// the previous draw. the key (most significant bits first):
+//
+//   opaque, skybox:  bucket 2 | layer 4 | program 10 | material 16 | VAO 12 | depth 20 (front to back)
+//   transparent:     bucket 2 | layer 4 | depth 20 (back to front) | program 10 | material 16 | VAO 12
+//
+// opaque draws come first and share programs and textures, the skybox follows so only the pixels left
+// uncovered pay for it, and transparent draws are blended last in back to front order.
+
+enum class RenderBucket : uint8_t {
+    Opaque = 0,
+    Skybox = 1,     // drawn at the far plane with GL_LEQUAL
+    Transparent = 2 // blended, no depth writes
+};
+
+struct DrawCommand {
+    enum class Type { Arrays, MultiElements, ElementsInstanced, MultiElementsIndirect };
+
+    Type type = Type::Arrays;
+    Shader *shader = nullptr;
+    Material *material = nullptr; // optional
+    unsigned int VAO = 0;
+    GLenum indexType = GL_UNSIGNED_INT;
+
+    // per draw uniforms
+    bool hasTransform = false;
+    glm::mat4 transform = glm::mat4(1.0f); // the "model" matrix
+    int octNormals = -1;                   // -1 leaves octNormals alone
+
+    // Arrays
+    GLint first = 0;
+    GLsizei count = 0;
+    // MultiElements, the arrays have to stay valid until the queue is flushed
+    const GLsizei *counts = nullptr;
+    void *const *offsets = nullptr;
+    const GLint *baseVertices = nullptr;
+    GLsizei drawCount = 0;
+    // ElementsInstanced (count as for Arrays), per instance offsets read from instanceBuffer at instanceOffset
+    size_t indexOffset = 0;
+    GLint baseVertex = 0;
+    GLsizei instanceCount = 0;
+    unsigned int instanceBuffer = 0;
+    size_t instanceOffset = 0;
+    // the buffer holds InstanceTransforms of whole models instead, every instance is moved by copyOffset
+    // on top (for the copies of shared geometry inside the model)
+    bool instanceTransforms = false;
+    glm::vec3 copyOffset = glm::vec3(0.0f);
+    // MultiElementsIndirect, drawCount DrawElementsIndirectCommands from indirectBuffer at indirectOffset
+    // (GL 4.3, see gl43.h). the instances are read as for ElementsInstanced, from each record's baseInstance on
+    unsigned int indirectBuffer = 0;
+    size_t indirectOffset = 0;
+};
+
+// what the last flush did, to check that state changes scale with materials rather than draws
+struct RenderQueueStats {
+    unsigned int draws = 0;
+    unsigned int programSwitches = 0;
+    unsigned int materialBinds = 0;
+    unsigned int vaoBinds = 0;
+    unsigned int notReady = 0; // draws skipped because their program is still being built
+};
+
+class RenderQueue {
+public:
+    float maxDepth = 1000.0f; // view distance mapped to the largest depth key, the far plane
+    RenderQueueStats stats;
+
+    // commands without a shader can't be drawn and are dropped
+    void submit(RenderBucket bucket, unsigned int layer, float depth, const DrawCommand &command)
+    {
+        if(!command.shader)
+            return;
+        uint64_t program = command.shader->revision & 0x3FF;
+        uint64_t material = command.material ? command.material->sortKey() & 0xFFFF : 0;
+        uint64_t vao = command.VAO & 0xFFF;
+        uint64_t z = static_cast<uint64_t>(glm::clamp(depth / maxDepth, 0.0f, 1.0f) * float(0xFFFFF));
+        uint64_t key = uint64_t(bucket) << 62 | uint64_t(layer & 0xF) << 58;
+        if(bucket == RenderBucket::Transparent)
+            key |= (0xFFFFF - z) << 38 | program << 28 | material << 12 | vao;
+        else
+            key |= program << 48 | material << 32 | vao << 20 | z;
+        keys.push_back(SortItem{ key, static_cast<uint32_t>(commands.size()) });
+        commands.push_back(command);
+    }
+
+    // sorts and draws everything submitted since the last flush, then empties the queue
+    void flush()
+    {
+        sort();
+        stats = RenderQueueStats();
+        Shader *shader = nullptr;
+        unsigned int revision = 0;
+        const Material *material = nullptr; // last bound
+        unsigned int vao = ~0u;
+        int bucket = -1;
+        bool hasTransform = false;
+        glm::mat4 transform(1.0f);
+        int octNormals = -1;
+        for(const SortItem &item : keys)
+        {
+            const DrawCommand &command = commands[item.command];
+            int commandBucket = int(item.key >> 62);
+            if(commandBucket != bucket)
+            {
+                enterBucket(RenderBucket(commandBucket));
+                bucket = commandBucket;
+            }
+            // a program built with ShaderBuild::Async draws nothing until it is done
+            if(command.shader != shader && !command.shader->ready())
+            {
+                stats.notReady++;
+                continue;
+            }
+            if(command.shader != shader || command.shader->revision != revision)
+            {
+                shader = command.shader;
+                revision = shader->revision;
+                shader->use();
+                // uniforms are per program, everything has to be set again
+                material = nullptr;
+                hasTransform = false;
+                octNormals = -1;
+                stats.programSwitches++;
+            }
+            if(command.material && (!material || !material->sameBindings(*command.material)))
+            {
+                command.material->bind(*shader);
+                material = command.material;
+                stats.materialBinds++;
+            }
+            if(command.hasTransform && (!hasTransform || std::memcmp(&transform, &command.transform, sizeof(transform)) != 0))
+            {
+                shader->setMat4(MODEL_UNIFORM, command.transform);
+                transform = command.transform;
+                hasTransform = true;
+            }
+            if(command.octNormals >= 0 && command.octNormals != octNormals)
+            {
+                shader->setBool(OCT_NORMALS_UNIFORM, command.octNormals != 0);
+                octNormals = command.octNormals;
+            }
+            if(command.VAO != vao)
+            {
+                GLState::current().bindVertexArray(command.VAO);
+                vao = command.VAO;
+                stats.vaoBinds++;
+            }
+            execute(command);
+            stats.draws++;
+        }
+        keys.clear();
+        commands.clear();
+    }
+
+    size_t size() const { return commands.size(); }
+
+private:
+    struct SortItem {
+        uint64_t key;
+        uint32_t command;
+    };
+    static constexpr UniformName MODEL_UNIFORM = UniformName("model");
+    static constexpr UniformName OCT_NORMALS_UNIFORM = UniformName("octNormals");
+
+    std::vector<SortItem> keys, scratch;
+    std::vector<DrawCommand> commands;
+
+    // least significant digit first radix sort over the keys, 8 bits per pass. a pass whose digit is the
+    // same for every key is skipped, which with a few programs and materials is most of them. stable, so
+    // equal keys draw in submission order.
+    void sort()
+    {
+        scratch.resize(keys.size());
+        for(int shift = 0; shift < 64; shift += 8)
+        {
+            size_t counts[256] = {};
+            for(const SortItem &item : keys)
+                counts[(item.key >> shift) & 0xFF]++;
+            if(counts[(keys.empty() ? 0 : keys[0].key >> shift) & 0xFF] == keys.size())
+                continue;
+            size_t offset = 0;
+            for(size_t &count : counts)
+            {
+                size_t c = count;
+                count = offset;
+                offset += c;
+            }
+            for(const SortItem &item : keys)
+                scratch[counts[(item.key >> shift) & 0xFF]++] = item;
+            keys.swap(scratch);
+        }
+    }
+
+    static void enterBucket(RenderBucket bucket)
+    {
+        GLState &state = GLState::current();
+        state.depthFunc(bucket == RenderBucket::Skybox ? GL_LEQUAL : GL_LESS);
+        state.depthMask(bucket != RenderBucket::Transparent);
+        state.blend(bucket == RenderBucket::Transparent);
+        if(bucket == RenderBucket::Transparent)
+            state.blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    }
+
+    // the VAO may belong to another model, so the instance attributes are only enabled around the draw
+    static void enableInstances(const DrawCommand &command)
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, command.instanceBuffer);
+        if(command.instanceTransforms)
+        {
+            enableInstanceTransformAttributes(command.instanceOffset);
+            // a disabled attribute reads the current value, which isn't part of the VAO
+            glVertexAttrib3fv(ATTRIB_INSTANCE_OFFSET, &command.copyOffset[0]);
+        }
+        else
+        {
+            glEnableVertexAttribArray(ATTRIB_INSTANCE_OFFSET);
+            glVertexAttribPointer(ATTRIB_INSTANCE_OFFSET, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), reinterpret_cast<void*>(command.instanceOffset));
+            glVertexAttribDivisor(ATTRIB_INSTANCE_OFFSET, 1);
+        }
+    }
+
+    static void disableInstances(const DrawCommand &command)
+    {
+        if(command.instanceTransforms)
+        {
+            disableInstanceTransformAttributes();
+            glVertexAttrib3f(ATTRIB_INSTANCE_OFFSET, 0.0f, 0.0f, 0.0f);
+        }
+        else
+        {
+            glDisableVertexAttribArray(ATTRIB_INSTANCE_OFFSET);
+            glVertexAttribDivisor(ATTRIB_INSTANCE_OFFSET, 0);
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    static void execute(const DrawCommand &command)
+    {
+        switch(command.type)
+        {
+            case DrawCommand::Type::Arrays:
+                glDrawArrays(GL_TRIANGLES, command.first, command.count);
+                break;
+            case DrawCommand::Type::MultiElements:
+                glMultiDrawElementsBaseVertex(GL_TRIANGLES, command.counts, command.indexType, command.offsets, command.drawCount, command.baseVertices);
+                break;
+            case DrawCommand::Type::ElementsInstanced:
+                enableInstances(command);
+                glDrawElementsInstancedBaseVertex(GL_TRIANGLES, command.count, command.indexType, reinterpret_cast<void*>(command.indexOffset),
+                                                  command.instanceCount, command.baseVertex);
+                disableInstances(command);
+                break;
+            case DrawCommand::Type::MultiElementsIndirect:
+                glBindBuffer(GL_DRAW_INDIRECT_BUFFER, command.indirectBuffer);
+                enableInstances(command);
+                GL43::get().multiDrawElementsIndirect(GL_TRIANGLES, command.indexType, reinterpret_cast<void*>(command.indirectOffset), command.drawCount, 0);
+                disableInstances(command);
+                glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+                break;
+        }
+    }
+};
+#endif
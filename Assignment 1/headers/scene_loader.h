@@ -0,0 +1,148 @@
+#ifndef SCENE_LOADER_H
+#define SCENE_LOADER_H
+
+#include <asset_pack.h>
+#include <model.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// loads the models of a scene in parallel. each worker imports whole models with its own Assimp importer
+// (Model::Import makes no GL calls), and the calling thread, which owns the GL context, uploads every
+// model as soon as its import and its textures are done while the workers carry on with the next ones.
+// textures are requested by full path from one TextureStreamer as soon as a model is imported, so a file
+// used by several models is read, decoded and uploaded once, and its bands stream in while the rest of
+// the scene imports. geometry repeated across models is uploaded once through one GeometryRegistry.
+class SceneLoader {
+public:
+    TextureCache textures;   // shared by all models of the scene
+    GeometryRegistry geometry; // meshes repeated across models are uploaded once
+    unsigned int threads = 0; // 0 uses every core
+    bool verbose = false;     // see Model::verbose
+
+    // a scene manifest is a text file with one model path per line, # starts a comment
+    static std::vector<std::string> readManifest(const std::string &path)
+    {
+        std::vector<std::string> paths;
+        AssetView view;
+        if(!readAssetFile(path, view))
+        {
+            std::cout << "ERROR::SCENE_LOADER::MANIFEST_NOT_FOUND: " << path << std::endl;
+            return paths;
+        }
+        std::istringstream lines(std::string(reinterpret_cast<const char*>(view.data), view.size));
+        std::string line;
+        while(std::getline(lines, line))
+        {
+            line = line.substr(0, line.find('#'));
+            // trim, but keep spaces inside the path
+            size_t first = line.find_first_not_of(" \t\r"), last = line.find_last_not_of(" \t\r");
+            if(first != std::string::npos)
+                paths.push_back(line.substr(first, last - first + 1));
+        }
+        return paths;
+    }
+
+    // loads every model once, in manifest order. models that fail to import are left out.
+    std::vector<std::unique_ptr<Model>> load(const std::vector<std::string> &manifest)
+    {
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::string> paths;
+        for(const std::string &path : manifest)
+            if(std::find(paths.begin(), paths.end(), path) == paths.end())
+                paths.push_back(path);
+
+        std::vector<std::unique_ptr<Model>> models(paths.size());
+        std::vector<char> imported(paths.size(), 0);
+        if(paths.empty())
+            return models;
+
+        // models are imported side by side, whatever cores are left over split up the meshes of each model
+        unsigned int cores = threads ? threads : std::max(1u, std::thread::hardware_concurrency());
+        unsigned int workerCount = std::min<unsigned int>(cores, static_cast<unsigned int>(paths.size()));
+        unsigned int meshThreads = std::max(1u, cores / workerCount);
+
+        std::mutex mutex;
+        std::condition_variable doneCondition;
+        std::deque<size_t> done;
+        std::atomic<size_t> next(0);
+        // wakes the upload loop below whenever there are texture bands to upload
+        TextureStreamer streamer(textures, cores);
+        streamer.onProgress = [&]() {
+            std::lock_guard<std::mutex> lock(mutex);
+            doneCondition.notify_one();
+        };
+        auto work = [&]() {
+            for(size_t i = next++; i < paths.size(); i = next++)
+            {
+                std::unique_ptr<Model> model(new Model());
+                model->importThreads = meshThreads;
+                model->verbose = verbose;
+                bool ok = model->Import(paths[i]);
+                if(ok)
+                    streamer.request(model->TextureFiles(), model->maxTextureDimension);
+                std::lock_guard<std::mutex> lock(mutex);
+                models[i] = std::move(model);
+                imported[i] = ok;
+                done.push_back(i);
+                doneCondition.notify_one();
+            }
+        };
+        std::vector<std::thread> workers;
+        for(unsigned int i = 0; i < workerCount; i++)
+            workers.emplace_back(work);
+
+        // upload the texture bands as they come and every model once it is imported and its textures are in
+        std::vector<size_t> waiting;
+        for(size_t finished = 0; finished < paths.size();)
+        {
+            streamer.pump();
+            for(size_t w = 0; w < waiting.size();)
+            {
+                size_t i = waiting[w];
+                if(streamer.loaded(models[i]->TextureFiles()))
+                {
+                    models[i]->Upload(&textures, &geometry, &streamer);
+                    waiting.erase(waiting.begin() + w);
+                    finished++;
+                }
+                else
+                    w++;
+            }
+            if(finished == paths.size())
+                break;
+            std::unique_lock<std::mutex> lock(mutex);
+            doneCondition.wait(lock, [&]() { return !done.empty() || streamer.hasWork(); });
+            for(; !done.empty(); done.pop_front())
+            {
+                if(imported[done.front()])
+                    waiting.push_back(done.front());
+                else
+                    finished++;
+            }
+        }
+        for(std::thread &worker : workers)
+            worker.join();
+        geometry.seal();
+
+        std::vector<std::unique_ptr<Model>> loaded;
+        for(size_t i = 0; i < models.size(); i++)
+            if(imported[i])
+                loaded.push_back(std::move(models[i]));
+        std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+        std::cout << "SceneLoader: loaded " << loaded.size() << "/" << paths.size() << " model(s) with " << workerCount << " worker(s) x "
+                  << meshThreads << " mesh thread(s), " << textures.textures.size() << " unique texture(s), " << geometry.size() << " unique mesh(es) in " << seconds.count() << " s" << std::endl;
+        return loaded;
+    }
+};
+#endif
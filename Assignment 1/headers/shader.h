@@ -4,167 +4,379 @@
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 
+#include <batch_reader.h>
+#include <gl43.h>
+#include <gl_state.h>
+#include <parallel_compile.h>
+#include <program_cache.h>
+
+#include <algorithm>
+#include <cstdint>
 #include <string>
-#include <fstream>
-#include <sstream>
+#include <unordered_map>
+#include <vector>
 #include <iostream>
 
+// uniform blocks shared by every program. each is bound to its fixed binding point when a program
+// links, so one buffer per block serves all shaders (see frame_uniforms.h).
+enum UniformBlockBinding : GLuint {
+    FRAME_BLOCK_BINDING = 0
+};
+static const struct { const char *name; GLuint binding; } SHARED_UNIFORM_BLOCKS[] = {
+    { "Frame", FRAME_BLOCK_BINDING }
+};
+
+// a uniform name as the hash the locations are looked up by. literals hash without allocating, and a
+// static constexpr UniformName hashes at compile time.
+struct UniformName
+{
+    uint64_t hash = 14695981039346656037ull;
+
+    constexpr UniformName(const char *name)
+    {
+        for(; *name; name++)
+            hash = (hash ^ static_cast<unsigned char>(*name)) * 1099511628211ull;
+    }
+    UniformName(const std::string &name) : UniformName(name.c_str()) {}
+};
+
+// how a Shader constructor builds its program
+enum class ShaderBuild {
+    Blocking, // linked (or failed) when the constructor returns
+    Async     // compile and link are only issued, ready() finishes them. construct every program this way
+              // first and the driver can build them all at once
+};
+
 class Shader
 {
 public:
-    unsigned int ID;
+    unsigned int ID = 0; // 0 until a build succeeded
+    // changes whenever the program is (re)linked, anything caching locations compares against it.
+    // unlike ID it is never reused.
+    unsigned int revision = 0;
     // constructor generates the shader on the fly
     // ------------------------------------------------------------------------
-    Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr)
+    Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr, ShaderBuild mode = ShaderBuild::Blocking)
     {
-        // 1. retrieve the vertex/fragment source code from filePath
-        std::string vertexCode;
-        std::string fragmentCode;
-        std::string geometryCode;
-        std::ifstream vShaderFile;
-        std::ifstream fShaderFile;
-        std::ifstream gShaderFile;
-        // ensure ifstream objects can throw exceptions:
-        vShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-        fShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-        gShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-        try 
-        {
-            // open files
-            vShaderFile.open(vertexPath);
-            fShaderFile.open(fragmentPath);
-            std::stringstream vShaderStream, fShaderStream;
-            // read file's buffer contents into streams
-            vShaderStream << vShaderFile.rdbuf();
-            fShaderStream << fShaderFile.rdbuf();		
-            // close file handlers
-            vShaderFile.close();
-            fShaderFile.close();
-            // convert stream into string
-            vertexCode = vShaderStream.str();
-            fragmentCode = fShaderStream.str();			
-            // if geometry shader path is present, also load a geometry shader
-            if(geometryPath != nullptr)
-            {
-                gShaderFile.open(geometryPath);
-                std::stringstream gShaderStream;
-                gShaderStream << gShaderFile.rdbuf();
-                gShaderFile.close();
-                geometryCode = gShaderStream.str();
-            }
-        }
-        catch (std::ifstream::failure& e)
-        {
-            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << e.what() << std::endl;
-        }
-        const char* vShaderCode = vertexCode.c_str();
-        const char * fShaderCode = fragmentCode.c_str();
-        // 2. compile shaders
-        unsigned int vertex, fragment;
-        // vertex shader
-        vertex = glCreateShader(GL_VERTEX_SHADER);
-        glShaderSource(vertex, 1, &vShaderCode, NULL);
-        glCompileShader(vertex);
-        checkCompileErrors(vertex, "VERTEX");
-        // fragment Shader
-        fragment = glCreateShader(GL_FRAGMENT_SHADER);
-        glShaderSource(fragment, 1, &fShaderCode, NULL);
-        glCompileShader(fragment);
-        checkCompileErrors(fragment, "FRAGMENT");
-        // if geometry shader is given, compile geometry shader
-        unsigned int geometry;
-        if(geometryPath != nullptr)
-        {
-            const char * gShaderCode = geometryCode.c_str();
-            geometry = glCreateShader(GL_GEOMETRY_SHADER);
-            glShaderSource(geometry, 1, &gShaderCode, NULL);
-            glCompileShader(geometry);
-            checkCompileErrors(geometry, "GEOMETRY");
-        }
-        // shader Program
-        ID = glCreateProgram();
-        glAttachShader(ID, vertex);
-        glAttachShader(ID, fragment);
-        if(geometryPath != nullptr)
-            glAttachShader(ID, geometry);
-        glLinkProgram(ID);
-        checkCompileErrors(ID, "PROGRAM");
-        // delete the shaders as they're linked into our program now and no longer necessary
-        glDeleteShader(vertex);
-        glDeleteShader(fragment);
-        if(geometryPath != nullptr)
-            glDeleteShader(geometry);
-
+        submit(vertexPath, fragmentPath, geometryPath);
+        if(mode == ShaderBuild::Blocking)
+            finish();
+    }
+    // a compute program, needs a 4.3 context (see gl43.h)
+    explicit Shader(const char* computePath, ShaderBuild mode = ShaderBuild::Blocking)
+    {
+        submitCompute(computePath);
+        if(mode == ShaderBuild::Blocking)
+            finish();
+    }
+    // recompiles the program from the given files and swaps it in. if anything fails to compile
+    // or link the current program is kept, so a typo while editing a shader doesn't break rendering.
+    // ------------------------------------------------------------------------
+    bool reload(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr)
+    {
+        if(pending.program != 0)
+            finish();
+        submit(vertexPath, fragmentPath, geometryPath);
+        return finish();
+    }
+    bool reload(const char* computePath)
+    {
+        if(pending.program != 0)
+            finish();
+        submitCompute(computePath);
+        return finish();
+    }
+    // whether the program can be used. an Async build is finished here once the driver is done with it,
+    // which with GL_KHR_parallel_shader_compile never waits: until then this is false and the caller skips
+    // its draws. without the extension the first call waits for the build, the status is asked for as late
+    // as possible. also false when the first build failed, until a reload succeeds.
+    // ------------------------------------------------------------------------
+    bool ready()
+    {
+        if(pending.program != 0 && (!ParallelShaderCompile::get().supported || completed(pending.program)))
+            finish();
+        return ID != 0;
     }
     // activate the shader
     // ------------------------------------------------------------------------
     void use() 
     { 
-        glUseProgram(ID); 
+        GLState::current().useProgram(ID);
+    }
+    // location of an active uniform, -1 (which glUniform ignores) if the program doesn't use it.
+    // looked up in the table reflect() filled at link time, so setting a uniform never asks the driver.
+    // ------------------------------------------------------------------------
+    GLint location(UniformName name) const
+    {
+        auto it = locations.find(name.hash);
+        return it == locations.end() ? -1 : it->second;
     }
     // utility uniform functions
     // ------------------------------------------------------------------------
-    void setBool(const std::string &name, bool value) const
+    void setBool(UniformName name, bool value) const
     {         
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value); 
+        glUniform1i(location(name), (int)value); 
     }
     // ------------------------------------------------------------------------
-    void setInt(const std::string &name, int value) const
+    void setInt(UniformName name, int value) const
     { 
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value); 
+        glUniform1i(location(name), value); 
     }
     // ------------------------------------------------------------------------
-    void setFloat(const std::string &name, float value) const
+    void setFloat(UniformName name, float value) const
     { 
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value); 
+        glUniform1f(location(name), value); 
     }
     // ------------------------------------------------------------------------
-    void setVec2(const std::string &name, const glm::vec2 &value) const
+    void setVec2(UniformName name, const glm::vec2 &value) const
     { 
-        glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        glUniform2fv(location(name), 1, &value[0]); 
     }
-    void setVec2(const std::string &name, float x, float y) const
+    void setVec2(UniformName name, float x, float y) const
     { 
-        glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y); 
+        glUniform2f(location(name), x, y); 
     }
     // ------------------------------------------------------------------------
-    void setVec3(const std::string &name, const glm::vec3 &value) const
+    void setVec3(UniformName name, const glm::vec3 &value) const
     { 
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        glUniform3fv(location(name), 1, &value[0]); 
     }
-    void setVec3(const std::string &name, float x, float y, float z) const
+    void setVec3(UniformName name, float x, float y, float z) const
     { 
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z); 
+        glUniform3f(location(name), x, y, z); 
     }
     // ------------------------------------------------------------------------
-    void setVec4(const std::string &name, const glm::vec4 &value) const
+    void setVec4(UniformName name, const glm::vec4 &value) const
     { 
-        glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        glUniform4fv(location(name), 1, &value[0]); 
     }
-    void setVec4(const std::string &name, float x, float y, float z, float w) 
+    void setVec4(UniformName name, float x, float y, float z, float w) 
     { 
-        glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w); 
+        glUniform4f(location(name), x, y, z, w); 
     }
     // ------------------------------------------------------------------------
-    void setMat2(const std::string &name, const glm::mat2 &mat) const
+    void setMat2(UniformName name, const glm::mat2 &mat) const
     {
-        glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix2fv(location(name), 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
-    void setMat3(const std::string &name, const glm::mat3 &mat) const
+    void setMat3(UniformName name, const glm::mat3 &mat) const
     {
-        glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix3fv(location(name), 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
-    void setMat4(const std::string &name, const glm::mat4 &mat) const
+    void setMat4(UniformName name, const glm::mat4 &mat) const
     {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix4fv(location(name), 1, GL_FALSE, &mat[0][0]);
     }
 
 private:
+    std::unordered_map<uint64_t, GLint> locations; // UniformName hash -> location
+
+    // a build whose compile and link are issued but whose results haven't been asked for
+    struct PendingStage {
+        unsigned int shader;
+        const char *type; // for checkCompileErrors
+    };
+    struct PendingBuild {
+        unsigned int program = 0; // 0 when nothing is pending
+        std::vector<PendingStage> stages; // empty when the program came from the ProgramCache
+        uint64_t key = 0;
+        std::string path;
+    } pending;
+
+    // whether the driver is done compiling and linking program, without waiting for it
+    static bool completed(unsigned int program)
+    {
+        GLint done = GL_FALSE;
+        glGetProgramiv(program, GL_COMPLETION_STATUS_KHR, &done);
+        return done != GL_FALSE;
+    }
+
+    // asks for the results of the pending build, waiting for it if need be, and swaps the program in if it
+    // worked. returns whether it did
+    bool finish()
+    {
+        bool ok = true;
+        for(const PendingStage &stage : pending.stages)
+        {
+            ok &= checkCompileErrors(stage.shader, stage.type);
+            // flagged for deletion, it goes with the program
+            glDeleteShader(stage.shader);
+        }
+        unsigned int program = pending.program;
+        ok &= checkCompileErrors(program, "PROGRAM");
+        if(ok && !pending.stages.empty())
+            ProgramCache::get().store(program, pending.key);
+        std::string path = pending.path;
+        pending = PendingBuild();
+        return replace(program, ok, path.c_str());
+    }
+
+    // swaps a rebuilt program in, or drops it if it failed
+    bool replace(unsigned int program, bool ok, const char* path)
+    {
+        if(!ok)
+        {
+            GLState::current().forgetProgram(program);
+            glDeleteProgram(program);
+            if(ID != 0)
+                std::cout << "ERROR::SHADER::RELOAD_FAILED: keeping the previous program for " << path << std::endl;
+            else
+                std::cout << "ERROR::SHADER::BUILD_FAILED: nothing is drawn with " << path << " until it reloads" << std::endl;
+            return false;
+        }
+        if(ID != 0)
+        {
+            GLState::current().forgetProgram(ID);
+            glDeleteProgram(ID);
+        }
+        ID = program;
+        // the new program has its own locations
+        reflect();
+        return true;
+    }
+
+    // fills the location table from the program's active uniforms and binds its shared uniform blocks
+    // ------------------------------------------------------------------------
+    void reflect()
+    {
+        static unsigned int revisions = 0;
+        revision = ++revisions;
+        locations.clear();
+        GLint count = 0, maxLength = 0;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+        std::vector<GLchar> buffer(std::max(maxLength, 1));
+        for(GLint i = 0; i < count; i++)
+        {
+            GLint size;
+            GLenum type;
+            GLsizei length;
+            glGetActiveUniform(ID, GLuint(i), GLsizei(buffer.size()), &length, &size, &type, buffer.data());
+            std::string name(buffer.data(), length);
+            GLint first = glGetUniformLocation(ID, name.c_str());
+            if(first < 0)
+                continue; // a member of a uniform block
+            locations[UniformName(name).hash] = first;
+            // arrays are reported as name[0], make name and every element name[i] work as well
+            size_t bracket = name.rfind("[0]");
+            if(bracket != std::string::npos && bracket + 3 == name.size())
+            {
+                std::string base = name.substr(0, bracket);
+                locations[UniformName(base).hash] = first;
+                for(GLint element = 1; element < size; element++)
+                {
+                    std::string elementName = base + "[" + std::to_string(element) + "]";
+                    locations[UniformName(elementName).hash] = glGetUniformLocation(ID, elementName.c_str());
+                }
+            }
+        }
+
+        GLint blocks = 0;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_BLOCKS, &blocks);
+        for(GLint i = 0; i < blocks; i++)
+        {
+            GLchar name[256];
+            glGetActiveUniformBlockName(ID, GLuint(i), sizeof(name), nullptr, name);
+            bool shared = false;
+            for(const auto &block : SHARED_UNIFORM_BLOCKS)
+                if(std::string(block.name) == name)
+                {
+                    glUniformBlockBinding(ID, GLuint(i), block.binding);
+                    shared = true;
+                }
+            if(!shared)
+                std::cout << "ERROR::SHADER::UNKNOWN_UNIFORM_BLOCK: " << name << std::endl;
+        }
+    }
+
+    // reads the shader files and issues their compile and link as the pending build, without asking for
+    // any status so the driver is free to work on it in the background. a binary of the same sources
+    // linked by an earlier run is loaded from the ProgramCache instead.
+    // ------------------------------------------------------------------------
+    void submit(const char* vertexPath, const char* fragmentPath, const char* geometryPath)
+    {
+        // 1. retrieve the vertex/fragment source code from filePath, all stages in one batch
+        std::vector<BatchRead> files = { BatchRead(vertexPath), BatchRead(fragmentPath) };
+        if(geometryPath != nullptr)
+            files.push_back(BatchRead(geometryPath));
+        BatchReader reader;
+        reader.read(files);
+        for(const BatchRead &file : files)
+            if(!file.ok)
+                std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << file.path << std::endl;
+        std::string vertexCode(reinterpret_cast<const char*>(files[0].view.data), files[0].view.size);
+        std::string fragmentCode(reinterpret_cast<const char*>(files[1].view.data), files[1].view.size);
+        std::string geometryCode;
+        if(geometryPath != nullptr)
+            geometryCode.assign(reinterpret_cast<const char*>(files[2].view.data), files[2].view.size);
+        std::vector<ProgramStageSource> stages = { { GL_VERTEX_SHADER, &vertexCode }, { GL_FRAGMENT_SHADER, &fragmentCode } };
+        if(geometryPath != nullptr)
+            stages.push_back({ GL_GEOMETRY_SHADER, &geometryCode });
+        pending.path = fragmentPath;
+        if(loadCached(stages))
+            return;
+        // 2. compile shaders
+        compileStage(GL_VERTEX_SHADER, vertexCode, "VERTEX");
+        compileStage(GL_FRAGMENT_SHADER, fragmentCode, "FRAGMENT");
+        // if geometry shader is given, compile geometry shader
+        if(geometryPath != nullptr)
+            compileStage(GL_GEOMETRY_SHADER, geometryCode, "GEOMETRY");
+        link();
+    }
+    void submitCompute(const char* computePath)
+    {
+        std::vector<BatchRead> files = { BatchRead(computePath) };
+        BatchReader reader;
+        reader.read(files);
+        if(!files[0].ok)
+            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << files[0].path << std::endl;
+        std::string computeCode(reinterpret_cast<const char*>(files[0].view.data), files[0].view.size);
+        pending.path = computePath;
+        if(loadCached({ { GL_COMPUTE_SHADER, &computeCode } }))
+            return;
+        compileStage(GL_COMPUTE_SHADER, computeCode, "COMPUTE");
+        link();
+    }
+    void compileStage(GLenum type, const std::string &code, const char *name)
+    {
+        const char *source = code.c_str();
+        unsigned int shader = glCreateShader(type);
+        glShaderSource(shader, 1, &source, NULL);
+        glCompileShader(shader);
+        pending.stages.push_back(PendingStage{ shader, name });
+    }
+    // shader Program
+    void link()
+    {
+        pending.program = glCreateProgram();
+        for(const PendingStage &stage : pending.stages)
+            glAttachShader(pending.program, stage.shader);
+        ProgramCache::get().prepare(pending.program);
+        glLinkProgram(pending.program);
+    }
+    // makes the program cached for these sources the pending build, true if there was a valid one. sets the
+    // key to store the program under once it is built from source otherwise
+    bool loadCached(const std::vector<ProgramStageSource> &stages)
+    {
+        ProgramCache &cache = ProgramCache::get();
+        pending.key = cache.key(stages);
+        if(!cache.usable())
+            return false;
+        unsigned int program = glCreateProgram();
+        if(cache.load(program, pending.key))
+        {
+            pending.program = program;
+            return true;
+        }
+        // start the build from source on a clean program, not one a rejected binary went into
+        glDeleteProgram(program);
+        return false;
+    }
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
-    void checkCompileErrors(GLuint shader, std::string type)
+    bool checkCompileErrors(GLuint shader, std::string type)
     {
         GLint success;
         GLchar infoLog[1024];
@@ -186,6 +398,7 @@ private:
                 std::cout << "ERROR::PROGRAM_LINKING_ERROR of type: " << type << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
             }
         }
+        return success != 0;
     }
 };
 #endif
\ No newline at end of file
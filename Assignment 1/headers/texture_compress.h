@@ -0,0 +1,172 @@
+#ifndef TEXTURE_COMPRESS_H
+#define TEXTURE_COMPRESS_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// BC1 (DXT1) and BC3 (DXT5) block compression for cooked textures. 4x4 texel blocks, 8 and 16 bytes.
+// endpoints come from the principal axis of the block's colors, which is close to what offline encoders
+// get on photographic content at a fraction of the cost of an exhaustive search.
+
+inline uint16_t packRGB565(const float color[3])
+{
+    int r = int(std::lround(std::min(std::max(color[0], 0.0f), 255.0f) * 31.0f / 255.0f));
+    int g = int(std::lround(std::min(std::max(color[1], 0.0f), 255.0f) * 63.0f / 255.0f));
+    int b = int(std::lround(std::min(std::max(color[2], 0.0f), 255.0f) * 31.0f / 255.0f));
+    return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+}
+
+inline void unpackRGB565(uint16_t packed, int color[3])
+{
+    int r = (packed >> 11) & 31, g = (packed >> 5) & 63, b = packed & 31;
+    color[0] = (r << 3) | (r >> 2);
+    color[1] = (g << 2) | (g >> 4);
+    color[2] = (b << 3) | (b >> 2);
+}
+
+// color part of a block, always in four color mode (color0 > color1)
+inline void compressColorBlock(const unsigned char rgba[64], unsigned char out[8])
+{
+    float mean[3] = { 0.0f, 0.0f, 0.0f };
+    for(int i = 0; i < 16; i++)
+        for(int c = 0; c < 3; c++)
+            mean[c] += rgba[i * 4 + c] / 16.0f;
+    float cov[6] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+    for(int i = 0; i < 16; i++)
+    {
+        float d[3] = { rgba[i * 4] - mean[0], rgba[i * 4 + 1] - mean[1], rgba[i * 4 + 2] - mean[2] };
+        cov[0] += d[0] * d[0]; cov[1] += d[0] * d[1]; cov[2] += d[0] * d[2];
+        cov[3] += d[1] * d[1]; cov[4] += d[1] * d[2]; cov[5] += d[2] * d[2];
+    }
+    // principal axis by power iteration
+    float axis[3] = { 1.0f, 1.0f, 1.0f };
+    for(int iteration = 0; iteration < 8; iteration++)
+    {
+        float next[3] = { cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2],
+                          cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2],
+                          cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2] };
+        float length = std::sqrt(next[0] * next[0] + next[1] * next[1] + next[2] * next[2]);
+        if(length < 1e-6f)
+            break;
+        for(int c = 0; c < 3; c++)
+            axis[c] = next[c] / length;
+    }
+    float minT = INFINITY, maxT = -INFINITY;
+    for(int i = 0; i < 16; i++)
+    {
+        float t = (rgba[i * 4] - mean[0]) * axis[0] + (rgba[i * 4 + 1] - mean[1]) * axis[1] + (rgba[i * 4 + 2] - mean[2]) * axis[2];
+        minT = std::min(minT, t);
+        maxT = std::max(maxT, t);
+    }
+    float endpoint0[3], endpoint1[3];
+    for(int c = 0; c < 3; c++)
+    {
+        endpoint0[c] = mean[c] + axis[c] * maxT;
+        endpoint1[c] = mean[c] + axis[c] * minT;
+    }
+    uint16_t color0 = packRGB565(endpoint0), color1 = packRGB565(endpoint1);
+    if(color0 < color1)
+        std::swap(color0, color1);
+
+    uint32_t selectors = 0;
+    if(color0 != color1)
+    {
+        int palette[4][3];
+        unpackRGB565(color0, palette[0]);
+        unpackRGB565(color1, palette[1]);
+        for(int c = 0; c < 3; c++)
+        {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+        for(int i = 0; i < 16; i++)
+        {
+            int best = 0, bestError = 1 << 30;
+            for(int p = 0; p < 4; p++)
+            {
+                int dr = rgba[i * 4] - palette[p][0], dg = rgba[i * 4 + 1] - palette[p][1], db = rgba[i * 4 + 2] - palette[p][2];
+                int error = dr * dr + dg * dg + db * db;
+                if(error < bestError)
+                {
+                    bestError = error;
+                    best = p;
+                }
+            }
+            selectors |= uint32_t(best) << (i * 2);
+        }
+    }
+    out[0] = static_cast<unsigned char>(color0 & 0xFF);
+    out[1] = static_cast<unsigned char>(color0 >> 8);
+    out[2] = static_cast<unsigned char>(color1 & 0xFF);
+    out[3] = static_cast<unsigned char>(color1 >> 8);
+    std::memcpy(out + 4, &selectors, 4); // little endian
+}
+
+// BC3 alpha part: eight interpolated values between the block's min and max alpha
+inline void compressAlphaBlock(const unsigned char rgba[64], unsigned char out[8])
+{
+    int alpha0 = 0, alpha1 = 255;
+    for(int i = 0; i < 16; i++)
+    {
+        alpha0 = std::max(alpha0, int(rgba[i * 4 + 3]));
+        alpha1 = std::min(alpha1, int(rgba[i * 4 + 3]));
+    }
+    out[0] = static_cast<unsigned char>(alpha0);
+    out[1] = static_cast<unsigned char>(alpha1);
+    uint64_t selectors = 0;
+    if(alpha0 > alpha1)
+    {
+        int palette[8] = { alpha0, alpha1 };
+        for(int p = 1; p < 7; p++)
+            palette[p + 1] = ((7 - p) * alpha0 + p * alpha1) / 7;
+        for(int i = 0; i < 16; i++)
+        {
+            int best = 0, bestError = 1 << 30;
+            for(int p = 0; p < 8; p++)
+            {
+                int error = std::abs(int(rgba[i * 4 + 3]) - palette[p]);
+                if(error < bestError)
+                {
+                    bestError = error;
+                    best = p;
+                }
+            }
+            selectors |= uint64_t(best) << (i * 3);
+        }
+    }
+    for(int b = 0; b < 6; b++)
+        out[2 + b] = static_cast<unsigned char>(selectors >> (b * 8));
+}
+
+// compresses a whole RGBA8 image, partial blocks at the edges repeat their last row/column.
+// returns the blocks row by row, 8 (BC1) or 16 (BC3) bytes each.
+inline std::vector<unsigned char> compressImageBC(const unsigned char *rgba, uint32_t width, uint32_t height, bool withAlpha)
+{
+    const uint32_t blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+    const size_t blockBytes = withAlpha ? 16 : 8;
+    std::vector<unsigned char> out(size_t(blocksX) * blocksY * blockBytes);
+    unsigned char block[64];
+    for(uint32_t by = 0; by < blocksY; by++)
+        for(uint32_t bx = 0; bx < blocksX; bx++)
+        {
+            for(uint32_t y = 0; y < 4; y++)
+                for(uint32_t x = 0; x < 4; x++)
+                {
+                    uint32_t sx = std::min(bx * 4 + x, width - 1), sy = std::min(by * 4 + y, height - 1);
+                    std::memcpy(&block[(y * 4 + x) * 4], &rgba[(size_t(sy) * width + sx) * 4], 4);
+                }
+            unsigned char *dst = &out[(size_t(by) * blocksX + bx) * blockBytes];
+            if(withAlpha)
+            {
+                compressAlphaBlock(block, dst);
+                compressColorBlock(block, dst + 8);
+            }
+            else
+                compressColorBlock(block, dst);
+        }
+    return out;
+}
+#endif
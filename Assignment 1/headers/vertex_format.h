@@ -0,0 +1,377 @@
+#ifndef VERTEX_FORMAT_H
+#define VERTEX_FORMAT_H
+
+#include <glad/glad.h> // holds all OpenGL type declarations
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <glm/gtc/packing.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <vector>
+
+#define MAX_BONE_INFLUENCE 4
+
+// full precision vertex as it comes out of the importer. this is only the CPU side representation,
+// what ends up in the vertex buffer is decided by a VertexLayout (see packVertices below).
+struct Vertex {
+    // position
+    glm::vec3 Position;
+    // normal
+    glm::vec3 Normal;
+    // texCoords
+    glm::vec2 TexCoords;
+    // tangent
+    glm::vec3 Tangent;
+    // bitangent
+    glm::vec3 Bitangent;
+	//bone indexes which will influence this vertex
+	int m_BoneIDs[MAX_BONE_INFLUENCE];
+	//weights from each bone
+	float m_Weights[MAX_BONE_INFLUENCE];
+};
+
+// attribute locations shared by every layout, the vertex shaders rely on these.
+enum VertexAttribute {
+    ATTRIB_POSITION  = 0,
+    ATTRIB_NORMAL    = 1,
+    ATTRIB_TEXCOORDS = 2,
+    ATTRIB_TANGENT   = 3, // vec3 tangent, or the tangent frame quaternion
+    ATTRIB_BITANGENT = 4,
+    ATTRIB_BONE_IDS  = 5,
+    ATTRIB_WEIGHTS   = 6,
+    ATTRIB_INSTANCE_OFFSET = 7, // per instance translation of shared geometry, (0,0,0) when not enabled
+    // whole model instances (see InstanceTransform below)
+    ATTRIB_INSTANCE_POSITION_SCALE = 8,
+    ATTRIB_INSTANCE_ROTATION       = 9,
+    ATTRIB_INSTANCE_TINT           = 10,
+    ATTRIB_INSTANCE_LIVERY         = 11
+};
+
+enum class NormalEncoding  { Float, Octahedral };     // 3 floats / 2x snorm16
+enum class TangentEncoding { None, Float, Quaternion }; // -- / 2x 3 floats / 4x snorm16, handedness in sign of w
+enum class TexCoordEncoding { Float, Half };         // 2 floats / 2 half floats
+enum class BoneEncoding    { None, Float, Packed };  // -- / 4 ints + 4 floats / 4x uint8 + 4x unorm8
+
+// describes how a Vertex is packed into GPU memory. Full() mirrors the Vertex struct 1:1,
+// the compact layouts quantize every attribute and drop the streams a mesh doesn't use.
+struct VertexLayout {
+    NormalEncoding   normals   = NormalEncoding::Float;
+    TangentEncoding  tangents  = TangentEncoding::Float;
+    TexCoordEncoding texCoords = TexCoordEncoding::Float;
+    BoneEncoding     bones     = BoneEncoding::Float;
+    bool allow16BitIndices     = false; // use GL_UNSIGNED_SHORT indices when the mesh has <= 65536 vertices
+
+    // 88 bytes, the original layout
+    static VertexLayout Full()
+    {
+        return VertexLayout();
+    }
+    // 20 bytes: float position, octahedral normal, half uvs (24 with bones)
+    static VertexLayout Compact(bool skinned = false)
+    {
+        VertexLayout layout;
+        layout.normals   = NormalEncoding::Octahedral;
+        layout.tangents  = TangentEncoding::None;
+        layout.texCoords = TexCoordEncoding::Half;
+        layout.bones     = skinned ? BoneEncoding::Packed : BoneEncoding::None;
+        layout.allow16BitIndices = true;
+        return layout;
+    }
+    // 28 bytes: as Compact() plus a quaternion tangent frame for normal mapping (36 with bones)
+    static VertexLayout CompactTangentFrame(bool skinned = false)
+    {
+        VertexLayout layout = Compact(skinned);
+        layout.tangents = TangentEncoding::Quaternion;
+        return layout;
+    }
+
+    // byte offsets of each stream inside one vertex, -1 if the stream is not present
+    int normalOffset() const    { return 12; }
+    int texCoordOffset() const  { return normalOffset() + (normals == NormalEncoding::Float ? 12 : 4); }
+    int tangentOffset() const   { return tangents == TangentEncoding::None ? -1 : texCoordOffset() + (texCoords == TexCoordEncoding::Float ? 8 : 4); }
+    int bitangentOffset() const { return tangents == TangentEncoding::Float ? tangentOffset() + 12 : -1; }
+    int boneOffset() const
+    {
+        if(bones == BoneEncoding::None)
+            return -1;
+        int offset = texCoordOffset() + (texCoords == TexCoordEncoding::Float ? 8 : 4);
+        if(tangents == TangentEncoding::Float)
+            offset += 24;
+        else if(tangents == TangentEncoding::Quaternion)
+            offset += 8;
+        return offset;
+    }
+    int weightOffset() const    { return bones == BoneEncoding::None ? -1 : boneOffset() + (bones == BoneEncoding::Float ? 16 : 4); }
+    GLsizei stride() const
+    {
+        if(bones != BoneEncoding::None)
+            return weightOffset() + (bones == BoneEncoding::Float ? 16 : 4);
+        if(tangents != TangentEncoding::None)
+            return tangentOffset() + (tangents == TangentEncoding::Float ? 24 : 8);
+        return texCoordOffset() + (texCoords == TexCoordEncoding::Float ? 8 : 4);
+    }
+
+    bool operator==(const VertexLayout &other) const
+    {
+        return normals == other.normals && tangents == other.tangents && texCoords == other.texCoords &&
+               bones == other.bones && allow16BitIndices == other.allow16BitIndices;
+    }
+    bool operator!=(const VertexLayout &other) const { return !(*this == other); }
+};
+
+// index type a mesh with vertexCount vertices ends up with under the given layout
+inline GLenum chooseIndexType(const VertexLayout &layout, size_t vertexCount)
+{
+    return (layout.allow16BitIndices && vertexCount <= 65536) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+}
+
+inline size_t indexSize(GLenum indexType)
+{
+    return indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t);
+}
+
+// quantization helpers
+// ------------------------------------------------------------------------
+inline int16_t packSnorm16(float v)
+{
+    v = glm::clamp(v, -1.0f, 1.0f);
+    return static_cast<int16_t>(std::lround(v * 32767.0f));
+}
+
+inline uint8_t packUnorm8(float v)
+{
+    v = glm::clamp(v, 0.0f, 1.0f);
+    return static_cast<uint8_t>(std::lround(v * 255.0f));
+}
+
+// octahedral normal encoding, the unit sphere is projected onto an octahedron and unfolded into [-1,1]^2
+inline glm::vec2 octEncode(glm::vec3 n)
+{
+    float l1 = std::fabs(n.x) + std::fabs(n.y) + std::fabs(n.z);
+    if(l1 <= 0.0f)
+        return glm::vec2(0.0f, 0.0f);
+    n /= l1;
+    glm::vec2 p(n.x, n.y);
+    if(n.z < 0.0f)
+    {
+        p.x = (1.0f - std::fabs(n.y)) * (n.x >= 0.0f ? 1.0f : -1.0f);
+        p.y = (1.0f - std::fabs(n.x)) * (n.y >= 0.0f ? 1.0f : -1.0f);
+    }
+    return p;
+}
+
+inline glm::vec3 octDecode(glm::vec2 p)
+{
+    glm::vec3 n(p.x, p.y, 1.0f - std::fabs(p.x) - std::fabs(p.y));
+    float t = glm::max(-n.z, 0.0f);
+    n.x += n.x >= 0.0f ? -t : t;
+    n.y += n.y >= 0.0f ? -t : t;
+    return glm::normalize(n);
+}
+
+// encodes a tangent frame as a unit quaternion, the bitangent handedness is stored in the sign of w.
+// w is kept away from zero so the sign survives snorm16 quantization.
+inline glm::quat encodeTangentFrame(glm::vec3 normal, glm::vec3 tangent, glm::vec3 bitangent)
+{
+    glm::vec3 n = glm::normalize(normal);
+    glm::vec3 t = tangent - n * glm::dot(n, tangent);
+    if(glm::dot(t, t) < 1e-12f)
+    {
+        // degenerate or missing tangent, pick any vector orthogonal to the normal
+        t = std::fabs(n.x) < 0.9f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+        t = t - n * glm::dot(n, t);
+    }
+    t = glm::normalize(t);
+    glm::vec3 b = glm::cross(n, t);
+    float handedness = glm::dot(b, bitangent) < 0.0f ? -1.0f : 1.0f;
+
+    glm::quat q = glm::normalize(glm::quat_cast(glm::mat3(t, b, n)));
+    if(q.w < 0.0f)
+        q = -q;
+    const float bias = 1.0f / 32767.0f;
+    if(q.w < bias)
+    {
+        float scale = std::sqrt(1.0f - bias * bias);
+        q = glm::quat(bias, q.x * scale, q.y * scale, q.z * scale);
+    }
+    if(handedness < 0.0f)
+        q = -q;
+    return q;
+}
+
+// packs vertices into an interleaved buffer following the given layout
+inline std::vector<unsigned char> packVertices(const std::vector<Vertex> &vertices, const VertexLayout &layout)
+{
+    const size_t stride = layout.stride();
+    std::vector<unsigned char> data(vertices.size() * stride, 0);
+    for(size_t i = 0; i < vertices.size(); i++)
+    {
+        const Vertex &v = vertices[i];
+        unsigned char *dst = data.data() + i * stride;
+        std::memcpy(dst, &v.Position, 12);
+
+        if(layout.normals == NormalEncoding::Float)
+            std::memcpy(dst + layout.normalOffset(), &v.Normal, 12);
+        else
+        {
+            glm::vec2 oct = octEncode(v.Normal);
+            int16_t packed[2] = { packSnorm16(oct.x), packSnorm16(oct.y) };
+            std::memcpy(dst + layout.normalOffset(), packed, sizeof(packed));
+        }
+
+        if(layout.texCoords == TexCoordEncoding::Float)
+            std::memcpy(dst + layout.texCoordOffset(), &v.TexCoords, 8);
+        else
+        {
+            uint16_t packed[2] = { glm::packHalf1x16(v.TexCoords.x), glm::packHalf1x16(v.TexCoords.y) };
+            std::memcpy(dst + layout.texCoordOffset(), packed, sizeof(packed));
+        }
+
+        if(layout.tangents == TangentEncoding::Float)
+        {
+            std::memcpy(dst + layout.tangentOffset(), &v.Tangent, 12);
+            std::memcpy(dst + layout.bitangentOffset(), &v.Bitangent, 12);
+        }
+        else if(layout.tangents == TangentEncoding::Quaternion)
+        {
+            glm::quat q = encodeTangentFrame(v.Normal, v.Tangent, v.Bitangent);
+            int16_t packed[4] = { packSnorm16(q.x), packSnorm16(q.y), packSnorm16(q.z), packSnorm16(q.w) };
+            std::memcpy(dst + layout.tangentOffset(), packed, sizeof(packed));
+        }
+
+        if(layout.bones == BoneEncoding::Float)
+        {
+            std::memcpy(dst + layout.boneOffset(), v.m_BoneIDs, sizeof(v.m_BoneIDs));
+            std::memcpy(dst + layout.weightOffset(), v.m_Weights, sizeof(v.m_Weights));
+        }
+        else if(layout.bones == BoneEncoding::Packed)
+        {
+            uint8_t ids[MAX_BONE_INFLUENCE];
+            uint8_t weights[MAX_BONE_INFLUENCE];
+            for(int j = 0; j < MAX_BONE_INFLUENCE; j++)
+            {
+                ids[j] = static_cast<uint8_t>(glm::clamp(v.m_BoneIDs[j], 0, 255));
+                weights[j] = packUnorm8(v.m_Weights[j]);
+            }
+            std::memcpy(dst + layout.boneOffset(), ids, sizeof(ids));
+            std::memcpy(dst + layout.weightOffset(), weights, sizeof(weights));
+        }
+    }
+    return data;
+}
+
+// packs indices as 16 or 32 bit depending on indexType
+inline std::vector<unsigned char> packIndices(const std::vector<unsigned int> &indices, GLenum indexType)
+{
+    std::vector<unsigned char> data(indices.size() * indexSize(indexType));
+    if(indexType == GL_UNSIGNED_SHORT)
+    {
+        uint16_t *dst = reinterpret_cast<uint16_t*>(data.data());
+        for(size_t i = 0; i < indices.size(); i++)
+            dst[i] = static_cast<uint16_t>(indices[i]);
+    }
+    else if(!indices.empty())
+        std::memcpy(data.data(), indices.data(), data.size());
+    return data;
+}
+
+// sets the vertex attribute pointers of the currently bound VAO/VBO pair to match the layout
+inline void setupVertexAttributes(const VertexLayout &layout)
+{
+    const GLsizei stride = layout.stride();
+    // vertex Positions
+    glEnableVertexAttribArray(ATTRIB_POSITION);
+    glVertexAttribPointer(ATTRIB_POSITION, 3, GL_FLOAT, GL_FALSE, stride, (void*)0);
+    // vertex normals
+    glEnableVertexAttribArray(ATTRIB_NORMAL);
+    if(layout.normals == NormalEncoding::Float)
+        glVertexAttribPointer(ATTRIB_NORMAL, 3, GL_FLOAT, GL_FALSE, stride, (void*)(intptr_t)layout.normalOffset());
+    else
+        glVertexAttribPointer(ATTRIB_NORMAL, 2, GL_SHORT, GL_TRUE, stride, (void*)(intptr_t)layout.normalOffset());
+    // vertex texture coords
+    glEnableVertexAttribArray(ATTRIB_TEXCOORDS);
+    if(layout.texCoords == TexCoordEncoding::Float)
+        glVertexAttribPointer(ATTRIB_TEXCOORDS, 2, GL_FLOAT, GL_FALSE, stride, (void*)(intptr_t)layout.texCoordOffset());
+    else
+        glVertexAttribPointer(ATTRIB_TEXCOORDS, 2, GL_HALF_FLOAT, GL_FALSE, stride, (void*)(intptr_t)layout.texCoordOffset());
+    // vertex tangent (frame)
+    if(layout.tangents == TangentEncoding::Float)
+    {
+        glEnableVertexAttribArray(ATTRIB_TANGENT);
+        glVertexAttribPointer(ATTRIB_TANGENT, 3, GL_FLOAT, GL_FALSE, stride, (void*)(intptr_t)layout.tangentOffset());
+        glEnableVertexAttribArray(ATTRIB_BITANGENT);
+        glVertexAttribPointer(ATTRIB_BITANGENT, 3, GL_FLOAT, GL_FALSE, stride, (void*)(intptr_t)layout.bitangentOffset());
+    }
+    else if(layout.tangents == TangentEncoding::Quaternion)
+    {
+        glEnableVertexAttribArray(ATTRIB_TANGENT);
+        glVertexAttribPointer(ATTRIB_TANGENT, 4, GL_SHORT, GL_TRUE, stride, (void*)(intptr_t)layout.tangentOffset());
+    }
+    // ids and weights
+    if(layout.bones == BoneEncoding::Float)
+    {
+        glEnableVertexAttribArray(ATTRIB_BONE_IDS);
+        glVertexAttribIPointer(ATTRIB_BONE_IDS, 4, GL_INT, stride, (void*)(intptr_t)layout.boneOffset());
+        glEnableVertexAttribArray(ATTRIB_WEIGHTS);
+        glVertexAttribPointer(ATTRIB_WEIGHTS, 4, GL_FLOAT, GL_FALSE, stride, (void*)(intptr_t)layout.weightOffset());
+    }
+    else if(layout.bones == BoneEncoding::Packed)
+    {
+        glEnableVertexAttribArray(ATTRIB_BONE_IDS);
+        glVertexAttribIPointer(ATTRIB_BONE_IDS, 4, GL_UNSIGNED_BYTE, stride, (void*)(intptr_t)layout.boneOffset());
+        glEnableVertexAttribArray(ATTRIB_WEIGHTS);
+        glVertexAttribPointer(ATTRIB_WEIGHTS, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride, (void*)(intptr_t)layout.weightOffset());
+    }
+}
+
+// 40 bytes per drawn copy of a whole model, streamed every frame and read with a divisor of 1. the shader
+// rebuilds the model matrix from it: rotate by the quaternion, scale uniformly, then translate.
+struct InstanceTransform {
+    glm::vec4 positionScale; // xyz position, w uniform scale
+    glm::vec4 rotation;      // quaternion as x, y, z, w
+    uint8_t   tint[4];       // rgba multiplier, unorm8
+    uint32_t  livery;        // index into the livery palette of the shader
+};
+static_assert(sizeof(InstanceTransform) == 40, "InstanceTransform is read by the vertex shader with this layout");
+
+inline InstanceTransform packInstanceTransform(const glm::vec3 &position, const glm::quat &rotation, float scale, const glm::vec4 &tint, uint32_t livery)
+{
+    InstanceTransform instance;
+    instance.positionScale = glm::vec4(position, scale);
+    instance.rotation = glm::vec4(rotation.x, rotation.y, rotation.z, rotation.w);
+    for(int i = 0; i < 4; i++)
+        instance.tint[i] = static_cast<uint8_t>(glm::clamp(tint[i], 0.0f, 1.0f) * 255.0f + 0.5f);
+    instance.livery = livery;
+    return instance;
+}
+
+// points the instance attributes at the InstanceTransforms in the bound GL_ARRAY_BUFFER from offset on,
+// or disables them again. the VAO may be shared, so enable them only around the draw.
+inline void enableInstanceTransformAttributes(size_t offset)
+{
+    const GLsizei stride = sizeof(InstanceTransform);
+    glEnableVertexAttribArray(ATTRIB_INSTANCE_POSITION_SCALE);
+    glVertexAttribPointer(ATTRIB_INSTANCE_POSITION_SCALE, 4, GL_FLOAT, GL_FALSE, stride, (void*)(intptr_t)(offset + offsetof(InstanceTransform, positionScale)));
+    glEnableVertexAttribArray(ATTRIB_INSTANCE_ROTATION);
+    glVertexAttribPointer(ATTRIB_INSTANCE_ROTATION, 4, GL_FLOAT, GL_FALSE, stride, (void*)(intptr_t)(offset + offsetof(InstanceTransform, rotation)));
+    glEnableVertexAttribArray(ATTRIB_INSTANCE_TINT);
+    glVertexAttribPointer(ATTRIB_INSTANCE_TINT, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride, (void*)(intptr_t)(offset + offsetof(InstanceTransform, tint)));
+    glEnableVertexAttribArray(ATTRIB_INSTANCE_LIVERY);
+    glVertexAttribIPointer(ATTRIB_INSTANCE_LIVERY, 1, GL_UNSIGNED_INT, stride, (void*)(intptr_t)(offset + offsetof(InstanceTransform, livery)));
+    for(GLuint attribute = ATTRIB_INSTANCE_POSITION_SCALE; attribute <= ATTRIB_INSTANCE_LIVERY; attribute++)
+        glVertexAttribDivisor(attribute, 1);
+}
+
+inline void disableInstanceTransformAttributes()
+{
+    for(GLuint attribute = ATTRIB_INSTANCE_POSITION_SCALE; attribute <= ATTRIB_INSTANCE_LIVERY; attribute++)
+    {
+        glDisableVertexAttribArray(attribute);
+        glVertexAttribDivisor(attribute, 0);
+    }
+}
+#endif
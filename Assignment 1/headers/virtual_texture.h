@@ -0,0 +1,397 @@
+#ifndef VIRTUAL_TEXTURE_H
+#define VIRTUAL_TEXTURE_H
+
+#include <glad/glad.h> // holds all OpenGL type declarations
+
+#include <glm/glm.hpp>
+
+#include <asset_pack.h>
+#include <gl_state.h>
+#include <virtual_texture_file.h>
+
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// virtual texture streamed from a tile file (see virtual_texture_file.h and the TextureTiler tool).
+//
+// only the tiles that are requested live on the GPU, in a fixed size physical cache texture managed LRU.
+// a page table texture maps every virtual tile to the cache slot holding it, or to the closest coarser
+// tile that is resident, so the shader always has something to sample. the coarsest level is a single
+// tile that stays pinned. tiles are read by a background thread and uploaded by update() on the render
+// thread, a few per frame, so resident memory is bounded by the cache size and not by the source image.
+class VirtualTexture {
+public:
+    unsigned int physicalTexture = 0;  // RGBA8 tile cache, physicalTiles x physicalTiles slots
+    unsigned int pageTableTexture = 0; // RGBA8 (slot x, slot y, resident level, valid), all levels stacked vertically
+    unsigned int physicalTiles;
+    unsigned int uploadsPerFrame;
+    // stats of the last update()
+    unsigned int residentTiles = 0, pendingTiles = 0, uploadedTiles = 0;
+
+    VirtualTexture(const std::string &tileFilePath, unsigned int physicalTiles = 16, unsigned int uploadsPerFrame = 16)
+        : physicalTiles(physicalTiles), uploadsPerFrame(uploadsPerFrame)
+    {
+        // tiles are read straight out of the mounted asset pack if it has the file uncompressed
+        AssetView packed;
+        bool opened = readPackedAsset(tileFilePath, packed) && packed.storage.empty() ? file.open(packed.data, packed.size, tileFilePath)
+                                                                                      : file.open(tileFilePath);
+        if(!opened)
+        {
+            std::cout << "ERROR::VIRTUAL_TEXTURE::FILE_NOT_SUCCESSFULLY_READ: " << tileFilePath << std::endl;
+            return;
+        }
+        const VirtualTextureHeader &h = file.header;
+        side = h.tileSize + 2 * h.border;
+
+        // page bookkeeping
+        size_t pageCount = file.offsets.size();
+        pageSlot.assign(pageCount, -1);
+        pagePending.assign(pageCount, 0);
+        pageLevel.resize(pageCount);
+        pageX.resize(pageCount);
+        pageY.resize(pageCount);
+        pageTableRow.resize(h.levels);
+        unsigned int row = 0;
+        for(uint32_t level = 0; level < h.levels; level++)
+        {
+            pageTableRow[level] = row;
+            row += file.tilesY[level];
+            for(uint32_t y = 0; y < file.tilesY[level]; y++)
+                for(uint32_t x = 0; x < file.tilesX[level]; x++)
+                {
+                    size_t page = file.firstTile[level] + y * file.tilesX[level] + x;
+                    pageLevel[page] = level;
+                    pageX[page] = x;
+                    pageY[page] = y;
+                }
+        }
+        pageTableWidth = file.tilesX[0];
+        pageTableHeight = row;
+        pageTable.assign(size_t(pageTableWidth) * pageTableHeight * 4, 0);
+        slots.assign(size_t(physicalTiles) * physicalTiles, Slot());
+
+        glGenTextures(1, &physicalTexture);
+        GLState::current().bindTextureForUpload(GL_TEXTURE_2D, physicalTexture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, physicalTiles * side, physicalTiles * side, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+        glGenTextures(1, &pageTableTexture);
+        GLState::current().bindTextureForUpload(GL_TEXTURE_2D, pageTableTexture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, pageTableWidth, pageTableHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+        // the coarsest level is loaded right away and never evicted, everything falls back to it
+        int top = int(pageCount) - 1;
+        std::vector<unsigned char> data(file.tileBytes());
+        if(file.readTile(pageLevel[top], 0, 0, data.data()))
+        {
+            upload(top, 0, data.data());
+            slots[0].pinned = true;
+        }
+        rebuildPageTable();
+
+        worker = std::thread(&VirtualTexture::streamTiles, this);
+        std::cout << "VirtualTexture: '" << tileFilePath << "' " << h.width << "x" << h.height << ", " << h.levels << " levels, "
+                  << pageCount << " tiles, cache " << slots.size() << " tiles (" << (physicalTiles * side) * (physicalTiles * side) * 4 / (1024 * 1024) << " MB)" << std::endl;
+    }
+
+    ~VirtualTexture()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            quit = true;
+        }
+        wake.notify_all();
+        if(worker.joinable())
+            worker.join();
+        GLState::current().forgetTexture(physicalTexture);
+        GLState::current().forgetTexture(pageTableTexture);
+        if(physicalTexture)
+            glDeleteTextures(1, &physicalTexture);
+        if(pageTableTexture)
+            glDeleteTextures(1, &pageTableTexture);
+    }
+
+    VirtualTexture(const VirtualTexture&) = delete;
+    VirtualTexture &operator=(const VirtualTexture&) = delete;
+
+    bool valid() const { return physicalTexture != 0; }
+    unsigned int width() const { return file.header.width; }
+    unsigned int height() const { return file.header.height; }
+    unsigned int levels() const { return file.header.levels; }
+    unsigned int tileSize() const { return file.header.tileSize; }
+    unsigned int border() const { return file.header.border; }
+
+    // level at which the texture is about pixelsAcross texels wide
+    int levelForFootprint(float pixelsAcross) const
+    {
+        float size = float(std::max(file.header.width, file.header.height));
+        int level = int(std::floor(std::log2(size / std::max(pixelsAcross, 1.0f))));
+        return glm::clamp(level, 0, int(file.header.levels) - 1);
+    }
+
+    // requests the tiles covering [uvMin, uvMax] at level, or at the closest coarser level whose tiles for
+    // the region fit into half the cache, so one region can't evict everything else that is visible.
+    // the texture repeats like it does in the shader: coordinates outside 0..1 wrap, a region spanning
+    // a whole repeat covers the full width or height.
+    void requestRegion(glm::vec2 uvMin, glm::vec2 uvMax, int level)
+    {
+        level = glm::clamp(level, 0, int(file.header.levels) - 1);
+        // per axis the one or two ranges inside 0..1 the region wraps to
+        glm::vec2 ranges[2][2];
+        int rangeCount[2];
+        for(int axis = 0; axis < 2; axis++)
+        {
+            float start = uvMin[axis] - std::floor(uvMin[axis]);
+            float end = start + (uvMax[axis] - uvMin[axis]);
+            rangeCount[axis] = 1;
+            if(uvMax[axis] - uvMin[axis] >= 1.0f)
+                ranges[axis][0] = glm::vec2(0.0f, 1.0f);
+            else if(end > 1.0f)
+            {
+                ranges[axis][0] = glm::vec2(start, 1.0f);
+                ranges[axis][1] = glm::vec2(0.0f, end - 1.0f);
+                rangeCount[axis] = 2;
+            }
+            else
+                ranges[axis][0] = glm::vec2(start, end);
+        }
+        auto tileCount = [&](int l) {
+            size_t count = 0;
+            for(int y = 0; y < rangeCount[1]; y++)
+                for(int x = 0; x < rangeCount[0]; x++)
+                {
+                    TileRect rect = tileRect(glm::vec2(ranges[0][x].x, ranges[1][y].x), glm::vec2(ranges[0][x].y, ranges[1][y].y), l);
+                    count += size_t(rect.x1 - rect.x0 + 1) * (rect.y1 - rect.y0 + 1);
+                }
+            return count;
+        };
+        while(level + 1 < int(file.header.levels) && tileCount(level) > slots.size() / 2)
+            level++;
+        for(int y = 0; y < rangeCount[1]; y++)
+            for(int x = 0; x < rangeCount[0]; x++)
+            {
+                TileRect rect = tileRect(glm::vec2(ranges[0][x].x, ranges[1][y].x), glm::vec2(ranges[0][x].y, ranges[1][y].y), level);
+                for(uint32_t ty = rect.y0; ty <= rect.y1; ty++)
+                    for(uint32_t tx = rect.x0; tx <= rect.x1; tx++)
+                        requestPage(int(file.firstTile[level] + ty * file.tilesX[level] + tx));
+            }
+    }
+
+    // call once per frame on the render thread: hands requests to the streaming thread, uploads finished tiles
+    // and refreshes the page table
+    void update()
+    {
+        if(!valid())
+            return;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            while(!newRequests.empty() && requests.size() < 4 * uploadsPerFrame)
+            {
+                requests.push_back(newRequests.front());
+                newRequests.pop_front();
+            }
+            while(!completed.empty())
+            {
+                arrived.push_back(std::move(completed.front()));
+                completed.pop_front();
+            }
+        }
+        wake.notify_one();
+
+        uploadedTiles = 0;
+        while(!arrived.empty() && uploadedTiles < uploadsPerFrame)
+        {
+            LoadedTile tile = std::move(arrived.front());
+            arrived.pop_front();
+            pagePending[tile.page] = 0;
+            int slot = tile.data.empty() ? -1 : findSlot();
+            if(slot < 0)
+                continue; // every slot is in use this frame, the page table keeps pointing at a coarser tile
+            upload(tile.page, slot, tile.data.data());
+            uploadedTiles++;
+        }
+        if(pageTableDirty)
+            rebuildPageTable();
+
+        residentTiles = 0;
+        for(const Slot &slot : slots)
+            if(slot.page >= 0)
+                residentTiles++;
+        pendingTiles = static_cast<unsigned int>(newRequests.size() + arrived.size());
+        frame++;
+    }
+
+private:
+    struct Slot {
+        int page = -1;
+        unsigned int lastUsed = 0;
+        bool pinned = false;
+    };
+    struct LoadedTile {
+        int page;
+        std::vector<unsigned char> data;
+    };
+
+    VirtualTextureFile file;
+    unsigned int side = 0;
+    unsigned int frame = 1;
+
+    std::vector<int> pageSlot;
+    std::vector<char> pagePending;
+    std::vector<uint32_t> pageLevel, pageX, pageY;
+    std::vector<Slot> slots;
+
+    std::vector<unsigned int> pageTableRow;
+    unsigned int pageTableWidth = 0, pageTableHeight = 0;
+    std::vector<unsigned char> pageTable;
+    bool pageTableDirty = false;
+
+    // streaming thread state
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool quit = false;
+    std::deque<int> requests;              // guarded by mutex
+    std::deque<LoadedTile> completed;      // guarded by mutex
+    std::deque<int> newRequests;           // render thread only
+    std::deque<LoadedTile> arrived;        // render thread only
+
+    // tiles of a level covering [uvMin, uvMax] (0..1), inclusive
+    struct TileRect {
+        uint32_t x0, y0, x1, y1;
+    };
+    TileRect tileRect(glm::vec2 uvMin, glm::vec2 uvMax, int level) const
+    {
+        uvMin = glm::clamp(uvMin, glm::vec2(0.0f), glm::vec2(1.0f));
+        uvMax = glm::clamp(uvMax, glm::vec2(0.0f), glm::vec2(1.0f));
+        float levelWidth = float(virtualLevelSize(file.header.width, level));
+        float levelHeight = float(virtualLevelSize(file.header.height, level));
+        TileRect rect;
+        rect.x0 = std::min(uint32_t(uvMin.x * levelWidth) / file.header.tileSize, file.tilesX[level] - 1);
+        rect.x1 = std::min(uint32_t(uvMax.x * levelWidth) / file.header.tileSize, file.tilesX[level] - 1);
+        rect.y0 = std::min(uint32_t(uvMin.y * levelHeight) / file.header.tileSize, file.tilesY[level] - 1);
+        rect.y1 = std::min(uint32_t(uvMax.y * levelHeight) / file.header.tileSize, file.tilesY[level] - 1);
+        return rect;
+    }
+
+    void requestPage(int page)
+    {
+        if(pageSlot[page] >= 0)
+        {
+            slots[pageSlot[page]].lastUsed = frame;
+            return;
+        }
+        if(!pagePending[page])
+        {
+            pagePending[page] = 1;
+            newRequests.push_back(page);
+        }
+    }
+
+    // a free slot, or the least recently used one that wasn't needed this frame
+    int findSlot()
+    {
+        int best = -1;
+        for(size_t i = 0; i < slots.size(); i++)
+        {
+            if(slots[i].pinned)
+                continue;
+            if(slots[i].page < 0)
+                return int(i);
+            if(slots[i].lastUsed < frame && (best < 0 || slots[i].lastUsed < slots[best].lastUsed))
+                best = int(i);
+        }
+        if(best >= 0)
+        {
+            pageSlot[slots[best].page] = -1;
+            slots[best].page = -1;
+        }
+        return best;
+    }
+
+    void upload(int page, int slot, const unsigned char *data)
+    {
+        GLState::current().bindTextureForUpload(GL_TEXTURE_2D, physicalTexture);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, (slot % physicalTiles) * side, (slot / physicalTiles) * side, side, side, GL_RGBA, GL_UNSIGNED_BYTE, data);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        slots[slot].page = page;
+        slots[slot].lastUsed = frame;
+        pageSlot[page] = slot;
+        pageTableDirty = true;
+    }
+
+    // every entry points at its own tile if resident, otherwise inherits the entry of its parent tile
+    void rebuildPageTable()
+    {
+        for(int level = int(file.header.levels) - 1; level >= 0; level--)
+            for(uint32_t y = 0; y < file.tilesY[level]; y++)
+                for(uint32_t x = 0; x < file.tilesX[level]; x++)
+                {
+                    unsigned char *entry = &pageTable[(size_t(pageTableRow[level] + y) * pageTableWidth + x) * 4];
+                    int slot = pageSlot[file.firstTile[level] + y * file.tilesX[level] + x];
+                    if(slot >= 0)
+                    {
+                        entry[0] = static_cast<unsigned char>(slot % physicalTiles);
+                        entry[1] = static_cast<unsigned char>(slot / physicalTiles);
+                        entry[2] = static_cast<unsigned char>(level);
+                        entry[3] = 255;
+                    }
+                    else if(level + 1 < int(file.header.levels))
+                    {
+                        uint32_t px = std::min(x / 2, file.tilesX[level + 1] - 1);
+                        uint32_t py = std::min(y / 2, file.tilesY[level + 1] - 1);
+                        std::memcpy(entry, &pageTable[(size_t(pageTableRow[level + 1] + py) * pageTableWidth + px) * 4], 4);
+                    }
+                    else
+                        std::memset(entry, 0, 4);
+                }
+        GLState::current().bindTextureForUpload(GL_TEXTURE_2D, pageTableTexture);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, pageTableWidth, pageTableHeight, GL_RGBA, GL_UNSIGNED_BYTE, pageTable.data());
+        pageTableDirty = false;
+    }
+
+    // streaming thread: reads requested tiles from the tile file
+    void streamTiles()
+    {
+        const size_t bytes = file.tileBytes();
+        while(true)
+        {
+            int page;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [this] { return quit || !requests.empty(); });
+                if(quit)
+                    return;
+                page = requests.front();
+                requests.pop_front();
+            }
+            LoadedTile tile;
+            tile.page = page;
+            tile.data.resize(bytes);
+            if(!file.readTile(pageLevel[page], pageX[page], pageY[page], tile.data.data()))
+            {
+                std::cout << "ERROR::VIRTUAL_TEXTURE::TILE_READ_FAILED: page " << page << std::endl;
+                tile.data.clear();
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            completed.push_back(std::move(tile));
+        }
+    }
+};
+#endif
@@ -0,0 +1,218 @@
+#ifndef VIRTUAL_TEXTURE_FILE_H
+#define VIRTUAL_TEXTURE_FILE_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// tile file of a virtual texture: the whole mip pyramid cut into square RGBA8 tiles, each tile stored
+// with a border of neighbouring texels so bilinear filtering inside the physical cache doesn't bleed.
+//
+//   VirtualTextureHeader
+//   uint32 tilesX, tilesY          per level
+//   uint64 offset                  per tile, level by level, row by row
+//   tile data                      (tileSize + 2 * border)^2 * 4 bytes per tile
+//
+// level k is max(1, width >> k) by max(1, height >> k) texels; the last level fits into a single tile.
+
+#define VIRTUAL_TEXTURE_MAGIC   0x54585456u // "VTXT"
+#define VIRTUAL_TEXTURE_VERSION 1u
+
+struct VirtualTextureHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t width, height;
+    uint32_t tileSize, border;
+    uint32_t levels;
+    uint32_t reserved;
+};
+
+inline uint32_t virtualLevelSize(uint32_t size, uint32_t level)
+{
+    return std::max(1u, size >> level);
+}
+
+inline uint32_t virtualTilesAcross(uint32_t size, uint32_t tileSize)
+{
+    return (size + tileSize - 1) / tileSize;
+}
+
+// read side, used by the streaming thread of a VirtualTexture. reads from a file or from memory (a tile file
+// inside a mapped asset pack). not thread safe, one reader per thread.
+class VirtualTextureFile {
+public:
+    VirtualTextureHeader header;
+    std::vector<uint32_t> tilesX, tilesY;
+    std::vector<uint32_t> firstTile; // index of the first tile of each level in offsets
+    std::vector<uint64_t> offsets;
+
+    bool open(const std::string &path)
+    {
+        file.open(path.c_str(), std::ios::binary);
+        if(!file.good())
+            return false;
+        return readIndex(path);
+    }
+
+    // data has to outlive the reader
+    bool open(const unsigned char *data, size_t size, const std::string &name)
+    {
+        memory = data;
+        memorySize = size;
+        return readIndex(name);
+    }
+
+    size_t tileBytes() const
+    {
+        size_t side = header.tileSize + 2 * header.border;
+        return side * side * 4;
+    }
+
+    bool readTile(uint32_t level, uint32_t x, uint32_t y, unsigned char *dst)
+    {
+        if(level >= header.levels || x >= tilesX[level] || y >= tilesY[level])
+            return false;
+        return readAt(offsets[firstTile[level] + y * tilesX[level] + x], dst, tileBytes());
+    }
+
+private:
+    std::ifstream file;
+    const unsigned char *memory = nullptr;
+    size_t memorySize = 0;
+
+    bool readAt(uint64_t offset, void *dst, size_t bytes)
+    {
+        if(memory)
+        {
+            if(offset + bytes > memorySize)
+                return false;
+            std::memcpy(dst, memory + offset, bytes);
+            return true;
+        }
+        file.clear();
+        file.seekg(std::streamoff(offset));
+        file.read(reinterpret_cast<char*>(dst), std::streamsize(bytes));
+        return file.good();
+    }
+
+    bool readIndex(const std::string &name)
+    {
+        if(!readAt(0, &header, sizeof(header)) || header.magic != VIRTUAL_TEXTURE_MAGIC || header.version != VIRTUAL_TEXTURE_VERSION ||
+           header.levels == 0 || header.levels > 32)
+        {
+            std::cout << "ERROR::VIRTUAL_TEXTURE::BAD_FILE: " << name << std::endl;
+            file.close();
+            memory = nullptr;
+            return false;
+        }
+        tilesX.resize(header.levels);
+        tilesY.resize(header.levels);
+        firstTile.resize(header.levels);
+        std::vector<uint32_t> dims(header.levels * 2);
+        if(!readAt(sizeof(header), dims.data(), dims.size() * sizeof(uint32_t)))
+            return false;
+        uint32_t total = 0;
+        for(uint32_t level = 0; level < header.levels; level++)
+        {
+            tilesX[level] = dims[level * 2];
+            tilesY[level] = dims[level * 2 + 1];
+            firstTile[level] = total;
+            total += tilesX[level] * tilesY[level];
+        }
+        offsets.resize(total);
+        return readAt(sizeof(header) + dims.size() * sizeof(uint32_t), offsets.data(), total * sizeof(uint64_t));
+    }
+};
+
+// offline side: cuts an RGBA8 image into a tile file. the borders wrap around, matching the GL_REPEAT
+// sampling regular model textures use.
+inline bool writeVirtualTextureFile(const std::string &path, const unsigned char *rgba, uint32_t width, uint32_t height,
+                                    uint32_t tileSize = 128, uint32_t border = 4)
+{
+    std::ofstream out(path.c_str(), std::ios::binary);
+    if(!out.good())
+    {
+        std::cout << "ERROR::VIRTUAL_TEXTURE::CANNOT_WRITE: " << path << std::endl;
+        return false;
+    }
+
+    VirtualTextureHeader header = { VIRTUAL_TEXTURE_MAGIC, VIRTUAL_TEXTURE_VERSION, width, height, tileSize, border, 0, 0 };
+    std::vector<uint32_t> tilesX, tilesY;
+    for(uint32_t level = 0; ; level++)
+    {
+        tilesX.push_back(virtualTilesAcross(virtualLevelSize(width, level), tileSize));
+        tilesY.push_back(virtualTilesAcross(virtualLevelSize(height, level), tileSize));
+        if(tilesX.back() == 1 && tilesY.back() == 1)
+            break;
+    }
+    header.levels = static_cast<uint32_t>(tilesX.size());
+    size_t tileCount = 0;
+    for(uint32_t level = 0; level < header.levels; level++)
+        tileCount += size_t(tilesX[level]) * tilesY[level];
+
+    // header and table first, the offsets are known up front since every tile has the same size
+    const size_t side = tileSize + 2 * border;
+    const size_t tileBytes = side * side * 4;
+    uint64_t dataStart = sizeof(header) + header.levels * 2 * sizeof(uint32_t) + tileCount * sizeof(uint64_t);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    for(uint32_t level = 0; level < header.levels; level++)
+    {
+        uint32_t dims[2] = { tilesX[level], tilesY[level] };
+        out.write(reinterpret_cast<const char*>(dims), sizeof(dims));
+    }
+    for(size_t i = 0; i < tileCount; i++)
+    {
+        uint64_t offset = dataStart + i * tileBytes;
+        out.write(reinterpret_cast<const char*>(&offset), sizeof(offset));
+    }
+
+    std::vector<unsigned char> current(rgba, rgba + size_t(width) * height * 4);
+    std::vector<unsigned char> next;
+    std::vector<unsigned char> tile(tileBytes);
+    uint32_t w = width, h = height;
+    for(uint32_t level = 0; level < header.levels; level++)
+    {
+        for(uint32_t ty = 0; ty < tilesY[level]; ty++)
+            for(uint32_t tx = 0; tx < tilesX[level]; tx++)
+            {
+                for(size_t y = 0; y < side; y++)
+                    for(size_t x = 0; x < side; x++)
+                    {
+                        // texels past the edge of the level wrap around
+                        long sx = long(tx * tileSize) + long(x) - long(border);
+                        long sy = long(ty * tileSize) + long(y) - long(border);
+                        sx = ((sx % long(w)) + long(w)) % long(w);
+                        sy = ((sy % long(h)) + long(h)) % long(h);
+                        std::memcpy(&tile[(y * side + x) * 4], &current[(size_t(sy) * w + size_t(sx)) * 4], 4);
+                    }
+                out.write(reinterpret_cast<const char*>(tile.data()), std::streamsize(tile.size()));
+            }
+
+        if(level + 1 == header.levels)
+            break;
+        // 2x2 box filter down to the next level
+        uint32_t nw = virtualLevelSize(width, level + 1), nh = virtualLevelSize(height, level + 1);
+        next.assign(size_t(nw) * nh * 4, 0);
+        for(uint32_t y = 0; y < nh; y++)
+            for(uint32_t x = 0; x < nw; x++)
+            {
+                uint32_t x0 = std::min(x * 2, w - 1), x1 = std::min(x * 2 + 1, w - 1);
+                uint32_t y0 = std::min(y * 2, h - 1), y1 = std::min(y * 2 + 1, h - 1);
+                for(int c = 0; c < 4; c++)
+                {
+                    unsigned int sum = current[(size_t(y0) * w + x0) * 4 + c] + current[(size_t(y0) * w + x1) * 4 + c] +
+                                       current[(size_t(y1) * w + x0) * 4 + c] + current[(size_t(y1) * w + x1) * 4 + c];
+                    next[(size_t(y) * nw + x) * 4 + c] = static_cast<unsigned char>((sum + 2) / 4);
+                }
+            }
+        current.swap(next);
+        w = nw;
+        h = nh;
+    }
+    return out.good();
+}
+#endif
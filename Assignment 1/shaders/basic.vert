@@ -3,8 +3,15 @@ layout (location = 0) in vec3 aPos;
 
 out vec3 TexCoords; // Changed to vec3 for cubemap sampling
 
-uniform mat4 projection;
-uniform mat4 view;
+// shared by every program, see frame_uniforms.h
+layout (std140) uniform Frame
+{
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+    vec3 lightPos;
+    vec3 lightColor;
+};
 
 void main()
 {
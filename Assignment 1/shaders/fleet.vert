@@ -0,0 +1,71 @@
+#version 330 core
+
+// phong.vert for instanced copies of a whole model (see fleet.h): the model matrix comes from the
+// per instance attributes instead of the "model" uniform
+
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;    // xy only when octNormals is set
+layout (location = 2) in vec2 aTexCoords;
+layout (location = 7) in vec3 aInstanceOffset; // copies of shared geometry inside the model, (0,0,0) otherwise
+layout (location = 8) in vec4 aPositionScale;  // InstanceTransform in vertex_format.h
+layout (location = 9) in vec4 aRotation;
+layout (location = 10) in vec4 aTint;
+layout (location = 11) in uint aLivery;
+
+out vec2 TexCoords;
+out vec3 Normal;
+out vec3 FragPos;
+out vec4 Tint;
+
+// shared by every program, see frame_uniforms.h
+layout (std140) uniform Frame
+{
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+    vec3 lightPos;
+    vec3 lightColor;
+};
+
+uniform bool octNormals;
+
+// the colour schemes an instance can pick with its livery index
+const int LIVERY_COUNT = 8;
+const vec3 LIVERIES[LIVERY_COUNT] = vec3[](
+    vec3(1.00, 1.00, 1.00), // the texture as it is
+    vec3(0.85, 0.25, 0.20),
+    vec3(0.25, 0.45, 0.85),
+    vec3(0.30, 0.70, 0.35),
+    vec3(0.95, 0.80, 0.25),
+    vec3(0.55, 0.55, 0.60),
+    vec3(0.60, 0.35, 0.75),
+    vec3(0.20, 0.20, 0.22)
+);
+
+// inverse of octEncode in vertex_format.h
+vec3 octDecode(vec2 p)
+{
+    vec3 n = vec3(p, 1.0 - abs(p.x) - abs(p.y));
+    float t = max(-n.z, 0.0);
+    n.xy += mix(vec2(t), vec2(-t), greaterThanEqual(n.xy, vec2(0.0)));
+    return normalize(n);
+}
+
+vec3 rotate(vec4 q, vec3 v)
+{
+    return v + 2.0 * cross(q.xyz, cross(q.xyz, v) + q.w * v);
+}
+
+void main()
+{
+    TexCoords = aTexCoords;
+    Tint = aTint * vec4(LIVERIES[min(int(aLivery), LIVERY_COUNT - 1)], 1.0);
+
+    // the scale is uniform, so normals only need the rotation
+    FragPos = aPositionScale.xyz + rotate(aRotation, (aPos + aInstanceOffset) * aPositionScale.w);
+
+    vec3 normal = octNormals ? octDecode(aNormal.xy) : aNormal;
+    Normal = rotate(aRotation, normal);
+
+    gl_Position = projection * view * vec4(FragPos, 1.0);
+}
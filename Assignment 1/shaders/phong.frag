@@ -4,11 +4,63 @@ out vec4 FragColor;
 in vec2 TexCoords;
 in vec3 Normal;
 in vec3 FragPos;
+in vec4 Tint;
 
 uniform sampler2D texture_diffuse1;
-uniform vec3 lightPos;
-uniform vec3 viewPos;
-uniform vec3 lightColor;
+// virtual texturing: texture_diffuse1 is then the physical tile cache
+uniform bool texture_diffuse1_virtual;
+uniform sampler2D texture_diffuse1_pages;
+uniform vec4 texture_diffuse1_vt; // width, height, tile size, border
+
+// shared by every program, see frame_uniforms.h
+layout (std140) uniform Frame
+{
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+    vec3 lightPos;
+    vec3 lightColor;
+};
+
+// looks the tile up in the page table (all levels stacked vertically, each entry is the cache slot
+// and the level actually resident) and samples the physical cache inside that tile's border
+vec4 sampleVirtual(sampler2D physical, sampler2D pages, vec4 vt, vec2 uv)
+{
+    ivec2 size = ivec2(vt.xy);
+    int tile = int(vt.z);
+    int border = int(vt.w);
+
+    // mip level from the screen space derivatives, before wrapping so seams don't pick the smallest level
+    vec2 dx = dFdx(uv * vt.xy);
+    vec2 dy = dFdy(uv * vt.xy);
+    float lod = 0.5 * log2(max(max(dot(dx, dx), dot(dy, dy)), 1e-8));
+    uv = fract(uv);
+
+    // find the level and its first row in the page table
+    int level = 0;
+    int row = 0;
+    for(int k = 0; k < 32; k++)
+    {
+        ivec2 levelSize = max(ivec2(1), size >> k);
+        ivec2 tiles = (levelSize + tile - 1) / tile;
+        if(float(k) + 1.0 > lod || (tiles.x == 1 && tiles.y == 1))
+            break;
+        row += tiles.y;
+        level++;
+    }
+    ivec2 levelSize = max(ivec2(1), size >> level);
+    ivec2 tiles = (levelSize + tile - 1) / tile;
+    ivec2 page = min(ivec2(uv * vec2(levelSize)) / tile, tiles - 1);
+    vec4 entry = texelFetch(pages, ivec2(page.x, row + page.y), 0) * 255.0;
+    ivec2 slot = ivec2(entry.xy + 0.5);
+    int resident = int(entry.z + 0.5);
+
+    // position inside the resident tile
+    vec2 texel = uv * vec2(max(ivec2(1), size >> resident));
+    vec2 inTile = texel - vec2(min(ivec2(texel) / tile, (max(ivec2(1), size >> resident) + tile - 1) / tile - 1) * tile);
+    vec2 physicalTexel = vec2(slot * (tile + 2 * border) + border) + inTile;
+    return textureLod(physical, physicalTexel / vec2(textureSize(physical, 0)), 0.0);
+}
 
 void main()
 {
@@ -30,6 +82,8 @@ void main()
     float spec = pow(max(dot(viewDir, reflectDir), 0.0), 32);
     vec3 specular = specularStrength * spec * lightColor;
 
-    vec3 objectColor = texture(texture_diffuse1, TexCoords).rgb;
+    vec3 objectColor = texture_diffuse1_virtual ? sampleVirtual(texture_diffuse1, texture_diffuse1_pages, texture_diffuse1_vt, TexCoords).rgb
+                                                : texture(texture_diffuse1, TexCoords).rgb;
+    objectColor *= Tint.rgb;
     FragColor = vec4((ambient + diffuse + specular) * objectColor, 1.0);
 }
\ No newline at end of file
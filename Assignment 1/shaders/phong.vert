@@ -1,24 +1,46 @@
 #version 330 core 
 
 layout (location = 0) in vec3 aPos;
-layout (location = 1) in vec2 aTexCoords;
-layout (location = 2) in vec3 aNormal;
+layout (location = 1) in vec3 aNormal;    // xy only when octNormals is set
+layout (location = 2) in vec2 aTexCoords;
+layout (location = 7) in vec3 aInstanceOffset; // copies of shared geometry, (0,0,0) otherwise
 
 out vec2 TexCoords;
 out vec3 Normal;
 out vec3 FragPos;
+out vec4 Tint; // per instance colour in fleet.vert
+
+// shared by every program, see frame_uniforms.h
+layout (std140) uniform Frame
+{
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+    vec3 lightPos;
+    vec3 lightColor;
+};
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+uniform bool octNormals;
+
+// inverse of octEncode in vertex_format.h
+vec3 octDecode(vec2 p)
+{
+    vec3 n = vec3(p, 1.0 - abs(p.x) - abs(p.y));
+    float t = max(-n.z, 0.0);
+    n.xy += mix(vec2(t), vec2(-t), greaterThanEqual(n.xy, vec2(0.0)));
+    return normalize(n);
+}
 
 void main()
 {
     TexCoords = aTexCoords;
+    Tint = vec4(1.0);
 
-    FragPos = vec3(model * vec4(aPos, 1.0));
+    FragPos = vec3(model * vec4(aPos + aInstanceOffset, 1.0));
 
-    Normal = mat3(transpose(inverse(model))) * aNormal;
+    vec3 normal = octNormals ? octDecode(aNormal.xy) : aNormal;
+    Normal = mat3(transpose(inverse(model))) * normal;
 
     gl_Position = projection * view * vec4(FragPos, 1.0);
     
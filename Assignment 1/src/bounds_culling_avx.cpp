@@ -0,0 +1,43 @@
+// the AVX path of cullBounds (bounds_culling.h). this is the only file compiled with AVX enabled, and
+// cullBounds only calls into it after checking the CPU at runtime. it includes nothing but the intrinsics:
+// an inline function of a shared header compiled here would be AVX code the linker could pick for
+// every other file too.
+#include <immintrin.h>
+
+#include <cstddef>
+#include <cstdint>
+
+size_t cullBoundsAVX(const float *planes, const float *centerX, const float *centerY, const float *centerZ,
+                     const float *extentX, const float *extentY, const float *extentZ, size_t count, uint32_t *visible)
+{
+    __m256 nx[6], ny[6], nz[6], ax[6], ay[6], az[6], d[6];
+    const __m256 signMask = _mm256_set1_ps(-0.0f);
+    for(int p = 0; p < 6; p++)
+    {
+        nx[p] = _mm256_set1_ps(planes[p * 4]);
+        ny[p] = _mm256_set1_ps(planes[p * 4 + 1]);
+        nz[p] = _mm256_set1_ps(planes[p * 4 + 2]);
+        d[p] = _mm256_set1_ps(planes[p * 4 + 3]);
+        ax[p] = _mm256_andnot_ps(signMask, nx[p]);
+        ay[p] = _mm256_andnot_ps(signMask, ny[p]);
+        az[p] = _mm256_andnot_ps(signMask, nz[p]);
+    }
+    size_t written = 0;
+    for(size_t i = 0; i + 8 <= count; i += 8)
+    {
+        __m256 cx = _mm256_loadu_ps(centerX + i), cy = _mm256_loadu_ps(centerY + i), cz = _mm256_loadu_ps(centerZ + i);
+        __m256 ex = _mm256_loadu_ps(extentX + i), ey = _mm256_loadu_ps(extentY + i), ez = _mm256_loadu_ps(extentZ + i);
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for(int p = 0; p < 6; p++)
+        {
+            __m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(nx[p], cx), _mm256_mul_ps(ny[p], cy)), _mm256_add_ps(_mm256_mul_ps(nz[p], cz), d[p]));
+            __m256 reach = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ax[p], ex), _mm256_mul_ps(ay[p], ey)), _mm256_mul_ps(az[p], ez));
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(distance, reach), _mm256_setzero_ps(), _CMP_GE_OQ));
+        }
+        int mask = _mm256_movemask_ps(inside);
+        for(int lane = 0; mask != 0; lane++, mask >>= 1)
+            if(mask & 1)
+                visible[written++] = static_cast<uint32_t>(i + lane);
+    }
+    return written;
+}
@@ -2,6 +2,8 @@
 #include <iostream>
 #include<vector>
 #include <fstream>
+#include <functional>
+#include <map>
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include <glm/glm.hpp>
@@ -14,6 +16,17 @@
 #include "camera.h"
 #include "model.h"
 #include "mesh.h"
+#include "file_watcher.h"
+#include "batch_reader.h"
+#include "scene_loader.h"
+#include "cubemap.h"
+#include "frame_uniforms.h"
+#include "gl43.h"
+#include "parallel_compile.h"
+#include "gl_state.h"
+#include "render_queue.h"
+#include "fleet.h"
+#include "occlusion_culler.h"
 
 const unsigned int SCR_WIDTH = 1500;
 const unsigned int SCR_HEIGHT = 1000;
@@ -54,6 +67,10 @@ std::vector<Keyframe> flightPath;
 void initFlightPath();
 
 bool autoPilot = false;
+bool showFleet = false; // F: a formation of FLEET_SIZE planes drawn with instancing
+const unsigned int FLEET_SIZE = 10000;
+bool gpuCulling = true; // G: cull the fleet on the GPU when the context is 4.3
+bool occlusionCulling = true; // O: skip what the scene's largest meshes hide, tested on the CPU
 glm::vec3 getInterpolatedPosition(float time) {
     if (flightPath.empty()) return glm::vec3(0.0f);
     
@@ -90,7 +107,7 @@ glm::quat getInterpolatedRotation(float time) {
     return flightPath[0].rotation;
 }
 
-int main()
+int main(int argc, char **argv)
 {
     if(!glfwInit())
     {
@@ -98,7 +115,8 @@ int main()
         return -1;
     }
 
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    // 4.3 enables the GPU driven paths (see gl43.h), where it isn't available 3.3 and the CPU paths do
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 #ifdef __APPLE__
@@ -107,6 +125,12 @@ int main()
 
     GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "Plane Rotations", NULL, NULL);
     if (window == NULL)
+    {
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "Plane Rotations", NULL, NULL);
+    }
+    if (window == NULL)
     {
         std::cout << "Failed to create GLFW window" << std::endl;
         glfwTerminate();
@@ -124,15 +148,49 @@ int main()
         std::cout << "Failed to initialize GLAD" << std::endl;
         return -1;
     }
+    GL43::get().load((GLADloadproc)glfwGetProcAddress);
+    ParallelShaderCompile::get().load((GLADloadproc)glfwGetProcAddress);
 
     glEnable(GL_DEPTH_TEST);
+    // filter across cube faces, the cubemap mips are made for it
+    glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
     initFlightPath();
 
-    Shader basicShader("shaders/basic.vert", "shaders/basic.frag");
-    Shader phongShader("shaders/phong.vert", "shaders/phong.frag");
+    // every program is handed to the driver up front and finishes while the assets load and the first
+    // frames run, draws with a program that isn't ready yet are skipped
+    Shader basicShader("shaders/basic.vert", "shaders/basic.frag", nullptr, ShaderBuild::Async);
+    Shader phongShader("shaders/phong.vert", "shaders/phong.frag", nullptr, ShaderBuild::Async);
+    Shader fleetShader("shaders/fleet.vert", "shaders/phong.frag", nullptr, ShaderBuild::Async);
+    std::unique_ptr<Shader> fleetCullShader;
+    if (GL43::get().supported)
+        fleetCullShader.reset(new Shader("shaders/fleet_cull.comp", ShaderBuild::Async));
+    std::cout << "Shader: " << ProgramCache::get().hits << " program(s) loaded from the binary cache, " << ProgramCache::get().misses << " compiling"
+              << (ParallelShaderCompile::get().supported ? " in parallel" : "") << std::endl;
+    // camera and light, written once per frame for every shader
+    FrameUniformBuffer frameUniforms;
+
+    // loaders read from the asset pack when the build made one, loose files otherwise
+    AssetPack assetPack;
+    if (assetPack.open("assets.pack"))
+        AssetPack::mount(&assetPack);
 
     Model planeModel("assets/plane /LooL.obj");
 
+    // optional scene manifest (one model path per line), its models are lined up behind the plane
+    SceneLoader sceneLoader;
+    std::vector<std::unique_ptr<Model>> sceneModels;
+    if (argc > 1)
+        sceneModels = sceneLoader.load(SceneLoader::readManifest(argv[1]));
+    std::vector<glm::mat4> sceneTransforms;
+    std::vector<LodState> sceneLods(sceneModels.size());
+    float sceneX = 0.0f;
+    for (const std::unique_ptr<Model> &sceneModel : sceneModels)
+    {
+        sceneX += sceneModel->boundsRadius;
+        sceneTransforms.push_back(glm::translate(glm::mat4(1.0f), glm::vec3(sceneX, -2.5f, -30.0f) - sceneModel->boundsCenter));
+        sceneX += sceneModel->boundsRadius * 1.5f;
+    }
+
     // Skybox Setup
     float skyboxVertices[] = {
         -1.0f,  1.0f, -1.0f, -1.0f, -1.0f, -1.0f,  1.0f, -1.0f, -1.0f,
@@ -152,7 +210,7 @@ int main()
     unsigned int skyboxVAO, skyboxVBO;
     glGenVertexArrays(1, &skyboxVAO);
     glGenBuffers(1, &skyboxVBO);
-    glBindVertexArray(skyboxVAO);
+    GLState::current().bindVertexArray(skyboxVAO);
     glBindBuffer(GL_ARRAY_BUFFER, skyboxVBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(skyboxVertices), &skyboxVertices, GL_STATIC_DRAW);
     glEnableVertexAttribArray(0);
@@ -167,8 +225,76 @@ std::vector<std::string> faces {
     
     unsigned int cubemapTexture = loadCubemap(faces);
 
-    basicShader.use();
-    basicShader.setInt("skybox", 0);
+    Material skyboxMaterial;
+    skyboxMaterial.addTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture, "skybox");
+    // every draw of a frame goes through here, sorted by program and material
+    RenderQueue renderQueue;
+
+    LodState planeLod;
+
+    // the fleet: copies of the plane in a grid ahead of the camera, each with its own heading, tint and livery
+    Fleet fleet(planeModel);
+    OcclusionCuller occlusion;
+    const unsigned int fleetColumns = 100;
+    const float fleetSpacing = glm::max(planeModel.boundsRadius, 0.5f) * 3.0f;
+    for (unsigned int i = 0; i < FLEET_SIZE; i++)
+    {
+        unsigned int hash = i * 2654435761u;
+        FleetInstance instance;
+        instance.position = glm::vec3((float(i % fleetColumns) - fleetColumns * 0.5f) * fleetSpacing, 10.0f + float(hash % 7) * fleetSpacing * 0.2f,
+                                      -40.0f - float(i / fleetColumns) * fleetSpacing) - planeModel.boundsCenter;
+        instance.rotation = glm::angleAxis(glm::radians(float(hash >> 8 & 31) - 15.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        instance.tint = glm::vec4(glm::vec3(0.8f + float(hash >> 16 & 7) * 0.025f), 1.0f);
+        instance.livery = hash >> 24 & 7;
+        fleet.instances.push_back(instance);
+    }
+    fleet.InstancesChanged();
+
+    // hot reload: edits to the shaders, the model or its textures in the source tree are picked up while running
+#ifdef ASSET_SOURCE_DIR
+    const std::string sourceDir = ASSET_SOURCE_DIR;
+#else
+    const std::string sourceDir = ".";
+#endif
+    FileWatcher watcher;
+    std::map<std::string, std::function<void()>> reloaders;
+    auto onChange = [&](const std::string &path, std::function<void()> reload) {
+        // a file several things depend on (phong.frag) reloads all of them
+        std::function<void()> &reloader = reloaders[watcher.watch(sourceDir + "/" + path)];
+        std::function<void()> previous = reloader;
+        reloader = previous ? [previous, reload]() { previous(); reload(); } : reload;
+    };
+    auto reloadShader = [&](Shader &shader, const char *vertex, const char *fragment) {
+        std::function<void()> reload = [&shader, &sourceDir, vertex, fragment]() {
+            shader.reload((sourceDir + "/" + vertex).c_str(), (sourceDir + "/" + fragment).c_str());
+        };
+        onChange(vertex, reload);
+        onChange(fragment, reload);
+    };
+    reloadShader(basicShader, "shaders/basic.vert", "shaders/basic.frag");
+    reloadShader(phongShader, "shaders/phong.vert", "shaders/phong.frag");
+    reloadShader(fleetShader, "shaders/fleet.vert", "shaders/phong.frag");
+    if (fleetCullShader)
+        onChange("shaders/fleet_cull.comp", [&]() { fleetCullShader->reload((sourceDir + "/shaders/fleet_cull.comp").c_str()); });
+    onChange("assets/plane /LooL.obj", [&]() {
+        Model reloaded(sourceDir + "/assets/plane /LooL.obj");
+        if (reloaded.meshes.empty())
+        {
+            std::cout << "Hot reload: keeping the previous model, the new one failed to load" << std::endl;
+            return;
+        }
+        planeModel.Release();
+        planeModel = std::move(reloaded);
+        planeLod = LodState();
+    });
+    const std::string textureDir = sourceDir + "/" + planeModel.directory;
+    for (const Texture &texture : planeModel.textures_loaded)
+    {
+        std::string path = texture.path;
+        onChange(planeModel.directory + "/" + path, [&planeModel, &textureDir, path]() {
+            planeModel.ReloadTexture(path, textureDir);
+        });
+    }
 
     while(!glfwWindowShouldClose(window))
     {
@@ -178,11 +304,27 @@ std::vector<std::string> faces {
 
         processInput(window);
 
+        for (const std::string &changed : watcher.poll())
+            reloaders[changed]();
+
+        // state changes of the previous frame
+        GLStateStats glStats = GLState::current().takeStats();
         std::string modeStr = useQuaternions ? "QUATERNION" : "EULER (Gimbal Lock Demo)";
         std::string title = "PlaneRotation | Mode: " + modeStr + 
                         " | Pitch: " + std::to_string((int)pitch % 360) + 
                         " | Yaw: " + std::to_string((int)yaw % 360) + 
-                        " | Roll: " + std::to_string((int)roll % 360);
+                        " | Roll: " + std::to_string((int)roll % 360) +
+                        " | Meshes: " + std::to_string(planeModel.meshesVisible) + "/" + std::to_string(planeModel.meshesTotal) +
+                        " | Meshlets: " + std::to_string(planeModel.meshletsVisible) + "/" + std::to_string(planeModel.meshletsTotal) +
+                        " | LOD: " + std::to_string(planeLod.level) +
+                        " | Draws: " + std::to_string(renderQueue.stats.draws) + " (" + std::to_string(renderQueue.stats.programSwitches) + " programs, " +
+                        std::to_string(renderQueue.stats.materialBinds) + " materials)" +
+                        " | GL calls: " + std::to_string(glStats.issued) + " (" + std::to_string(glStats.elided) + " elided)" +
+                        (renderQueue.stats.notReady == 0 ? "" : " | Shaders compiling: " + std::to_string(renderQueue.stats.notReady) + " draw(s) skipped") +
+                        (!showFleet ? "" : fleet.culledOnGpu ? " | Fleet: " + std::to_string(fleet.instances.size()) + " culled on the GPU"
+                                                             : " | Fleet: " + std::to_string(fleet.visible) + "/" + std::to_string(fleet.instances.size())) +
+                        (!occlusionCulling ? "" : " | Occluded: " + std::to_string(occlusion.occluded.load()) + "/" + std::to_string(occlusion.tested.load()) +
+                                                  " (" + std::to_string(occlusion.occluderTriangles) + " occluder tris)");
 
         glfwSetWindowTitle(window, title.c_str());
 
@@ -192,24 +334,25 @@ std::vector<std::string> faces {
         
         glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 1000.0f);
         glm::mat4 view = camera.GetViewMatrix();
+
+        FrameUniforms frame;
+        frame.projection = projection;
+        frame.view = view;
+        frame.viewPos = glm::vec4(camera.Position, 1.0f);
+        frame.lightPos = glm::vec4(20.0f, 5.0f, -10.0f, 1.0f);
+        frame.lightColor = glm::vec4(1.0f, 0.9f, 0.8f, 1.0f); // Warm white
+        frameUniforms.update(frame);
     
-        // 1. DRAW SKYBOX
-        glDepthFunc(GL_LEQUAL); 
-        basicShader.use();
-  
-        glm::mat4 skyboxView = glm::mat4(glm::mat3(camera.GetViewMatrix())); 
-        basicShader.setMat4("view", skyboxView);
-        basicShader.setMat4("projection", projection);
-        
-        glBindVertexArray(skyboxVAO);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-        glBindVertexArray(0);
-        glDepthFunc(GL_LESS); 
+        // 1. SKYBOX (basic.vert drops the translation of the view), queued after the opaque draws so only
+        // the pixels they leave uncovered are shaded
+        DrawCommand skybox;
+        skybox.type = DrawCommand::Type::Arrays;
+        skybox.shader = &basicShader;
+        skybox.material = &skyboxMaterial;
+        skybox.VAO = skyboxVAO;
+        skybox.count = 36;
+        renderQueue.submit(RenderBucket::Skybox, 0, 0.0f, skybox);
 
-        
-        phongShader.use();
         glm::mat4 model = glm::mat4(1.0f);
 
         if (autoPilot) 
@@ -245,14 +388,32 @@ std::vector<std::string> faces {
 
         model = glm::scale (model, glm::vec3(1.0f));
     
-        phongShader.setMat4("projection", projection);
-        phongShader.setMat4("view", view);
-        phongShader.setMat4("model", model);
+        // the depth the scene's largest meshes leave, everything submitted below is tested against it
+        const OcclusionCuller *occluder = occlusionCulling ? &occlusion : nullptr;
+        if (occlusionCulling)
+        {
+            occlusion.begin(projection * view);
+            planeModel.AddOccluders(occlusion, model);
+            for (size_t i = 0; i < sceneModels.size(); i++)
+                sceneModels[i]->AddOccluders(occlusion, sceneTransforms[i]);
+            occlusion.rasterize();
+        }
+
+        int lod = planeModel.SelectLod(planeLod, model, camera.Position, glm::radians(camera.Zoom), (float)SCR_HEIGHT);
+        planeModel.UpdateVirtualTextures(projection, view, model, glm::radians(camera.Zoom), (float)SCR_HEIGHT);
+        planeModel.Submit(renderQueue, phongShader, projection, view, model, lod, occluder);
 
-        phongShader.setVec3("lightPos", glm::vec3(20.0f, 5.0f, -10.0f)); 
-        phongShader.setVec3("lightColor", glm::vec3(1.0f, 0.9f, 0.8f)); // Warm white
-        phongShader.setVec3("viewPos", camera.Position);            
-        planeModel.Draw(phongShader);
+        for (size_t i = 0; i < sceneModels.size(); i++)
+        {
+            int sceneLod = sceneModels[i]->SelectLod(sceneLods[i], sceneTransforms[i], camera.Position, glm::radians(camera.Zoom), (float)SCR_HEIGHT);
+            sceneModels[i]->UpdateVirtualTextures(projection, view, sceneTransforms[i], glm::radians(camera.Zoom), (float)SCR_HEIGHT);
+            sceneModels[i]->Submit(renderQueue, phongShader, projection, view, sceneTransforms[i], sceneLod, occluder);
+        }
+        fleet.cullShader = gpuCulling ? fleetCullShader.get() : nullptr;
+        fleet.occlusion = occluder;
+        if (showFleet)
+            fleet.Submit(renderQueue, fleetShader, projection, view, camera.Position, glm::radians(camera.Zoom), (float)SCR_HEIGHT);
+        renderQueue.flush();
 
         glfwSwapBuffers(window);
         glfwPollEvents();
@@ -336,6 +497,27 @@ if (glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS && !pWasPressed) {
     pWasPressed = true;
 }
 if (glfwGetKey(window, GLFW_KEY_P) == GLFW_RELEASE) pWasPressed = false;
+
+    static bool fWasPressed = false;
+    if (glfwGetKey(window, GLFW_KEY_F) == GLFW_PRESS && !fWasPressed) {
+        showFleet = !showFleet;
+        fWasPressed = true;
+    }
+    if (glfwGetKey(window, GLFW_KEY_F) == GLFW_RELEASE) fWasPressed = false;
+
+    static bool gWasPressed = false;
+    if (glfwGetKey(window, GLFW_KEY_G) == GLFW_PRESS && !gWasPressed) {
+        gpuCulling = !gpuCulling;
+        gWasPressed = true;
+    }
+    if (glfwGetKey(window, GLFW_KEY_G) == GLFW_RELEASE) gWasPressed = false;
+
+    static bool oWasPressed = false;
+    if (glfwGetKey(window, GLFW_KEY_O) == GLFW_PRESS && !oWasPressed) {
+        occlusionCulling = !occlusionCulling;
+        oWasPressed = true;
+    }
+    if (glfwGetKey(window, GLFW_KEY_O) == GLFW_RELEASE) oWasPressed = false;
 }
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height)
@@ -369,40 +551,63 @@ void scroll_callback(GLFWwindow* window, double xOffset, double yOffset)
     camera.ProcessMouseScroll(static_cast<float>(yOffset) * 5.0f);
 }
 
+// uploads a cooked cubemap (see cooked_asset.h), every face of every level straight from the file
+static bool CubemapFromCooked(const AssetView &file)
+{
+    CookedReader reader(file.data, file.size);
+    CookedCubemapHeader header;
+    if(!HasS3TC() || !reader.read(&header, sizeof(header)) || header.magic != COOKED_CUBEMAP_MAGIC || header.version != COOKED_CUBEMAP_VERSION)
+        return false;
+    const GLenum COMPRESSED_RGB_S3TC_DXT1 = 0x83F0, COMPRESSED_RGBA_S3TC_DXT5 = 0x83F3;
+    GLenum format = header.format == COOKED_BC3 ? COMPRESSED_RGBA_S3TC_DXT5 : COMPRESSED_RGB_S3TC_DXT1;
+    for(uint32_t level = 0; level < header.levels; level++)
+        for(unsigned int face = 0; face < CUBE_FACES; face++)
+        {
+            uint32_t bytes;
+            if(!reader.readU32(bytes) || !reader.skip(bytes))
+            {
+                std::cout << "ERROR::CUBEMAP::COOKED_TRUNCATED" << std::endl;
+                return false;
+            }
+            GLsizei size = std::max(1u, header.size >> level);
+            glCompressedTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, level, format, size, size, 0, bytes, reader.current() - bytes);
+        }
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, header.levels - 1);
+    return true;
+}
+
 unsigned int loadCubemap(std::vector<std::string> faces)
 {
     unsigned int textureID;
     glGenTextures(1, &textureID);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
+    GLState::current().bindTextureForUpload(GL_TEXTURE_CUBE_MAP, textureID);
 
-    int width, height, nrChannels;
-    
-    
-    stbi_set_flip_vertically_on_load(false);
+    // the cooker leaves the compressed faces and their mips next to the sources
+    std::string directory = faces[0].substr(0, faces[0].find_last_of('/'));
+    AssetView cooked;
+    bool loaded = readAssetFile(directory + "/cubemap.ccube", cooked) && CubemapFromCooked(cooked);
 
-    for (unsigned int i = 0; i < faces.size(); i++)
+    if (!loaded)
     {
-        unsigned char *data = stbi_load(faces[i].c_str(), &width, &height, &nrChannels, 0);
-        if (data)
-        {
-            
-            GLenum format = GL_RGB;
-            if (nrChannels == 4)
-                format = GL_RGBA;
-
-            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 
-                        0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-            stbi_image_free(data);
-        }
-        else
+        // faces decoded in parallel (or cut from a panorama), mips with filtered edges built on the CPU
+        stbi_set_flip_vertically_on_load(false);
+        std::vector<CubeLevel> levels(1);
+        if (loadCubeSource(faces, levels[0]))
         {
-            std::cout << "Cubemap texture failed to load at path: " << faces[i] << std::endl;
-            stbi_image_free(data);
+            buildCubeMips(levels);
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+            for (unsigned int level = 0; level < levels.size(); level++)
+                for (unsigned int i = 0; i < CUBE_FACES; i++)
+                    glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, level, GL_RGBA8, levels[level].size, levels[level].size, 0,
+                                 GL_RGBA, GL_UNSIGNED_BYTE, levels[level].faces[i].data());
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, GLint(levels.size()) - 1);
+            loaded = true;
         }
     }
 
     // Set texture parameters 
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, loaded ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
@@ -0,0 +1,544 @@
+// offline tool: cooks an asset directory into the formats Model loads without any processing.
+//
+//   AssetCooker [--jobs n] [--max-texture size] <asset directory> <output directory>
+//
+// models (.obj, .fbx, .gltf, .glb, .dae) are imported, optimized and get their levels of detail -> <path>.cooked,
+// images are downscaled to the maximum texture size and BC1/BC3 compressed with mips -> <path>.ctex.
+// directories with cubemap faces (px, nx, py, ny, pz, nz .png/.jpg) or an equirect.(png|jpg|hdr) panorama
+// become one cubemap with edge filtered mips -> <directory>/cubemap.ccube.
+// outputs mirror the input paths under the output directory, e.g. assets/plane /LooL.obj ->
+// <output>/assets/plane /LooL.obj.cooked, so packing the output directory puts them next to the sources.
+//
+// <output>/cook.db remembers for every output the content hashes of all files it was made from (for a
+// model that includes its .mtl files), the settings and the cooker version. only outputs whose inputs,
+// settings or cooker changed are cooked again; jobs run on a thread per core.
+#include <assimp/DefaultIOSystem.h>
+#include <assimp/Importer.hpp>
+#include <assimp/MemoryIOWrapper.h>
+#include <assimp/scene.h>
+
+#include <stb_image.h>
+
+#include <asset_pack.h>
+#include <cooked_asset.h>
+#include <cubemap.h>
+#include <image_resample.h>
+#include <mesh_import.h>
+#include <png_stream.h>
+
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+// bump whenever cooking code changes in a way that changes the outputs
+#define ASSET_COOKER_VERSION 2
+
+struct Dependency {
+    std::string path;
+    uint64_t size = 0;
+    int64_t time = 0;
+    uint64_t hash = 0;
+};
+
+struct CookRecord {
+    int version = 0;
+    uint64_t settings = 0;
+    std::vector<Dependency> dependencies;
+};
+
+enum class JobKind { Model, Texture, Cubemap };
+
+struct CookJob {
+    JobKind kind;
+    std::string input;  // relative path as given, e.g. "assets/plane /LooL.obj", the directory for cubemaps
+    std::string output; // full output path
+    std::vector<std::string> sources; // cubemap faces, or the panorama
+};
+
+static std::mutex printMutex;
+
+static int64_t fileTime(const std::string &path)
+{
+    std::error_code error;
+    auto time = fs::last_write_time(path, error);
+    return error ? 0 : int64_t(time.time_since_epoch().count());
+}
+
+static bool hashFile(const std::string &path, uint64_t &hash, uint64_t &size)
+{
+    std::ifstream file(path.c_str(), std::ios::binary);
+    if(!file.good())
+        return false;
+    std::vector<char> chunk(1 << 20);
+    hash = 14695981039346656037ull;
+    size = 0;
+    while(file)
+    {
+        file.read(chunk.data(), std::streamsize(chunk.size()));
+        size_t bytes = size_t(file.gcount());
+        hash = hashBytes(chunk.data(), bytes, hash);
+        size += bytes;
+    }
+    return true;
+}
+
+static Dependency makeDependency(const std::string &path)
+{
+    Dependency dependency;
+    dependency.path = path;
+    dependency.time = fileTime(path);
+    hashFile(path, dependency.hash, dependency.size);
+    return dependency;
+}
+
+// reads a whole input for cooking and describes it as a dependency from the same bytes, so it isn't read twice
+static bool readInput(const std::string &path, std::vector<unsigned char> &bytes, Dependency &dependency)
+{
+    std::ifstream file(path.c_str(), std::ios::binary | std::ios::ate);
+    if(!file.good())
+        return false;
+    dependency.path = path;
+    dependency.time = fileTime(path);
+    bytes.resize(size_t(file.tellg()));
+    file.seekg(0);
+    if(!file.read(reinterpret_cast<char*>(bytes.data()), std::streamsize(bytes.size())))
+        return false;
+    dependency.size = bytes.size();
+    dependency.hash = hashBytes(bytes.data(), bytes.size());
+    return true;
+}
+
+// a dependency is unchanged if its size and time match, or failing that, if its content hash does
+static bool dependencyUnchanged(Dependency &dependency)
+{
+    std::error_code error;
+    uint64_t size = fs::file_size(dependency.path, error);
+    if(error)
+        return false;
+    int64_t time = fileTime(dependency.path);
+    if(size == dependency.size && time == dependency.time)
+        return true;
+    uint64_t hash;
+    if(!hashFile(dependency.path, hash, size) || hash != dependency.hash)
+        return false;
+    dependency.time = time; // touched but not changed, remember the new time so it isn't hashed again
+    return true;
+}
+
+// cook.db, one block per output:
+//   output <version> <settings hash> <path>
+//   dep <size> <time> <content hash> <path>
+static std::map<std::string, CookRecord> loadDatabase(const std::string &path)
+{
+    std::map<std::string, CookRecord> records;
+    std::ifstream file(path.c_str());
+    std::string line;
+    CookRecord *current = nullptr;
+    while(std::getline(file, line))
+    {
+        std::istringstream in(line);
+        std::string tag;
+        in >> tag;
+        if(tag == "output")
+        {
+            CookRecord record;
+            std::string output;
+            in >> record.version >> std::hex >> record.settings >> std::dec;
+            in.get();
+            std::getline(in, output);
+            current = &(records[output] = record);
+        }
+        else if(tag == "dep" && current)
+        {
+            Dependency dependency;
+            in >> dependency.size >> dependency.time >> std::hex >> dependency.hash >> std::dec;
+            in.get();
+            std::getline(in, dependency.path);
+            current->dependencies.push_back(dependency);
+        }
+    }
+    return records;
+}
+
+static void saveDatabase(const std::string &path, const std::map<std::string, CookRecord> &records)
+{
+    std::ofstream file(path.c_str());
+    for(const auto &entry : records)
+    {
+        file << "output " << entry.second.version << " " << std::hex << entry.second.settings << std::dec << " " << entry.first << "\n";
+        for(const Dependency &dependency : entry.second.dependencies)
+            file << "dep " << dependency.size << " " << dependency.time << " " << std::hex << dependency.hash << std::dec << " " << dependency.path << "\n";
+    }
+}
+
+// file system that reads everything Assimp opens into memory and keeps it as the model's dependencies,
+// hashed from the bytes Assimp imports from
+class RecordingIOSystem : public Assimp::DefaultIOSystem {
+public:
+    std::vector<Dependency> opened;
+
+    Assimp::IOStream *Open(const char *pFile, const char *pMode = "rb") override
+    {
+        if(pMode[0] != 'r')
+            return Assimp::DefaultIOSystem::Open(pFile, pMode);
+        std::string path = normalizeAssetPath(pFile);
+        Dependency dependency;
+        files.emplace_back();
+        if(!readInput(pFile, files.back(), dependency))
+        {
+            files.pop_back();
+            return nullptr;
+        }
+        dependency.path = path;
+        bool known = false;
+        for(const Dependency &other : opened)
+            known = known || other.path == path;
+        if(!known)
+            opened.push_back(dependency);
+        return new Assimp::MemoryIOStream(files.back().data(), files.back().size());
+    }
+
+private:
+    std::deque<std::vector<unsigned char>> files; // stay put while streams over them are open
+};
+
+static bool cookModel(const CookJob &job, const MeshOptimizeSettings &optimize, const LodSettings &lodSettings,
+                      uint64_t settings, std::vector<Dependency> &dependencies)
+{
+    Assimp::Importer importer;
+    RecordingIOSystem *io = new RecordingIOSystem();
+    importer.SetIOHandler(io); // the importer owns it
+    const aiScene *scene = importer.ReadFile(job.input, MODEL_IMPORT_FLAGS);
+    dependencies = io->opened;
+    if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode)
+    {
+        std::lock_guard<std::mutex> lock(printMutex);
+        std::cout << "ERROR::ASSIMP:: " << job.input << ": " << importer.GetErrorString() << std::endl;
+        return false;
+    }
+
+    CookedModel cooked;
+    cooked.settingsHash = settings;
+    cooked.materials.resize(scene->mNumMaterials);
+    for(unsigned int m = 0; m < scene->mNumMaterials; m++)
+        for(const MaterialTextureSlot &slot : MATERIAL_TEXTURE_SLOTS)
+            for(unsigned int t = 0; t < scene->mMaterials[m]->GetTextureCount(slot.type); t++)
+            {
+                aiString path;
+                scene->mMaterials[m]->GetTexture(slot.type, t, &path);
+                cooked.materials[m].types.push_back(slot.name);
+                cooked.materials[m].paths.push_back(path.C_Str());
+            }
+
+    // same node order and processing as Model::processNode / processMesh
+    std::vector<const aiNode*> stack(1, scene->mRootNode);
+    std::vector<const aiNode*> order;
+    while(!stack.empty())
+    {
+        const aiNode *node = stack.back();
+        stack.pop_back();
+        order.push_back(node);
+        for(unsigned int c = node->mNumChildren; c-- > 0;)
+            stack.push_back(node->mChildren[c]);
+    }
+    for(const aiNode *node : order)
+        for(unsigned int i = 0; i < node->mNumMeshes; i++)
+        {
+            const aiMesh *mesh = scene->mMeshes[node->mMeshes[i]];
+            CookedMesh result;
+            result.materialIndex = mesh->mMaterialIndex;
+            importMeshData(mesh, result.vertices, result.indices);
+            optimizeMesh(result.vertices, result.indices, optimize, &result.meshlets);
+            result.lods = generateLodChain(result.vertices, result.indices, lodSettings, optimize.cacheSize);
+            cooked.meshes.push_back(std::move(result));
+        }
+    return writeCookedModel(job.output, cooked);
+}
+
+static bool cookTexture(const CookJob &job, uint32_t maxDimension, std::vector<Dependency> &dependencies)
+{
+    std::vector<unsigned char> file;
+    dependencies.assign(1, Dependency());
+    if(!readInput(job.input, file, dependencies[0]))
+        return false;
+
+    // PNGs are decoded as a stream and downscaled on the way in, other formats go through stb_image
+    std::vector<unsigned char> rgba;
+    uint32_t width = 0, height = 0;
+    PngStreamDecoder png;
+    if(png.open(file.data(), file.size()))
+    {
+        BoxDownsampler downsampler;
+        downsampler.init(png.width, png.height, 4, downsampleFactor(png.width, png.height, maxDimension));
+        width = downsampler.dstWidth;
+        height = downsampler.dstHeight;
+        rgba.resize(size_t(width) * height * 4);
+        std::vector<unsigned char> row(size_t(png.width) * png.channels), expanded(size_t(png.width) * 4);
+        uint32_t outRow = 0;
+        for(uint32_t y = 0; y < png.height; y++)
+        {
+            if(!png.readRow(row.data()))
+                return false;
+            for(uint32_t x = 0; x < png.width; x++)
+            {
+                const unsigned char *src = &row[size_t(x) * png.channels];
+                unsigned char *dst = &expanded[size_t(x) * 4];
+                dst[0] = src[0];
+                dst[1] = png.channels >= 3 ? src[1] : src[0];
+                dst[2] = png.channels >= 3 ? src[2] : src[0];
+                dst[3] = png.channels == 4 ? src[3] : 255;
+            }
+            if(downsampler.pushRow(expanded.data(), &rgba[size_t(outRow) * width * 4]))
+                outRow++;
+        }
+    }
+    else
+    {
+        int w, h, n;
+        unsigned char *data = stbi_load_from_memory(file.data(), int(file.size()), &w, &h, &n, 4);
+        if(!data)
+            return false;
+        BoxDownsampler downsampler;
+        downsampler.init(w, h, 4, downsampleFactor(w, h, maxDimension));
+        width = downsampler.dstWidth;
+        height = downsampler.dstHeight;
+        rgba.resize(size_t(width) * height * 4);
+        uint32_t outRow = 0;
+        for(int y = 0; y < h; y++)
+            if(downsampler.pushRow(data + size_t(y) * w * 4, &rgba[size_t(outRow) * width * 4]))
+                outRow++;
+        stbi_image_free(data);
+    }
+    return writeCookedTexture(job.output, std::move(rgba), width, height);
+}
+
+// the images a directory's cubemap is made from: the six faces, missing ones as .png so the loader reports
+// them, or the panorama if there are no faces at all. empty if the directory has neither.
+static std::vector<std::string> cubemapSources(const std::string &directory)
+{
+    std::vector<std::string> faces;
+    bool anyFace = false;
+    std::error_code error;
+    for(const char *name : CUBE_FACE_NAMES)
+    {
+        std::string face = directory + "/" + name + ".png";
+        for(const char *extension : { ".png", ".jpg", ".jpeg" })
+            if(fs::is_regular_file(directory + "/" + name + extension, error))
+            {
+                face = directory + "/" + name + extension;
+                anyFace = true;
+                break;
+            }
+        faces.push_back(face);
+    }
+    if(anyFace)
+        return faces;
+    for(const char *extension : { ".png", ".jpg", ".jpeg", ".hdr" })
+        if(fs::is_regular_file(directory + "/equirect" + extension, error))
+            return std::vector<std::string>(1, directory + "/equirect" + extension);
+    return std::vector<std::string>();
+}
+
+static bool isCubemapSource(const fs::path &path)
+{
+    std::string stem = path.stem().string();
+    for(const char *name : CUBE_FACE_NAMES)
+        if(stem == name)
+            return true;
+    return stem == "equirect";
+}
+
+// the faces are read by loadCubeSource, they are hashed again here, which at least happens off the database lock
+static bool cookCubemap(const CookJob &job, uint32_t maxDimension, std::vector<Dependency> &dependencies)
+{
+    dependencies.clear();
+    std::error_code error;
+    for(const std::string &source : job.sources)
+        if(fs::is_regular_file(source, error))
+            dependencies.push_back(makeDependency(source));
+
+    std::vector<CubeLevel> levels(1);
+    if(!loadCubeSource(job.sources, levels[0]))
+        return false;
+    buildCubeMips(levels);
+    // levels above the maximum texture size are dropped rather than resampled, their mips are already there
+    while(levels.size() > 1 && maxDimension > 0 && levels[0].size > maxDimension)
+        levels.erase(levels.begin());
+    return writeCookedCubemap(job.output, levels);
+}
+
+static bool hasExtension(const fs::path &path, std::initializer_list<const char*> extensions)
+{
+    std::string extension = path.extension().string();
+    for(char &c : extension)
+        c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    for(const char *e : extensions)
+        if(extension == e)
+            return true;
+    return false;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned int jobCount = std::max(1u, std::thread::hardware_concurrency());
+    uint32_t maxTextureDimension = 8192; // same default as Model::maxTextureDimension
+    int arg = 1;
+    while(arg + 1 < argc && argv[arg][0] == '-' && argv[arg][1] == '-')
+    {
+        std::string option = argv[arg];
+        if(option == "--jobs")
+            jobCount = std::max(1, std::atoi(argv[arg + 1]));
+        else if(option == "--max-texture")
+            maxTextureDimension = static_cast<uint32_t>(std::atoi(argv[arg + 1]));
+        else
+            break;
+        arg += 2;
+    }
+    if(argc - arg != 2)
+    {
+        std::cout << "usage: AssetCooker [--jobs n] [--max-texture size] <asset directory> <output directory>" << std::endl;
+        return 1;
+    }
+    std::string inputDirectory = argv[arg];
+    fs::path outputDirectory = argv[arg + 1];
+    auto start = std::chrono::steady_clock::now();
+
+    MeshOptimizeSettings optimize;
+    LodSettings lodSettings;
+    const uint64_t modelSettings = cookSettingsHash(optimize, lodSettings);
+    const uint64_t textureSettings = hashBytes(&maxTextureDimension, sizeof(maxTextureDimension), COOKED_TEXTURE_VERSION);
+    const uint64_t cubemapSettings = hashBytes(&maxTextureDimension, sizeof(maxTextureDimension), COOKED_CUBEMAP_VERSION);
+
+    std::vector<CookJob> jobs;
+    std::error_code error;
+    for(fs::recursive_directory_iterator it(inputDirectory, error), end; it != end; it.increment(error))
+    {
+        if(it->path().filename().string()[0] == '.')
+            continue;
+        CookJob job;
+        job.input = normalizeAssetPath(it->path().generic_string());
+        if(it->is_directory(error))
+        {
+            job.sources = cubemapSources(job.input);
+            if(job.sources.empty())
+                continue;
+            job.kind = JobKind::Cubemap;
+            job.output = (outputDirectory / job.input / "cubemap.ccube").string();
+        }
+        else if(!it->is_regular_file(error) || isCubemapSource(it->path()))
+            continue;
+        else if(hasExtension(it->path(), { ".obj", ".fbx", ".gltf", ".glb", ".dae" }))
+        {
+            job.kind = JobKind::Model;
+            job.output = (outputDirectory / (job.input + ".cooked")).string();
+        }
+        else if(hasExtension(it->path(), { ".png", ".jpg", ".jpeg", ".tga", ".bmp" }))
+        {
+            job.kind = JobKind::Texture;
+            job.output = (outputDirectory / (job.input + ".ctex")).string();
+        }
+        else
+            continue;
+        jobs.push_back(job);
+    }
+
+    const std::string databasePath = (outputDirectory / "cook.db").string();
+    std::map<std::string, CookRecord> database = loadDatabase(databasePath);
+    std::mutex databaseMutex;
+    std::atomic<size_t> nextJob(0);
+    std::atomic<int> cooked(0), upToDate(0), failed(0);
+
+    auto worker = [&]() {
+        for(size_t j = nextJob++; j < jobs.size(); j = nextJob++)
+        {
+            const CookJob &job = jobs[j];
+            uint64_t settings = job.kind == JobKind::Model ? modelSettings : textureSettings;
+            if(job.kind == JobKind::Cubemap)
+            {
+                // which faces exist is part of the settings, so adding a missing face cooks the cubemap again
+                settings = cubemapSettings;
+                std::error_code missing;
+                for(const std::string &source : job.sources)
+                    settings = hashBytes(source.data(), source.size(), settings + (fs::is_regular_file(source, missing) ? 1 : 0));
+            }
+
+            // up to date if the output exists and nothing it was made from changed
+            bool stale = true;
+            CookRecord record;
+            {
+                std::lock_guard<std::mutex> lock(databaseMutex);
+                auto found = database.find(job.output);
+                if(found != database.end())
+                {
+                    record = found->second;
+                    stale = false;
+                }
+            }
+            if(!stale)
+            {
+                stale = record.version != ASSET_COOKER_VERSION || record.settings != settings || !fs::exists(job.output, error) || record.dependencies.empty();
+                for(size_t d = 0; d < record.dependencies.size() && !stale; d++)
+                    stale = !dependencyUnchanged(record.dependencies[d]);
+            }
+            if(!stale)
+            {
+                std::lock_guard<std::mutex> lock(databaseMutex);
+                database[job.output] = record;
+                upToDate++;
+                continue;
+            }
+
+            fs::create_directories(fs::path(job.output).parent_path(), error);
+            // the cook describes its inputs from the bytes it read, so nothing is hashed under the lock
+            std::vector<Dependency> dependencies;
+            bool ok;
+            if(job.kind == JobKind::Model)
+                ok = cookModel(job, optimize, lodSettings, settings, dependencies);
+            else if(job.kind == JobKind::Cubemap)
+                ok = cookCubemap(job, maxTextureDimension, dependencies);
+            else
+                ok = cookTexture(job, maxTextureDimension, dependencies);
+            {
+                std::lock_guard<std::mutex> lock(printMutex);
+                std::cout << (ok ? "AssetCooker: cooked " : "ERROR::ASSET_COOKER::FAILED: ") << job.input << std::endl;
+            }
+            std::lock_guard<std::mutex> lock(databaseMutex);
+            if(!ok)
+            {
+                database.erase(job.output);
+                failed++;
+                continue;
+            }
+            record = CookRecord();
+            record.version = ASSET_COOKER_VERSION;
+            record.settings = settings;
+            record.dependencies = std::move(dependencies);
+            database[job.output] = record;
+            cooked++;
+        }
+    };
+    std::vector<std::thread> threads;
+    for(unsigned int t = 0; t < std::min<size_t>(jobCount, jobs.size()); t++)
+        threads.emplace_back(worker);
+    for(std::thread &thread : threads)
+        thread.join();
+
+    fs::create_directories(outputDirectory, error);
+    saveDatabase(databasePath, database);
+    float seconds = std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "AssetCooker: " << cooked << " cooked, " << upToDate << " up to date, " << failed << " failed in " << seconds << "s" << std::endl;
+    return failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,96 @@
+// offline tool: packs files and directories into a single asset pack (see asset_pack.h).
+//
+//   AssetPacker [--zstd level] <output.pack> [-C directory] <file or directory>...
+//
+// the packed paths are the ones given on the command line, e.g. "assets/plane /LooL.obj", relative to the
+// directory set by the last -C (the current one by default). hidden files are skipped. with --zstd (and a build that found zstd)
+// text and mesh files are compressed, images and tile files are already compressed or streamed and
+// stay raw.
+#include <asset_pack.h>
+
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+static bool compressible(const fs::path &path)
+{
+    std::string extension = path.extension().string();
+    for(char &c : extension)
+        c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    return extension != ".png" && extension != ".jpg" && extension != ".jpeg" && extension != ".vt" && extension != ".ctex" && extension != ".pack";
+}
+
+static void addSource(const fs::path &base, const fs::path &path, bool compress, std::vector<AssetPackSource> &sources)
+{
+    if(!path.filename().empty() && path.filename().string()[0] == '.')
+        return;
+    AssetPackSource source;
+    source.path = path.lexically_relative(base).generic_string();
+    source.file = path.string();
+    source.compress = compress && compressible(path);
+    sources.push_back(source);
+}
+
+int main(int argc, char **argv)
+{
+    int zstdLevel = 0;
+    int arg = 1;
+    if(arg + 1 < argc && std::string(argv[arg]) == "--zstd")
+    {
+        zstdLevel = std::atoi(argv[arg + 1]);
+        arg += 2;
+    }
+    if(argc - arg < 2)
+    {
+        std::cout << "usage: AssetPacker [--zstd level] <output.pack> [-C directory] <file or directory>..." << std::endl;
+        return 1;
+    }
+#ifndef HAVE_ZSTD
+    if(zstdLevel > 0)
+        std::cout << "AssetPacker: built without zstd, storing everything raw" << std::endl;
+#endif
+    std::string output = argv[arg++];
+
+    std::vector<AssetPackSource> sources;
+    fs::path base = ".";
+    for(; arg < argc; arg++)
+    {
+        if(std::string(argv[arg]) == "-C" && arg + 1 < argc)
+        {
+            base = argv[++arg];
+            continue;
+        }
+        fs::path input = base / argv[arg];
+        std::error_code error;
+        if(fs::is_directory(input, error))
+        {
+            for(fs::recursive_directory_iterator it(input, error), end; it != end; it.increment(error))
+            {
+                if(it->path().filename().string()[0] == '.')
+                {
+                    if(it->is_directory(error))
+                        it.disable_recursion_pending();
+                    continue;
+                }
+                if(it->is_regular_file(error))
+                    addSource(base, it->path(), zstdLevel > 0, sources);
+            }
+        }
+        else if(fs::is_regular_file(input, error))
+            addSource(base, input, zstdLevel > 0, sources);
+        else
+        {
+            std::cout << "ERROR::ASSET_PACKER::NOT_FOUND: " << input.string() << std::endl;
+            return 1;
+        }
+    }
+
+    if(!writeAssetPack(output, sources, zstdLevel))
+        return 1;
+    std::cout << "AssetPacker: " << sources.size() << " files -> " << output << " (" << fs::file_size(output) / 1024 << " KB)" << std::endl;
+    return 0;
+}
@@ -0,0 +1,42 @@
+// offline tool: cuts a large image into the tile file a VirtualTexture streams from.
+//
+//   TextureTiler <image> [output] [tileSize] [border]
+//
+// the output defaults to <image>.vt, which is where Model looks for it.
+#include <stb_image.h>
+
+#include <virtual_texture_file.h>
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+int main(int argc, char **argv)
+{
+    if(argc < 2)
+    {
+        std::cout << "usage: TextureTiler <image> [output] [tileSize] [border]" << std::endl;
+        return 1;
+    }
+    std::string input = argv[1];
+    std::string output = argc > 2 ? argv[2] : input + ".vt";
+    unsigned int tileSize = argc > 3 ? static_cast<unsigned int>(std::atoi(argv[3])) : 128;
+    unsigned int border = argc > 4 ? static_cast<unsigned int>(std::atoi(argv[4])) : 4;
+    if(tileSize == 0 || border >= tileSize)
+    {
+        std::cout << "ERROR::TEXTURE_TILER::BAD_TILE_SIZE: " << tileSize << " (border " << border << ")" << std::endl;
+        return 1;
+    }
+
+    int width, height, nrComponents;
+    unsigned char *data = stbi_load(input.c_str(), &width, &height, &nrComponents, 4);
+    if(!data)
+    {
+        std::cout << "ERROR::TEXTURE_TILER::LOAD_FAILED: " << input << " (" << stbi_failure_reason() << ")" << std::endl;
+        return 1;
+    }
+    std::cout << "TextureTiler: " << input << " " << width << "x" << height << " -> " << output << std::endl;
+    bool ok = writeVirtualTextureFile(output, data, width, height, tileSize, border);
+    stbi_image_free(data);
+    return ok ? 0 : 1;
+}